@@ -14,18 +14,16 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
 
     void printfDumpOfSkipLayer(int level) {
         printf("Skip-Quadtree dump (skip-level=%d)\n", level + 1);
-        if (tree.lowDetailedRoot == NULL) {
+        if (tree.lowDetailedRoot == NULL_NODE) {
             printf("Empty\n");
         } else {
-            MiddleNode *lvlRoot = dynamic_cast<MiddleNode *>(tree.lowDetailedRoot.get());
-            if (lvlRoot != NULL) {
-                for (int i = 1; i < tree.skipLevels - level; i++) {
-                    lvlRoot = lvlRoot->linkToMoreDetailed.get();
-                }
+            NodeRef lvlRoot = getRootFromSkipLevel(level);
+            if (!isTermNode(lvlRoot)) {
                 traceMiddleNode(lvlRoot, 0);
             } else {
-                TermNode *termNode = dynamic_cast<TermNode *>(tree.lowDetailedRoot.get());
-                std::cout << "stackLevel=" << 0 << "\t " << *termNode << std::endl;
+                std::cout << "stackLevel=" << 0 << "\t ";
+                tree.printNode(std::cout, lvlRoot);
+                std::cout << std::endl;
             }
         }
         printf("____________________________________________\n");
@@ -49,75 +47,77 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
         }
     }
 
-    void drawNodeNum(const Node *n, cg::visualization::printer_type &p) const {
-        if (n == NULL) {
+    // cells of the top levels may be unbounded
+    Range visibleRange(NodeRef n) const {
+        Range r = tree.nodeRange(n);
+        return Range(r.lvl,
+                std::max<float>(r.fromX, MIN_X), std::min<float>(r.toX, MAX_X),
+                std::max<float>(r.fromY, MIN_Y), std::min<float>(r.toY, MAX_Y));
+    }
+
+    // the cell is split at the middle of its keys, not of its coordinates
+    point_2f splitPoint(NodeRef n) const {
+        Cell const &cell = tree.middle(n).cell;
+        point_2f split(CoordinateKey<float>::fromKey(cell.fromX + cell.side() / 2),
+                CoordinateKey<float>::fromKey(cell.fromY + cell.side() / 2));
+        return point_2f(std::min<float>(std::max<float>(split.x, MIN_X), MAX_X),
+                std::min<float>(std::max<float>(split.y, MIN_Y), MAX_Y));
+    }
+
+    void drawNodeNum(NodeRef n, cg::visualization::printer_type &p) const {
+        if (n == NULL_NODE) {
             return;
         }
-        const MiddleNode *node = dynamic_cast<const MiddleNode *>(n);
-        if (node == NULL) {
-            p.global_stream(((TermNode *) n)->point) << n->id;
+        if (isTermNode(n)) {
+            p.global_stream(tree.term(n).point) << tree.nodeId(n);
             return;
         }
-        p.global_stream(node->range.getMiddlePoint()) << node->id;
+        const MiddleNode &node = tree.middle(n);
+        p.global_stream(splitPoint(n)) << tree.nodeId(n);
         for (int i = 0; i < 4; i++) {
-            if (node->children[i] != NULL) {
-                MiddleNode *child = dynamic_cast<MiddleNode *>(node->children[i].get());
-                if (child != NULL) {
-                    drawNodeNum(child, p);
-                } else {
-                    p.global_stream(((TermNode *) node->children[i].get())->point) << node->children[i]->id;
-                }
-            }
+            drawNodeNum(node.children[i], p);
         }
     }
 
-    void drawNode(TermNode *node, cg::visualization::drawer_type &drawer) const {
-        drawer.set_color(Qt::green);
-        drawer.draw_point(node->point, 2);
-    }
-
-    void drawNode(const Node *n, cg::visualization::drawer_type &drawer) const {
-        if (n == NULL) {
+    void drawNode(NodeRef n, cg::visualization::drawer_type &drawer) const {
+        if (n == NULL_NODE) {
             return;
         }
-        const MiddleNode *node = dynamic_cast<const MiddleNode *>(n);
-        if (node == NULL) {
-            drawNode(dynamic_cast<const TermNode *>(node), drawer);
+        if (isTermNode(n)) {
+            drawer.set_color(Qt::green);
+            drawer.draw_point(tree.term(n).point, 2);
             return;
         }
+        const MiddleNode &node = tree.middle(n);
         drawer.set_color(Qt::red);
-        drawer.draw_point(node->range.getMiddlePoint(), 3);//MAX_LEVEL_RENDER + 2);
+        drawer.draw_point(splitPoint(n), 3);//MAX_LEVEL_RENDER + 2);
         for (int i = 0; i < 4; i++) {
-            if (node->children[i] != NULL) {
-                MiddleNode *childNode = dynamic_cast<MiddleNode *>(node->children[i].get());
-                if (childNode != NULL) {
-                    drawer.set_color(Qt::gray);
-                    drawer.draw_line(node->range.getMiddlePoint(), childNode->range.getMiddlePoint(), 2);
-                    drawNode(childNode, drawer);
+            NodeRef child = node.children[i];
+            if (child != NULL_NODE) {
+                drawer.set_color(Qt::gray);
+                if (!isTermNode(child)) {
+                    drawer.draw_line(splitPoint(n), splitPoint(child), 2);
                 } else {
-                    drawer.set_color(Qt::gray);
-                    drawer.draw_line(node->range.getMiddlePoint(), ((TermNode *) node->children[i].get())->point, 1);
-                    drawNode((TermNode *) node->children[i].get(), drawer);
+                    drawer.draw_line(splitPoint(n), tree.term(child).point, 1);
                 }
+                drawNode(child, drawer);
             }
         }
     }
 
-    Node *getRootFromSkipLevel(int viewLevel) const {
-        MiddleNode *node = dynamic_cast<MiddleNode *>(tree.lowDetailedRoot.get());
-        if (node != NULL) {
+    NodeRef getRootFromSkipLevel(int viewLevel) const {
+        NodeRef node = tree.lowDetailedRoot;
+        if (node != NULL_NODE && !isTermNode(node)) {
             for (int i = 1; i < tree.skipLevels - viewLevel; i++) {
-                node = node->linkToMoreDetailed.get();
-                assert (node != NULL);
+                node = tree.middle(node).linkToMoreDetailed;
+                assert (node != NULL_NODE);
             }
-            return node;
-        } else {
-            return tree.lowDetailedRoot.get();
         }
+        return node;
     }
 
-    void drawRectangles(MiddleNode *node, cg::visualization::drawer_type &drawer) const {
-        Range r = node->range;
+    void drawRectangles(NodeRef n, cg::visualization::drawer_type &drawer) const {
+        Range r = visibleRange(n);
         point_2f a(r.fromX, r.fromY);
         point_2f b(r.fromX, r.toY);
         point_2f c(r.toX, r.toY);
@@ -128,23 +128,23 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
         drawer.draw_line(c, d, 1);
         drawer.draw_line(d, a, 1);
 
-        float middleX = (r.fromX + r.toX) / 2;
-        float middleY = (r.fromY + r.toY) / 2;
+        point_2f split = splitPoint(n);
+        float middleX = split.x;
+        float middleY = split.y;
         drawer.set_color(Qt::darkBlue);
         drawer.draw_line(point_2f(middleX, r.fromY), point_2f(middleX, r.toY));
         drawer.draw_line(point_2f(r.fromX, middleY), point_2f(r.toX, middleY));
-        for (auto child : node->children) {
-            MiddleNode *childMiddle = dynamic_cast<MiddleNode *>(child.get());
-            if (childMiddle != NULL) {
-                drawRectangles(childMiddle, drawer);
+        for (NodeRef child : tree.middle(n).children) {
+            if (child != NULL_NODE && !isTermNode(child)) {
+                drawRectangles(child, drawer);
             }
         }
     }
 
     void draw(cg::visualization::drawer_type &drawer) const {
         if (layoutMode == 0) {
-            MiddleNode *node = dynamic_cast<MiddleNode *>(getRootFromSkipLevel(viewLevel));
-            if (node != NULL) {
+            NodeRef node = getRootFromSkipLevel(viewLevel);
+            if (node != NULL_NODE && !isTermNode(node)) {
                 drawRectangles(node, drawer);
             }
         }
@@ -161,7 +161,7 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
                 << (viewLevel + 1) << "/" << tree.skipLevels << ")" << cg::visualization::endl
                 << "press R to enter points for rectangle selection (after that - two RBUTTONS)" << cg::visualization::endl
                 << "press D and click RBUTTON on existing point to delete it" << cg::visualization::endl
-                << "nodesCount: " << nodesCount << cg::visualization::endl;
+                << "nodesCount: " << tree.nodesCount() << cg::visualization::endl;
 
         drawNodeNum(getRootFromSkipLevel(viewLevel), p);
     }
@@ -169,8 +169,7 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
     bool on_double_click(const point_2f &p) {
         isDeletingMode = false;
         layoutMode = 0;
-        nodeNextId = 1;
-        tree = SkipQuadTree();
+        tree.clear();
         viewLevel = 0;
         pointsCountToEnter = 0;
         return true;
@@ -214,17 +213,20 @@ struct triangulation_viewer : cg::visualization::viewer_adapter {
         }
     }
 
-    void traceMiddleNode(MiddleNode *node, int stackLevel) {
-        std::cout << "stackLevel=" << stackLevel << "\t " << *node << std::endl;
-        for (auto child : node->children) {
-            if (child == NULL) {
+    void traceMiddleNode(NodeRef node, int stackLevel) {
+        std::cout << "stackLevel=" << stackLevel << "\t ";
+        tree.printNode(std::cout, node);
+        std::cout << std::endl;
+        for (NodeRef child : tree.middle(node).children) {
+            if (child == NULL_NODE) {
                 continue;
             }
-            MiddleNode *middleChild = dynamic_cast<MiddleNode *>(child.get());
-            if (middleChild != NULL) {
-                traceMiddleNode(middleChild, stackLevel + 1);
+            if (!isTermNode(child)) {
+                traceMiddleNode(child, stackLevel + 1);
             } else {
-                std::cout << "stackLevel=" << stackLevel + 1 << "\t " << *((TermNode *) child.get()) << std::endl;
+                std::cout << "stackLevel=" << stackLevel + 1 << "\t ";
+                tree.printNode(std::cout, child);
+                std::cout << std::endl;
             }
         }
     }
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+
+#include <boost/optional.hpp>
+
+// Floating-point expansion arithmetic after J. R. Shewchuk,
+// "Adaptive Precision Floating-Point Arithmetic and Fast Robust Geometric Predicates".
+// An expansion is a sum of nonoverlapping doubles ordered by increasing magnitude,
+// its sign is the sign of the last (largest) component.
+
+namespace cg
+{
+namespace expansion
+{
+   // half of the machine epsilon, the relative rounding error bound
+   inline double unit_roundoff()
+   {
+      return std::numeric_limits<double>::epsilon() / 2;
+   }
+
+   inline void two_sum(double a, double b, double & x, double & y)
+   {
+      x = a + b;
+      double bv = x - a;
+      double av = x - bv;
+      y = (a - av) + (b - bv);
+   }
+
+   inline void two_diff(double a, double b, double & x, double & y)
+   {
+      x = a - b;
+      double bv = a - x;
+      double av = x + bv;
+      y = (a - av) + (bv - b);
+   }
+
+   inline double two_diff_tail(double a, double b, double x)
+   {
+      double bv = a - x;
+      double av = x + bv;
+      return (a - av) + (bv - b);
+   }
+
+   inline void split(double a, double & hi, double & lo)
+   {
+      double c = 134217729. * a; // 2^27 + 1
+      double big = c - a;
+      hi = c - big;
+      lo = a - hi;
+   }
+
+   inline void two_product(double a, double b, double & x, double & y)
+   {
+      x = a * b;
+#ifdef __FMA__
+      y = std::fma(a, b, -x);
+#else
+      double ahi, alo, bhi, blo;
+      split(a, ahi, alo);
+      split(b, bhi, blo);
+      y = alo * blo - (((x - ahi * bhi) - alo * bhi) - ahi * blo);
+#endif
+   }
+
+   // (a1 + a0) - (b1 + b0) = x[3] + x[2] + x[1] + x[0]
+   inline void two_two_diff(double a1, double a0, double b1, double b0, double * x)
+   {
+      double i, j, k;
+      two_diff(a0, b0, i, x[0]);
+      two_sum(a1, i, j, k);
+      two_diff(k, b1, i, x[1]);
+      two_sum(j, i, x[3], x[2]);
+   }
+
+   // h = e + f with zero components removed, h must have room for elen + flen components
+   inline int sum(int elen, double const * e, int flen, double const * f, double * h)
+   {
+      int eindex = 0, findex = 0, hindex = 0;
+
+      // merges components of e and f by increasing magnitude
+      auto next = [&] () -> double
+      {
+         if (findex == flen || (eindex != elen && (f[findex] > e[eindex]) == (f[findex] > -e[eindex])))
+            return e[eindex++];
+         return f[findex++];
+      };
+
+      double q = next();
+      while (eindex != elen || findex != flen)
+      {
+         double qnew, hh;
+         two_sum(q, next(), qnew, hh);
+         q = qnew;
+         if (hh != 0)
+            h[hindex++] = hh;
+      }
+
+      if (q != 0 || hindex == 0)
+         h[hindex++] = q;
+
+      return hindex;
+   }
+
+   inline double estimate(int elen, double const * e)
+   {
+      double q = e[0];
+      for (int i = 1; i < elen; ++i)
+         q += e[i];
+      return q;
+   }
+
+   inline int sign(double v)
+   {
+      return v > 0 ? 1 : (v < 0 ? -1 : 0);
+   }
+
+   // inputs must be zero or within [2^-450, 2^450] in magnitude for every product
+   // of differences and their tails to be exact (no underflow, no overflow)
+   inline bool in_exact_range(double v)
+   {
+      double const lo = std::ldexp(1., -450);
+      double const hi = std::ldexp(1., 450);
+      double a = std::fabs(v);
+      return a == 0 || (a >= lo && a <= hi);
+   }
+
+   // Sign of (p1 - p2) * (q1 - q2) - (r1 - r2) * (s1 - s2), computed in tiers of growing
+   // precision: rounded differences with exact products, then first-order tail
+   // corrections, then the exact expansion. No heap allocation is made.
+   // Returns boost::none if the inputs are out of the range where this is exact.
+   inline boost::optional<int> diff_product_sign(double p1, double p2, double q1, double q2,
+                                                 double r1, double r2, double s1, double s2)
+   {
+      if (!(in_exact_range(p1) && in_exact_range(p2) && in_exact_range(q1) && in_exact_range(q2)
+            && in_exact_range(r1) && in_exact_range(r2) && in_exact_range(s1) && in_exact_range(s2)))
+         return boost::none;
+
+      double const eps = unit_roundoff();
+      double const result_bound = (3 + 8 * eps) * eps;
+      double const bound_b = (2 + 12 * eps) * eps;
+      double const bound_c = (9 + 64 * eps) * eps * eps;
+
+      double p = p1 - p2, q = q1 - q2, r = r1 - r2, s = s1 - s2;
+
+      double lhs, lhs_tail, rhs, rhs_tail;
+      two_product(p, q, lhs, lhs_tail);
+      two_product(r, s, rhs, rhs_tail);
+
+      double detsum = std::fabs(lhs) + std::fabs(rhs);
+
+      double b[4];
+      two_two_diff(lhs, lhs_tail, rhs, rhs_tail, b);
+
+      double det = estimate(4, b);
+      double err = bound_b * detsum;
+      if (det >= err || -det >= err)
+         return sign(det);
+
+      double ptail = two_diff_tail(p1, p2, p);
+      double qtail = two_diff_tail(q1, q2, q);
+      double rtail = two_diff_tail(r1, r2, r);
+      double stail = two_diff_tail(s1, s2, s);
+
+      if (ptail == 0 && qtail == 0 && rtail == 0 && stail == 0)
+         return sign(det);
+
+      err = bound_c * detsum + result_bound * std::fabs(det);
+      det += (p * qtail + q * ptail) - (r * stail + s * rtail);
+      if (det >= err || -det >= err)
+         return sign(det);
+
+      double u[4], c1[8], c2[12], d[16];
+      double x1, x0, y1, y0;
+
+      two_product(ptail, q, x1, x0);
+      two_product(rtail, s, y1, y0);
+      two_two_diff(x1, x0, y1, y0, u);
+      int c1len = sum(4, b, 4, u, c1);
+
+      two_product(p, qtail, x1, x0);
+      two_product(r, stail, y1, y0);
+      two_two_diff(x1, x0, y1, y0, u);
+      int c2len = sum(c1len, c1, 4, u, c2);
+
+      two_product(ptail, qtail, x1, x0);
+      two_product(rtail, stail, y1, y0);
+      two_two_diff(x1, x0, y1, y0, u);
+      int dlen = sum(c2len, c2, 4, u, d);
+
+      return sign(d[dlen - 1]);
+   }
+}
+}
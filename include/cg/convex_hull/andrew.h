@@ -2,6 +2,7 @@
 
 #include <algorithm>
 #include <cg/operations/orientation.h>
+#include <cg/convex_hull/cull_interior.h>
 
 #include "graham.h"
 
@@ -38,4 +39,11 @@ namespace cg
 
       return contour_graham_hull(t, q);
    }
+
+   // cull: drop points certainly inside the hull with cull_interior first
+   template <class RandIter>
+   RandIter andrew_hull(RandIter p, RandIter q, bool cull)
+   {
+      return andrew_hull(p, cull ? cull_interior(p, q) : q);
+   }
 }
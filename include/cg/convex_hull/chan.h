@@ -0,0 +1,205 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <unordered_map>
+
+#include <cg/operations/orientation.h>
+#include <cg/convex_hull/cull_interior.h>
+
+#include "graham.h"
+
+namespace cg
+{
+   namespace detail
+   {
+      // true if b should follow p instead of a when wrapping counterclockwise
+      inline bool chan_better(point_2 const & p, point_2 const & a, point_2 const & b)
+      {
+         switch (orientation(p, a, b))
+         {
+         case CG_RIGHT: return true;
+         case CG_LEFT: return false;
+         default: return collinear_are_ordered_along_line(p, a, b);
+         }
+      }
+
+      template <class RandIter>
+      size_t chan_tangent_linear(point_2 const & p, RandIter v, size_t k)
+      {
+         size_t best = k;
+         for (size_t i = 0; i != k; ++i)
+         {
+            if (v[i] == p)
+               continue;
+
+            if (best == k || chan_better(p, v[best], v[i]))
+               best = i;
+         }
+         return best;
+      }
+
+      // Index of the vertex of the counterclockwise convex polygon v[0, k) that follows p
+      // in a counterclockwise wrap, k if every vertex equals p.
+      // Binary search after D. Sunday, the result is verified locally and
+      // degenerate cases (p on the polygon, collinear edges) fall back to a linear scan.
+      template <class RandIter>
+      size_t chan_tangent(point_2 const & p, RandIter v, size_t k)
+      {
+         if (k <= 3)
+            return chan_tangent_linear(p, v, k);
+
+         auto at = [v, k] (size_t i) -> point_2 const & { return v[i % k]; };
+         auto above = [&p] (point_2 const & a, point_2 const & b) { return orientation(p, a, b) == CG_LEFT; };
+         auto below = [&p] (point_2 const & a, point_2 const & b) { return orientation(p, a, b) == CG_RIGHT; };
+
+         size_t res = k;
+         if (below(at(1), at(0)) && !above(at(k - 1), at(0)))
+         {
+            res = 0;
+         }
+         else
+         {
+            for (size_t a = 0, b = k; b - a > 1; )
+            {
+               size_t c = (a + b) / 2;
+               bool dn_c = below(at(c + 1), at(c));
+               if (dn_c && !above(at(c - 1), at(c)))
+               {
+                  res = c;
+                  break;
+               }
+
+               if (above(at(a + 1), at(a)))
+               {
+                  if (dn_c || above(at(a), at(c)))
+                     b = c;
+                  else
+                     a = c;
+               }
+               else
+               {
+                  if (dn_c && below(at(a), at(c)))
+                     b = c;
+                  else
+                     a = c;
+               }
+            }
+         }
+
+         if (res == k || at(res) == p
+             || orientation(p, at(res), at(res + 1)) == CG_RIGHT
+             || orientation(p, at(res), at(res + k - 1)) == CG_RIGHT)
+         {
+            return chan_tangent_linear(p, v, k);
+         }
+
+         // a strictly convex polygon has at most two vertices on the tangent line, take the farther one
+         size_t next = (res + 1) % k;
+         if (at(next) != p && orientation(p, at(res), at(next)) == CG_COLLINEAR
+             && collinear_are_ordered_along_line(p, at(res), at(next)))
+         {
+            return next;
+         }
+
+         return res;
+      }
+
+      // Wraps the mini-hulls of groups of m points, writes positions of hull vertices to hull.
+      // Returns false if the hull has more than m vertices.
+      template <class RandIter>
+      bool chan_wrap(RandIter p, RandIter q, size_t m, std::vector<size_t> & hull)
+      {
+         size_t n = q - p;
+
+         std::vector<std::pair<size_t, size_t> > groups;
+         for (size_t from = 0; from < n; from += m)
+         {
+            size_t to = std::min(n, from + m);
+            groups.push_back(std::make_pair(from, cg::graham_hull(p + from, p + to) - p));
+         }
+
+         size_t start = std::min_element(p, q) - p;
+
+         hull.clear();
+         hull.push_back(start);
+
+         for (size_t step = 0; step != m; ++step)
+         {
+            point_2 const cur = p[hull.back()];
+
+            size_t best = n;
+            for (size_t g = 0; g != groups.size(); ++g)
+            {
+               size_t k = groups[g].second - groups[g].first;
+               size_t t = chan_tangent(cur, p + groups[g].first, k);
+               if (t == k)
+                  continue;
+
+               t += groups[g].first;
+               if (best == n || chan_better(cur, p[best], p[t]))
+                  best = t;
+            }
+
+            if (best == n || p[best] == p[start])
+               return true;
+
+            hull.push_back(best);
+         }
+
+         return false;
+      }
+   }
+
+   // Chan's output-sensitive hull, O(n log h).
+   // Same contract as graham_hull: the hull is moved to [p, result) in counterclockwise order.
+   template <class RandIter>
+   RandIter chan_hull(RandIter p, RandIter q)
+   {
+      if (p == q)
+         return p;
+
+      size_t n = q - p;
+      std::vector<size_t> hull;
+
+      for (size_t m = 4; ; m = (m >= n / m) ? n : m * m)
+      {
+         m = std::min(m, n);
+         if (detail::chan_wrap(p, q, m, hull))
+            break;
+      }
+
+      // moves hull vertices to the front keeping track of the ones displaced by swaps
+      std::unordered_map<size_t, size_t> pending;
+      for (size_t i = 0; i != hull.size(); ++i)
+         pending[hull[i]] = i;
+
+      for (size_t i = 0; i != hull.size(); ++i)
+      {
+         size_t from = hull[i];
+         pending.erase(from);
+         if (from == i)
+            continue;
+
+         std::iter_swap(p + i, p + from);
+
+         std::unordered_map<size_t, size_t>::iterator displaced = pending.find(i);
+         if (displaced != pending.end())
+         {
+            size_t order = displaced->second;
+            pending.erase(displaced);
+            hull[order] = from;
+            pending[from] = order;
+         }
+      }
+
+      return p + hull.size();
+   }
+
+   // see cull_interior
+   template <class RandIter>
+   RandIter chan_hull(RandIter p, RandIter q, bool cull)
+   {
+      return chan_hull(p, cull ? cull_interior(p, q) : q);
+   }
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+
+#include <cg/operations/orientation.h>
+#include <cg/operations/orientation_batch.h>
+
+namespace cg
+{
+   namespace detail
+   {
+      // edge a -> a + d of a counterclockwise polygon
+      struct cull_edge
+      {
+         double ax, ay, dx, dy;
+      };
+
+      // strictly left of every edge, decided by the orientation_d filter only:
+      // a point the filter can not certify is reported as not inside
+      inline bool cull_inside(std::vector<cull_edge> const & edges, point_2 const & pt)
+      {
+         for (size_t e = 0; e != edges.size(); ++e)
+         {
+            double l = edges[e].dx * (pt.y - edges[e].ay);
+            double r = edges[e].dy * (pt.x - edges[e].ax);
+            double eps = (fabs(l) + fabs(r)) * 8 * std::numeric_limits<double>::epsilon();
+            if (!(l - r > eps))
+               return false;
+         }
+         return true;
+      }
+
+#if defined(__AVX512F__)
+      const size_t cull_lanes = 8;
+
+      inline unsigned cull_inside_lanes(std::vector<cull_edge> const & edges, point_2 const * pts)
+      {
+         __m512d x, y;
+         load_8(pts, x, y);
+
+         __mmask8 inside = 0xFF;
+         __m512d factor = _mm512_set1_pd(8 * std::numeric_limits<double>::epsilon());
+         for (size_t e = 0; e != edges.size(); ++e)
+         {
+            __m512d l = _mm512_mul_pd(_mm512_set1_pd(edges[e].dx), _mm512_sub_pd(y, _mm512_set1_pd(edges[e].ay)));
+            __m512d r = _mm512_mul_pd(_mm512_set1_pd(edges[e].dy), _mm512_sub_pd(x, _mm512_set1_pd(edges[e].ax)));
+            __m512d eps = _mm512_mul_pd(_mm512_add_pd(_mm512_abs_pd(l), _mm512_abs_pd(r)), factor);
+            inside &= _mm512_cmp_pd_mask(_mm512_sub_pd(l, r), eps, _CMP_GT_OQ);
+         }
+         return inside;
+      }
+#elif defined(__AVX2__)
+      const size_t cull_lanes = 4;
+
+      inline unsigned cull_inside_lanes(std::vector<cull_edge> const & edges, point_2 const * pts)
+      {
+         __m256d x, y;
+         load_4(pts, x, y);
+
+         __m256d inside = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+         __m256d sign = _mm256_set1_pd(-0.);
+         __m256d factor = _mm256_set1_pd(8 * std::numeric_limits<double>::epsilon());
+         for (size_t e = 0; e != edges.size(); ++e)
+         {
+            __m256d l = _mm256_mul_pd(_mm256_set1_pd(edges[e].dx), _mm256_sub_pd(y, _mm256_set1_pd(edges[e].ay)));
+            __m256d r = _mm256_mul_pd(_mm256_set1_pd(edges[e].dy), _mm256_sub_pd(x, _mm256_set1_pd(edges[e].ax)));
+            __m256d eps = _mm256_mul_pd(_mm256_add_pd(_mm256_andnot_pd(sign, l), _mm256_andnot_pd(sign, r)), factor);
+            inside = _mm256_and_pd(inside, _mm256_cmp_pd(_mm256_sub_pd(l, r), eps, _CMP_GT_OQ));
+         }
+         return _mm256_movemask_pd(inside);
+      }
+#elif defined(__SSE2__)
+      const size_t cull_lanes = 2;
+
+      inline unsigned cull_inside_lanes(std::vector<cull_edge> const & edges, point_2 const * pts)
+      {
+         __m128d x, y;
+         load_2(pts, x, y);
+
+         __m128d inside = _mm_castsi128_pd(_mm_set1_epi32(-1));
+         __m128d sign = _mm_set1_pd(-0.);
+         __m128d factor = _mm_set1_pd(8 * std::numeric_limits<double>::epsilon());
+         for (size_t e = 0; e != edges.size(); ++e)
+         {
+            __m128d l = _mm_mul_pd(_mm_set1_pd(edges[e].dx), _mm_sub_pd(y, _mm_set1_pd(edges[e].ay)));
+            __m128d r = _mm_mul_pd(_mm_set1_pd(edges[e].dy), _mm_sub_pd(x, _mm_set1_pd(edges[e].ax)));
+            __m128d eps = _mm_mul_pd(_mm_add_pd(_mm_andnot_pd(sign, l), _mm_andnot_pd(sign, r)), factor);
+            inside = _mm_and_pd(inside, _mm_cmpgt_pd(_mm_sub_pd(l, r), eps));
+         }
+         return _mm_movemask_pd(inside);
+      }
+#endif
+
+      // the x / y / x + y / x - y extremes in counterclockwise order, consecutive duplicates removed
+      template <class RandIter>
+      std::vector<point_2> cull_octagon(RandIter p, RandIter q)
+      {
+         point_2 ext[8];
+         std::fill(ext, ext + 8, *p);
+
+         for (RandIter it = p; it != q; ++it)
+         {
+            point_2 const & pt = *it;
+            if (pt.y < ext[0].y) ext[0] = pt;
+            if (pt.x - pt.y > ext[1].x - ext[1].y) ext[1] = pt;
+            if (pt.x > ext[2].x) ext[2] = pt;
+            if (pt.x + pt.y > ext[3].x + ext[3].y) ext[3] = pt;
+            if (pt.y > ext[4].y) ext[4] = pt;
+            if (pt.y - pt.x > ext[5].y - ext[5].x) ext[5] = pt;
+            if (pt.x < ext[6].x) ext[6] = pt;
+            if (pt.x + pt.y < ext[7].x + ext[7].y) ext[7] = pt;
+         }
+
+         std::vector<point_2> res;
+         for (size_t l = 0; l != 8; ++l)
+         {
+            if (res.empty() || (res.back() != ext[l] && res.front() != ext[l]))
+               res.push_back(ext[l]);
+         }
+         return res;
+      }
+   }
+
+   // Akl-Toussaint heuristic: moves the points that are certainly strictly inside the octagon
+   // of the x / y / x + y / x - y extremes (so can not be on the hull) to the end of [p, q).
+   // Returns the end of the remaining points, all hull vertices stay in [p, result).
+   template <class RandIter>
+   RandIter cull_interior(RandIter p, RandIter q)
+   {
+      if (q - p < 9)
+         return q;
+
+      std::vector<point_2> oct = detail::cull_octagon(p, q);
+      if (oct.size() < 3)
+         return q;
+
+      // ties among the extremes may produce a polygon that is not convex, then nothing is culled
+      for (size_t l = 0; l != oct.size(); ++l)
+      {
+         if (orientation(oct[l], oct[(l + 1) % oct.size()], oct[(l + 2) % oct.size()]) == CG_RIGHT)
+            return q;
+      }
+
+      std::vector<detail::cull_edge> edges;
+      for (size_t l = 0; l != oct.size(); ++l)
+      {
+         point_2 const & a = oct[l];
+         point_2 const & b = oct[(l + 1) % oct.size()];
+         detail::cull_edge e = {a.x, a.y, b.x - a.x, b.y - a.y};
+         edges.push_back(e);
+      }
+
+      size_t n = q - p;
+      std::vector<char> inside(n);
+      size_t i = 0;
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+      std::vector<point_2> block(detail::cull_lanes);
+      for (; i + detail::cull_lanes <= n; i += detail::cull_lanes)
+      {
+         std::copy(p + i, p + i + detail::cull_lanes, block.begin());
+         unsigned mask = detail::cull_inside_lanes(edges, &block[0]);
+         for (size_t l = 0; l != detail::cull_lanes; ++l)
+            inside[i + l] = (mask >> l) & 1;
+      }
+#endif
+
+      for (; i != n; ++i)
+         inside[i] = detail::cull_inside(edges, p[i]);
+
+      RandIter out = p;
+      for (i = 0; i != n; ++i)
+      {
+         if (!inside[i])
+            std::iter_swap(out++, p + i);
+      }
+      return out;
+   }
+}
@@ -0,0 +1,455 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+
+#include <boost/numeric/interval.hpp>
+#include <boost/optional.hpp>
+#include <gmpxx.h>
+
+#include <cg/primitives/point.h>
+#include <cg/operations/orientation.h>
+#include <cg/convex_hull/naive_dynamic.h>
+
+namespace cg
+{
+   namespace detail
+   {
+      // Lines (a, a2) and (b, b2) cross at X, is X to the left of r?
+      // "Left" is the lexicographic order of points, i.e. x with ties broken by y,
+      // which is the x order after an infinitesimal shear x' = x + eps * y.
+      struct crossing_before_d
+      {
+         boost::optional<bool> operator() (point_2 const & a, point_2 const & a2,
+                                           point_2 const & b, point_2 const & b2, point_2 const & r) const
+         {
+            double adx = a2.x - a.x, ady = a2.y - a.y;
+            double bdx = b2.x - b.x, bdy = b2.y - b.y;
+
+            double d1 = adx * bdy, d2 = ady * bdx;
+            double c1 = (b.x - a.x) * bdy, c2 = (b.y - a.y) * bdx;
+            double d = d1 - d2, c = c1 - c2;
+            double e1 = (a.x - r.x) * d, e2 = c * adx;
+            double e = e1 + e2;
+
+            double eps = std::numeric_limits<double>::epsilon();
+            double dperm = fabs(d1) + fabs(d2);
+            double eperm = fabs(a.x - r.x) * dperm + (fabs(c1) + fabs(c2)) * fabs(adx);
+
+            if (fabs(d) <= 4 * eps * dperm || fabs(e) <= 16 * eps * eperm)
+               return boost::none;
+
+            return (e > 0) != (d > 0);
+         }
+      };
+
+      struct crossing_before_i
+      {
+         boost::optional<bool> operator() (point_2 const & a, point_2 const & a2,
+                                           point_2 const & b, point_2 const & b2, point_2 const & r) const
+         {
+            typedef boost::numeric::interval_lib::unprotect<boost::numeric::interval<double> >::type interval;
+
+            boost::numeric::interval<double>::traits_type::rounding _;
+
+            interval d = (interval(a2.x) - a.x) * (interval(b2.y) - b.y) - (interval(a2.y) - a.y) * (interval(b2.x) - b.x);
+            interval c = (interval(b.x) - a.x) * (interval(b2.y) - b.y) - (interval(b.y) - a.y) * (interval(b2.x) - b.x);
+            interval e = (interval(a.x) - r.x) * d + c * (interval(a2.x) - a.x);
+
+            if (!(d.lower() > 0 || d.upper() < 0) || !(e.lower() > 0 || e.upper() < 0))
+               return boost::none;
+
+            // X.x - r.x has the sign of e / d
+            return (e.lower() > 0) != (d.lower() > 0);
+         }
+      };
+
+      struct crossing_before_r
+      {
+         boost::optional<bool> operator() (point_2 const & a, point_2 const & a2,
+                                           point_2 const & b, point_2 const & b2, point_2 const & r) const
+         {
+            mpq_class d = (mpq_class(a2.x) - a.x) * (mpq_class(b2.y) - b.y) - (mpq_class(a2.y) - a.y) * (mpq_class(b2.x) - b.x);
+            mpq_class c = (mpq_class(b.x) - a.x) * (mpq_class(b2.y) - b.y) - (mpq_class(b.y) - a.y) * (mpq_class(b2.x) - b.x);
+            mpq_class e = (mpq_class(a.x) - r.x) * d + c * (mpq_class(a2.x) - a.x);
+
+            // equal x, the shear term decides
+            if (cmp(e, 0) == 0)
+               e = (mpq_class(a.y) - r.y) * d + c * (mpq_class(a2.y) - a.y);
+
+            return sgn(e) * sgn(d) < 0;
+         }
+      };
+
+      inline bool crossing_before(point_2 const & a, point_2 const & a2,
+                                  point_2 const & b, point_2 const & b2, point_2 const & r)
+      {
+         if (boost::optional<bool> v = crossing_before_d()(a, a2, b, b2, r))
+            return *v;
+
+         if (boost::optional<bool> v = crossing_before_i()(a, a2, b, b2, r))
+            return *v;
+
+         return *crossing_before_r()(a, a2, b, b2, r);
+      }
+   }
+
+   // Fully dynamic convex hull after Overmars and van Leeuwen.
+   // Points are kept in the leaves of a balanced (AVL) tree ordered lexicographically,
+   // every inner node stores the bridges joining the upper and the lower hulls of its children.
+   // A bridge is found by a simultaneous descent into both children, so add_point and
+   // remove_point take O(log^2 n), get_hull takes O(h log n).
+   struct dynamic_hull
+   {
+      dynamic_hull()
+         : root_(-1), size_(0), hull_valid_(false), points_valid_(false)
+      {}
+
+      void add_point(point_2 p)
+      {
+         root_ = insert(root_, p);
+         size_++;
+         invalidate();
+      }
+
+      void remove_point(const point_2& point)
+      {
+         point_2 p = point;
+
+         bool removed = false;
+         root_ = erase(root_, p, removed);
+         if (removed)
+         {
+            size_--;
+            invalidate();
+         }
+      }
+
+      // counterclockwise, starting from the lexicographically smallest point, no collinear vertices;
+      // the iterators stay valid until the next modification
+      const std::pair<vect_it, vect_it> get_hull()
+      {
+         if (!hull_valid_)
+         {
+            build_hull();
+            hull_valid_ = true;
+         }
+         return std::pair<vect_it, vect_it>(hull_.begin(), hull_.end());
+      }
+
+      // O(n), meant for visualization
+      const std::pair<vect_it, vect_it> get_all_points()
+      {
+         if (!points_valid_)
+         {
+            points_.clear();
+            if (root_ != -1)
+               collect(root_, points_);
+            points_valid_ = true;
+         }
+         return std::pair<vect_it, vect_it>(points_.begin(), points_.end());
+      }
+
+      size_t size() const
+      {
+         return size_;
+      }
+
+   private:
+      enum { UPPER = 0, LOWER = 1 };
+
+      struct node
+      {
+         point_2 pt;
+         int left, right;
+         int height;
+         int count;
+         int min_leaf, max_leaf;
+         int bridge[2][2];
+      };
+
+      bool is_leaf(int v) const
+      {
+         return nodes_[v].left == -1;
+      }
+
+      point_2 const & pt(int leaf) const
+      {
+         return nodes_[leaf].pt;
+      }
+
+      int new_node()
+      {
+         if (!free_.empty())
+         {
+            int v = free_.back();
+            free_.pop_back();
+            return v;
+         }
+         nodes_.push_back(node());
+         return nodes_.size() - 1;
+      }
+
+      int new_leaf(point_2 const & p)
+      {
+         int v = new_node();
+         node & n = nodes_[v];
+         n.pt = p;
+         n.left = n.right = -1;
+         n.height = 1;
+         n.count = 1;
+         n.min_leaf = n.max_leaf = v;
+         return v;
+      }
+
+      int new_inner(int l, int r)
+      {
+         int v = new_node();
+         nodes_[v].left = l;
+         nodes_[v].right = r;
+         update(v);
+         return v;
+      }
+
+      void invalidate()
+      {
+         hull_valid_ = false;
+         points_valid_ = false;
+      }
+
+      // orientation as seen from above for the upper hull, from below for the lower one
+      static int side(int h, point_2 const & a, point_2 const & b, point_2 const & c)
+      {
+         int res = orientation(a, b, c);
+         return h == UPPER ? res : -res;
+      }
+
+      // leaves (p, q) of the bridge between the h-hulls of the children of v
+      void find_bridge(int v, int h, int & p, int & q) const
+      {
+         point_2 const & r0 = pt(nodes_[nodes_[v].right].min_leaf);
+
+         int a = nodes_[v].left;
+         int b = nodes_[v].right;
+
+         while (!is_leaf(a) || !is_leaf(b))
+         {
+            if (is_leaf(b))
+            {
+               // q is known, p is at or before the left end of a's bridge iff q is on or above it
+               point_2 const & q = pt(b);
+               a = side(h, pt(nodes_[a].bridge[h][0]), pt(nodes_[a].bridge[h][1]), q) >= 0 ? nodes_[a].left : nodes_[a].right;
+               continue;
+            }
+
+            if (is_leaf(a))
+            {
+               point_2 const & p = pt(a);
+               b = side(h, pt(nodes_[b].bridge[h][0]), pt(nodes_[b].bridge[h][1]), p) >= 0 ? nodes_[b].right : nodes_[b].left;
+               continue;
+            }
+
+            point_2 const & a1 = pt(nodes_[a].bridge[h][0]);
+            point_2 const & a2 = pt(nodes_[a].bridge[h][1]);
+            point_2 const & b1 = pt(nodes_[b].bridge[h][0]);
+            point_2 const & b2 = pt(nodes_[b].bridge[h][1]);
+
+            if (side(h, a1, a2, b1) >= 0 || side(h, a1, a2, b2) >= 0)
+               a = nodes_[a].left;
+            else if (side(h, b1, b2, a1) >= 0 || side(h, b1, b2, a2) >= 0)
+               b = nodes_[b].right;
+            else if (detail::crossing_before(a1, a2, b1, b2, r0))
+               // the right part lies entirely below the line of a's bridge
+               a = nodes_[a].right;
+            else
+               // the left part lies entirely below the line of b's bridge
+               b = nodes_[b].left;
+         }
+
+         p = a;
+         q = b;
+      }
+
+      void update(int v)
+      {
+         node & n = nodes_[v];
+         n.height = std::max(nodes_[n.left].height, nodes_[n.right].height) + 1;
+         n.min_leaf = nodes_[n.left].min_leaf;
+         n.max_leaf = nodes_[n.right].max_leaf;
+         find_bridge(v, UPPER, n.bridge[UPPER][0], n.bridge[UPPER][1]);
+         find_bridge(v, LOWER, n.bridge[LOWER][0], n.bridge[LOWER][1]);
+      }
+
+      int balance_factor(int v) const
+      {
+         return nodes_[nodes_[v].left].height - nodes_[nodes_[v].right].height;
+      }
+
+      int rotate_right(int v)
+      {
+         int l = nodes_[v].left;
+         nodes_[v].left = nodes_[l].right;
+         update(v);
+         nodes_[l].right = v;
+         update(l);
+         return l;
+      }
+
+      int rotate_left(int v)
+      {
+         int r = nodes_[v].right;
+         nodes_[v].right = nodes_[r].left;
+         update(v);
+         nodes_[r].left = v;
+         update(r);
+         return r;
+      }
+
+      int rebalance(int v)
+      {
+         int bf = balance_factor(v);
+         if (bf > 1)
+         {
+            if (balance_factor(nodes_[v].left) < 0)
+               nodes_[v].left = rotate_left(nodes_[v].left);
+            return rotate_right(v);
+         }
+         if (bf < -1)
+         {
+            if (balance_factor(nodes_[v].right) > 0)
+               nodes_[v].right = rotate_right(nodes_[v].right);
+            return rotate_left(v);
+         }
+         update(v);
+         return v;
+      }
+
+      int insert(int v, point_2 const & p)
+      {
+         if (v == -1)
+            return new_leaf(p);
+
+         if (is_leaf(v))
+         {
+            if (pt(v) == p)
+            {
+               nodes_[v].count++;
+               return v;
+            }
+
+            int leaf = new_leaf(p);
+            return p < pt(v) ? new_inner(leaf, v) : new_inner(v, leaf);
+         }
+
+         if (!(pt(nodes_[nodes_[v].left].max_leaf) < p))
+         {
+            int l = insert(nodes_[v].left, p);
+            if (l == nodes_[v].left && is_leaf(l))
+               return v; // only the multiplicity changed
+            nodes_[v].left = l;
+         }
+         else
+         {
+            int r = insert(nodes_[v].right, p);
+            if (r == nodes_[v].right && is_leaf(r))
+               return v;
+            nodes_[v].right = r;
+         }
+
+         return rebalance(v);
+      }
+
+      int erase(int v, point_2 const & p, bool & removed)
+      {
+         if (v == -1)
+            return -1;
+
+         if (is_leaf(v))
+         {
+            if (pt(v) != p)
+               return v;
+
+            removed = true;
+            if (--nodes_[v].count != 0)
+               return v;
+
+            free_.push_back(v);
+            return -1;
+         }
+
+         bool go_left = !(pt(nodes_[nodes_[v].left].max_leaf) < p);
+         int & child = go_left ? nodes_[v].left : nodes_[v].right;
+         int res = erase(child, p, removed);
+
+         if (!removed || (res == child && is_leaf(res)))
+            return v;
+
+         if (res == -1)
+         {
+            int other = go_left ? nodes_[v].right : nodes_[v].left;
+            free_.push_back(v);
+            return other;
+         }
+
+         child = res;
+         return rebalance(v);
+      }
+
+      // vertices of the h-hull of v lying in [lo, hi], in lexicographic order
+      void emit(int v, int h, point_2 const & lo, point_2 const & hi, std::vector<point_2> & out) const
+      {
+         if (hi < lo || pt(nodes_[v].max_leaf) < lo || hi < pt(nodes_[v].min_leaf))
+            return;
+
+         if (is_leaf(v))
+         {
+            out.push_back(pt(v));
+            return;
+         }
+
+         point_2 const & p = pt(nodes_[v].bridge[h][0]);
+         point_2 const & q = pt(nodes_[v].bridge[h][1]);
+         emit(nodes_[v].left, h, lo, std::min(hi, p), out);
+         emit(nodes_[v].right, h, std::max(lo, q), hi, out);
+      }
+
+      void build_hull()
+      {
+         hull_.clear();
+         if (root_ == -1)
+            return;
+
+         point_2 const & lo = pt(nodes_[root_].min_leaf);
+         point_2 const & hi = pt(nodes_[root_].max_leaf);
+
+         emit(root_, LOWER, lo, hi, hull_);
+         if (hull_.size() < 2)
+            return;
+
+         std::vector<point_2> upper;
+         emit(root_, UPPER, lo, hi, upper);
+         hull_.insert(hull_.end(), upper.rbegin() + 1, upper.rend() - 1);
+      }
+
+      void collect(int v, std::vector<point_2> & out) const
+      {
+         if (is_leaf(v))
+         {
+            out.insert(out.end(), nodes_[v].count, pt(v));
+            return;
+         }
+         collect(nodes_[v].left, out);
+         collect(nodes_[v].right, out);
+      }
+
+      std::vector<node> nodes_;
+      std::vector<int> free_;
+      int root_;
+      size_t size_;
+
+      std::vector<point_2> hull_, points_;
+      bool hull_valid_, points_valid_;
+   };
+}
@@ -3,6 +3,7 @@
 #include <algorithm>
 
 #include <cg/operations/orientation.h>
+#include <cg/convex_hull/cull_interior.h>
 
 namespace cg
 {
@@ -77,4 +78,11 @@ namespace cg
 
       return contour_graham_hull(t, q);
    }
+
+   // with cull set, points certainly inside the hull are dropped first by cull_interior
+   template <class RandIter>
+   RandIter graham_hull(RandIter p, RandIter q, bool cull)
+   {
+      return graham_hull(p, cull ? cull_interior(p, q) : q);
+   }
 }
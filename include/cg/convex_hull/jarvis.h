@@ -3,6 +3,7 @@
 #include <algorithm>
 
 #include <cg/operations/orientation.h>
+#include <cg/convex_hull/cull_interior.h>
 
 namespace cg
 {
@@ -46,4 +47,11 @@ namespace cg
       }
       return remove_points_on_same_line(p, last + 1);
    }
+
+   // jarvis is O(nh), so culling the interior first pays off on large inputs
+   template <class RandIter>
+   RandIter jarvis_hull(RandIter p, RandIter q, bool cull)
+   {
+      return jarvis_hull(p, cull ? cull_interior(p, q) : q);
+   }
 }
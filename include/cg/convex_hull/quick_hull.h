@@ -3,6 +3,7 @@
 #include <cg/primitives/point.h>
 #include <cg/primitives/vector.h>
 #include <cg/operations/orientation.h>
+#include <cg/convex_hull/cull_interior.h>
 #include <algorithm>
 #include <utility>
 #include <functional>
@@ -61,6 +62,17 @@ namespace cg
        }
     };
 
+    struct pred_a
+    {
+       boost::optional<orientation_t> operator() (point_2 const & a, point_2 const & b, point_2 const & c, point_2 const & d) const
+       {
+          if (boost::optional<int> res = expansion::diff_product_sign(d.x, c.x, b.y, a.y, d.y, c.y, b.x, a.x))
+             return static_cast<orientation_t>(*res);
+
+          return boost::none;
+       }
+    };
+
     struct pred_r
     {
        boost::optional<orientation_t> operator() (point_2 const & a, point_2 const & b, point_2 const & c, point_2 const & d) const
@@ -88,6 +100,9 @@ namespace cg
        if (boost::optional<orientation_t> v = pred_i()(a, b, c, d))
           return *v;
 
+       if (boost::optional<orientation_t> v = pred_a()(a, b, c, d))
+          return *v;
+
        return *pred_r()(a, b, c, d);
     }
 
@@ -155,4 +170,11 @@ namespace cg
         RanIter second = build_part(bound, end, *begin);
         return swap_ranges(bound, second, first);
     }
+
+    // cull: drop points certainly inside the hull with cull_interior first
+    template <class RanIter>
+    RanIter quick_hull(RanIter begin, RanIter end, bool cull)
+    {
+        return quick_hull(begin, cull ? cull_interior(begin, end) : end);
+    }
 }
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <cg/convex_hull/quick_hull.h>
+
+#include <vector>
+#include <future>
+#include <iterator>
+
+namespace cg
+{
+    namespace detail
+    {
+        // ranges smaller than this are handled by the serial code
+        const size_t quick_hull_par_cutoff = 1 << 15;
+
+        template <class RanIter, class Compare>
+        RanIter parallel_max_element(RanIter begin, RanIter end, Compare comp, size_t threads)
+        {
+            size_t n = end - begin;
+            if (threads <= 1 || n < quick_hull_par_cutoff)
+            {
+                return std::max_element(begin, end, comp);
+            }
+
+            size_t chunk = (n + threads - 1) / threads;
+            std::vector<std::future<RanIter> > parts;
+            for (size_t from = 0; from < n; from += chunk)
+            {
+                RanIter b = begin + from;
+                RanIter e = begin + std::min(n, from + chunk);
+                parts.push_back(std::async(std::launch::async, [b, e, comp]()
+                {
+                    return std::max_element(b, e, comp);
+                }));
+            }
+
+            // chunks are merged left to right so the first maximum wins, as in std::max_element
+            RanIter best = parts[0].get();
+            for (size_t i = 1; i < parts.size(); i++)
+            {
+                RanIter it = parts[i].get();
+                if (comp(*best, *it))
+                {
+                    best = it;
+                }
+            }
+            return best;
+        }
+
+        // Reorders [begin, end) by class (classify returns 0 .. Classes - 1), the order inside a class is not kept.
+        // bounds[k] is set to the end of class k.
+        template <size_t Classes, class RanIter, class Classify>
+        void parallel_partition(RanIter begin, RanIter end, Classify classify, size_t threads, RanIter * bounds)
+        {
+            typedef typename std::iterator_traits<RanIter>::value_type value_type;
+
+            size_t n = end - begin;
+            size_t chunk = (n + threads - 1) / threads;
+            size_t chunks = (n + chunk - 1) / chunk;
+
+            std::vector<unsigned char> cls(n);
+            std::vector<size_t> offset(chunks * Classes, 0);
+
+            std::vector<std::future<void> > tasks;
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks.push_back(std::async(std::launch::async, [&, c]()
+                {
+                    for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+                    {
+                        cls[i] = classify(begin[i]);
+                        offset[c * Classes + cls[i]]++;
+                    }
+                }));
+            }
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks[c].get();
+            }
+
+            // counts become start positions: class-major, chunk-minor
+            size_t pos = 0;
+            for (size_t k = 0; k < Classes; k++)
+            {
+                for (size_t c = 0; c < chunks; c++)
+                {
+                    size_t count = offset[c * Classes + k];
+                    offset[c * Classes + k] = pos;
+                    pos += count;
+                }
+                bounds[k] = begin + pos;
+            }
+
+            std::vector<value_type> buffer(n);
+            tasks.clear();
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks.push_back(std::async(std::launch::async, [&, c]()
+                {
+                    for (size_t i = c * chunk; i < std::min(n, (c + 1) * chunk); i++)
+                    {
+                        buffer[offset[c * Classes + cls[i]]++] = begin[i];
+                    }
+                }));
+            }
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks[c].get();
+            }
+
+            tasks.clear();
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks.push_back(std::async(std::launch::async, [&, c]()
+                {
+                    size_t from = c * chunk;
+                    size_t to = std::min(n, (c + 1) * chunk);
+                    std::copy(buffer.begin() + from, buffer.begin() + to, begin + from);
+                }));
+            }
+            for (size_t c = 0; c < chunks; c++)
+            {
+                tasks[c].get();
+            }
+        }
+    }
+
+    template <class RanIter>
+    RanIter build_part_par(RanIter begin, RanIter end, point_2 const &last_point, size_t threads)
+    {
+        if (threads <= 1 || size_t(end - begin) < detail::quick_hull_par_cutoff)
+        {
+            return build_part(begin, end, last_point);
+        }
+
+        RanIter highest_point_iter = detail::parallel_max_element(begin, end, [begin, &last_point](point_2 const &largest, point_2 const &first)
+        {
+                return pred(largest, first, *begin, last_point) == CG_RIGHT;
+        }, threads);
+
+        point_2 highest_point = *highest_point_iter;
+
+        if (orientation(*begin, last_point, highest_point) == CG_COLLINEAR)
+        {
+            return begin + 1;
+        }
+        std::iter_swap(begin + 1, highest_point_iter);
+
+        RanIter bounds[3];
+        detail::parallel_partition<3>(begin + 2, end, [begin, &highest_point, &last_point](point_2 const &point)
+        {
+            if (orientation(*begin, highest_point, point) == CG_RIGHT)
+            {
+                return 0;
+            }
+            return orientation(highest_point, last_point, point) == CG_RIGHT ? 1 : 2;
+        }, threads, bounds);
+
+        RanIter first = bounds[0];
+        RanIter second = bounds[1];
+
+        std::iter_swap(begin + 1, first - 1);
+
+        size_t left_threads = threads / 2;
+        std::future<RanIter> first_end = std::async(std::launch::async, [begin, first, highest_point, left_threads]()
+        {
+            return build_part_par(begin, first - 1, highest_point, left_threads);
+        });
+        RanIter second_end = build_part_par(first - 1, second, last_point, threads - left_threads);
+        return swap_ranges(first - 1, second_end, first_end.get());
+    }
+
+    // Same contract as quick_hull: the hull is moved to [begin, result) in counterclockwise order.
+    // Up to threads tasks run the extreme point searches, the partitions and the two recursive branches.
+    template <class RanIter>
+    RanIter quick_hull_par(RanIter begin, RanIter end, size_t threads)
+    {
+        if (threads <= 1 || size_t(end - begin) < detail::quick_hull_par_cutoff)
+        {
+            return quick_hull(begin, end);
+        }
+
+        std::iter_swap(begin, detail::parallel_max_element(begin, end, [](point_2 const &a, point_2 const &b)
+        {
+            return b < a;
+        }, threads));
+        std::iter_swap(end - 1, detail::parallel_max_element(begin, end, [](point_2 const &a, point_2 const &b)
+        {
+            return a < b;
+        }, threads));
+
+        if (*begin == *(end - 1))
+        {
+            return ++begin;
+        }
+
+        RanIter bounds[2];
+        detail::parallel_partition<2>(begin + 1, end - 1, [begin, end](point_2 const &a)
+        {
+            return orientation(*begin, *(end - 1), a) == CG_RIGHT ? 0 : 1;
+        }, threads, bounds);
+        RanIter bound = bounds[0];
+
+        std::iter_swap(end - 1, bound);
+
+        size_t lower_threads = threads / 2;
+        point_2 first_point = *begin;
+        point_2 last_point = *bound;
+        std::future<RanIter> first = std::async(std::launch::async, [begin, bound, last_point, lower_threads]()
+        {
+            return build_part_par(begin, bound, last_point, lower_threads);
+        });
+        RanIter second = build_part_par(bound, end, first_point, threads - lower_threads);
+        return swap_ranges(bound, second, first.get());
+    }
+}
@@ -2,6 +2,7 @@
 
 #include "cg/primitives/point.h"
 #include "cg/primitives/contour.h"
+#include "cg/common/expansion.h"
 #include <boost/numeric/interval.hpp>
 #include <gmpxx.h>
 
@@ -66,6 +67,18 @@ namespace cg
       }
    };
 
+   // exact sign from floating-point expansions, no GMP and no allocation
+   struct orientation_a
+   {
+      boost::optional<orientation_t> operator() (point_2 const & a, point_2 const & b, point_2 const & c) const
+      {
+         if (boost::optional<int> res = expansion::diff_product_sign(b.x, a.x, c.y, a.y, b.y, a.y, c.x, a.x))
+            return static_cast<orientation_t>(*res);
+
+         return boost::none;
+      }
+   };
+
    struct orientation_r
    {
       boost::optional<orientation_t> operator() (point_2 const & a, point_2 const & b, point_2 const & c) const
@@ -93,6 +106,9 @@ namespace cg
       if (boost::optional<orientation_t> v = orientation_i()(a, b, c))
          return *v;
 
+      if (boost::optional<orientation_t> v = orientation_a()(a, b, c))
+         return *v;
+
       return *orientation_r()(a, b, c);
    }
 
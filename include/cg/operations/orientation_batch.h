@@ -0,0 +1,166 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+#include <cassert>
+
+#if defined(__AVX512F__) || defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include <cg/operations/orientation.h>
+
+namespace cg
+{
+   namespace detail
+   {
+      static_assert(sizeof(point_2) == 2 * sizeof(double), "point_2 must be laid out as {x, y}");
+
+      inline orientation_t orientation_exact(point_2 const & a, point_2 const & b, point_2 const & c)
+      {
+         if (boost::optional<orientation_t> v = orientation_i()(a, b, c))
+            return *v;
+
+         if (boost::optional<orientation_t> v = orientation_a()(a, b, c))
+            return *v;
+
+         return *orientation_r()(a, b, c);
+      }
+
+      // lanes accepted by the filter are taken from the masks, the rest go to the exact stages
+      inline void orientation_resolve(unsigned left, unsigned right, size_t lanes,
+                                      point_2 const * a, point_2 const * b, point_2 const * c,
+                                      orientation_t * out)
+      {
+         for (size_t l = 0; l != lanes; ++l)
+         {
+            if (left & (1u << l))
+               out[l] = CG_LEFT;
+            else if (right & (1u << l))
+               out[l] = CG_RIGHT;
+            else
+               out[l] = orientation_exact(a[l], b[l], c[l]);
+         }
+      }
+
+#if defined(__AVX512F__)
+      inline void load_8(point_2 const * p, __m512d & x, __m512d & y)
+      {
+         __m512i const xs = _mm512_set_epi64(14, 12, 10, 8, 6, 4, 2, 0);
+         __m512i const ys = _mm512_set_epi64(15, 13, 11, 9, 7, 5, 3, 1);
+
+         __m512d lo = _mm512_loadu_pd(&p[0].x);
+         __m512d hi = _mm512_loadu_pd(&p[4].x);
+         x = _mm512_permutex2var_pd(lo, xs, hi);
+         y = _mm512_permutex2var_pd(lo, ys, hi);
+      }
+
+      inline void orientation_batch_8(point_2 const * a, point_2 const * b, point_2 const * c, orientation_t * out)
+      {
+         __m512d ax, ay, bx, by, cx, cy;
+         load_8(a, ax, ay);
+         load_8(b, bx, by);
+         load_8(c, cx, cy);
+
+         __m512d l = _mm512_mul_pd(_mm512_sub_pd(bx, ax), _mm512_sub_pd(cy, ay));
+         __m512d r = _mm512_mul_pd(_mm512_sub_pd(by, ay), _mm512_sub_pd(cx, ax));
+         __m512d res = _mm512_sub_pd(l, r);
+         __m512d eps = _mm512_mul_pd(_mm512_add_pd(_mm512_abs_pd(l), _mm512_abs_pd(r)),
+                                     _mm512_set1_pd(8 * std::numeric_limits<double>::epsilon()));
+
+         unsigned left = _mm512_cmp_pd_mask(res, eps, _CMP_GT_OQ);
+         unsigned right = _mm512_cmp_pd_mask(res, _mm512_sub_pd(_mm512_setzero_pd(), eps), _CMP_LT_OQ);
+
+         orientation_resolve(left, right, 8, a, b, c, out);
+      }
+#elif defined(__AVX2__)
+      inline void load_4(point_2 const * p, __m256d & x, __m256d & y)
+      {
+         __m256d lo = _mm256_loadu_pd(&p[0].x);
+         __m256d hi = _mm256_loadu_pd(&p[2].x);
+         // unpack gives lanes in 0, 2, 1, 3 order
+         x = _mm256_permute4x64_pd(_mm256_unpacklo_pd(lo, hi), 0xD8);
+         y = _mm256_permute4x64_pd(_mm256_unpackhi_pd(lo, hi), 0xD8);
+      }
+
+      inline void orientation_batch_4(point_2 const * a, point_2 const * b, point_2 const * c, orientation_t * out)
+      {
+         __m256d ax, ay, bx, by, cx, cy;
+         load_4(a, ax, ay);
+         load_4(b, bx, by);
+         load_4(c, cx, cy);
+
+         __m256d sign = _mm256_set1_pd(-0.);
+         __m256d l = _mm256_mul_pd(_mm256_sub_pd(bx, ax), _mm256_sub_pd(cy, ay));
+         __m256d r = _mm256_mul_pd(_mm256_sub_pd(by, ay), _mm256_sub_pd(cx, ax));
+         __m256d res = _mm256_sub_pd(l, r);
+         __m256d eps = _mm256_mul_pd(_mm256_add_pd(_mm256_andnot_pd(sign, l), _mm256_andnot_pd(sign, r)),
+                                     _mm256_set1_pd(8 * std::numeric_limits<double>::epsilon()));
+
+         unsigned left = _mm256_movemask_pd(_mm256_cmp_pd(res, eps, _CMP_GT_OQ));
+         unsigned right = _mm256_movemask_pd(_mm256_cmp_pd(res, _mm256_xor_pd(eps, sign), _CMP_LT_OQ));
+
+         orientation_resolve(left, right, 4, a, b, c, out);
+      }
+#elif defined(__SSE2__)
+      inline void load_2(point_2 const * p, __m128d & x, __m128d & y)
+      {
+         __m128d lo = _mm_loadu_pd(&p[0].x);
+         __m128d hi = _mm_loadu_pd(&p[1].x);
+         x = _mm_unpacklo_pd(lo, hi);
+         y = _mm_unpackhi_pd(lo, hi);
+      }
+
+      inline void orientation_batch_2(point_2 const * a, point_2 const * b, point_2 const * c, orientation_t * out)
+      {
+         __m128d ax, ay, bx, by, cx, cy;
+         load_2(a, ax, ay);
+         load_2(b, bx, by);
+         load_2(c, cx, cy);
+
+         __m128d sign = _mm_set1_pd(-0.);
+         __m128d l = _mm_mul_pd(_mm_sub_pd(bx, ax), _mm_sub_pd(cy, ay));
+         __m128d r = _mm_mul_pd(_mm_sub_pd(by, ay), _mm_sub_pd(cx, ax));
+         __m128d res = _mm_sub_pd(l, r);
+         __m128d eps = _mm_mul_pd(_mm_add_pd(_mm_andnot_pd(sign, l), _mm_andnot_pd(sign, r)),
+                                  _mm_set1_pd(8 * std::numeric_limits<double>::epsilon()));
+
+         unsigned left = _mm_movemask_pd(_mm_cmpgt_pd(res, eps));
+         unsigned right = _mm_movemask_pd(_mm_cmplt_pd(res, _mm_xor_pd(eps, sign)));
+
+         orientation_resolve(left, right, 2, a, b, c, out);
+      }
+#endif
+   }
+
+   // out[i] = orientation(a[i], b[i], c[i]) for i in [0, n).
+   // The double filter of orientation_d runs on 8/4/2 lanes at once (AVX-512/AVX2/SSE2,
+   // whichever the compiler targets), only ambiguous lanes reach the exact stages.
+   inline void orientation_batch(point_2 const * a, point_2 const * b, point_2 const * c, size_t n, orientation_t * out)
+   {
+      size_t i = 0;
+
+#if defined(__AVX512F__)
+      for (; i + 8 <= n; i += 8)
+         detail::orientation_batch_8(a + i, b + i, c + i, out + i);
+#elif defined(__AVX2__)
+      for (; i + 4 <= n; i += 4)
+         detail::orientation_batch_4(a + i, b + i, c + i, out + i);
+#elif defined(__SSE2__)
+      for (; i + 2 <= n; i += 2)
+         detail::orientation_batch_2(a + i, b + i, c + i, out + i);
+#endif
+
+      for (; i != n; ++i)
+         out[i] = orientation(a[i], b[i], c[i]);
+   }
+
+   inline void orientation_batch(std::vector<point_2> const & a, std::vector<point_2> const & b, std::vector<point_2> const & c,
+                                 orientation_t * out)
+   {
+      assert(a.size() == b.size() && b.size() == c.size());
+
+      if (!a.empty())
+         orientation_batch(&a[0], &b[0], &c[0], a.size(), out);
+   }
+}
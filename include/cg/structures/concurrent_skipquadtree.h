@@ -0,0 +1,577 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
+
+#include "cg/structures/skipquadtree.h"
+
+// Most threads that may have their own slots for reading concurrent trees at the same time,
+// more threads may read, they share one counter (see EpochDomain).
+const size_t EPOCH_MAX_THREADS = 256;
+
+// Index of the calling thread among the threads reading concurrent trees, EPOCH_MAX_THREADS if every
+// index is taken. The first call of a thread claims a free index, looking at each index at most once,
+// without locks; the index is given back when the thread finishes.
+size_t epochThreadIndex();
+
+// indices claimed so far are below it
+size_t epochThreadsBound();
+
+// Epoch based reclamation. Readers announce the epoch they started in, a writer
+// advances the epoch only when every active reader has announced the current one.
+// A node unlinked in epoch e can not be reached by any reader once the epoch is e + 2.
+// The threads without an index announce only that they are reading, the epoch does not advance
+// while any of them reads, so the nodes are reused later but never too early.
+struct EpochDomain {
+    EpochDomain();
+
+    // Wait-free, the calls of one thread may be nested. The first call of a thread
+    // also claims its index in at most EPOCH_MAX_THREADS steps.
+    void enter();
+
+    void exit();
+
+    uint64_t current() const;
+
+    // called by the writers only, looks at the slots of the indices claimed so far
+    bool tryAdvance();
+
+private:
+    struct ThreadSlot {
+        // 0 if the thread is not reading
+        std::atomic<uint64_t> epoch;
+        unsigned nesting;
+        // one slot per cache line, readers of different threads do not share lines
+        char padding[64 - sizeof(std::atomic<uint64_t>) - sizeof(unsigned)];
+    };
+
+    std::atomic<uint64_t> epoch;
+    // threads without an index that are reading
+    std::atomic<size_t> overflowReaders;
+    std::unique_ptr<ThreadSlot[]> slots;
+};
+
+struct EpochGuard {
+    explicit EpochGuard(EpochDomain &domain) : domain(domain) {
+        domain.enter();
+    }
+
+    ~EpochGuard() {
+        domain.exit();
+    }
+
+    EpochGuard(EpochGuard const &) = delete;
+
+    EpochGuard &operator=(EpochGuard const &) = delete;
+
+private:
+    EpochDomain &domain;
+};
+
+// Node pool readers may use while the writer adds nodes: segment k holds FIRST_SEGMENT_SIZE << k nodes,
+// segments are never moved, so finding a node takes no lock. Only the writer creates and releases nodes.
+template<class T>
+struct ConcurrentNodePool {
+    static const uint32_t FIRST_SEGMENT_BITS = 12;
+    static const uint32_t FIRST_SEGMENT_SIZE = 1 << FIRST_SEGMENT_BITS;
+    // enough for 2^31 nodes
+    static const int SEGMENTS = 20;
+
+    ConcurrentNodePool();
+
+    ~ConcurrentNodePool();
+
+    ConcurrentNodePool(ConcurrentNodePool const &) = delete;
+
+    ConcurrentNodePool &operator=(ConcurrentNodePool const &) = delete;
+
+    template<class Arg>
+    uint32_t create(Arg const &arg);
+
+    void release(uint32_t index);
+
+    T &operator[](uint32_t index);
+
+    T const &operator[](uint32_t index) const;
+
+    size_t size() const;
+
+    size_t bytesUsed() const;
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type Slot;
+
+    static_assert(std::is_trivially_destructible<T>::value, "nodes are dropped without destruction");
+
+    static int segmentOf(uint32_t index);
+
+    static uint32_t segmentBegin(int segment);
+
+    std::atomic<Slot *> segments[SEGMENTS];
+    std::vector<uint32_t> freeSlots;
+    uint32_t used;
+};
+
+// MiddleNode with links readers may load while the writer changes them.
+struct ConcurrentMiddleNode {
+    Cell cell;
+    std::atomic<NodeRef> children[4];
+    std::atomic<NodeRef> linkToMoreDetailed;
+
+    ConcurrentMiddleNode(Cell cell) : cell(cell) {
+        for (int i = 0; i < 4; i++) {
+            children[i].store(NULL_NODE, std::memory_order_relaxed);
+        }
+        linkToMoreDetailed.store(NULL_NODE, std::memory_order_relaxed);
+    }
+};
+
+// SkipQuadTree for concurrent use: queries take no locks and never wait, addPoint and deletePoint
+// are serialized by a mutex. A writer links a node only when it is complete, with a single store,
+// the nodes it unlinks are reused only when no reader can still reach them (see EpochDomain).
+// A query reports every point added before it started and not deleted until it finished,
+// points added or deleted meanwhile may be reported or not.
+// The tree must not be destroyed while it is used.
+struct ConcurrentSkipQuadTree {
+    typedef point_2f Point;
+
+    ConcurrentSkipQuadTree();
+
+    std::list<std::pair<int, point_2f>> getContainWithId(point_2f p1, point_2f p2, float eps) const;
+
+    std::list<std::pair<int, point_2f>> getContainWithId(Range range, float eps) const;
+
+    std::list<point_2f> getContain(point_2f p1, point_2f p2, float eps) const;
+
+    std::list<point_2f> getContain(Range range, float eps) const;
+
+    template<class Visitor>
+    void forEachInRange(Range range, float eps, Visitor visitor) const;
+
+    template<class OutputIt>
+    OutputIt queryInto(Range range, float eps, OutputIt out) const;
+
+    size_t countInRange(Range range, float eps) const;
+
+    bool addPoint(point_2f point);
+
+    bool deletePoint(point_2f point, float eps);
+
+    int skipLevels() const;
+
+    // nodes in the tree and unlinked nodes not reused yet
+    size_t nodesCount() const;
+
+    size_t bytesUsed() const;
+
+private:
+    mutable EpochDomain epochs;
+    mutable std::mutex writeMutex;
+    std::atomic<NodeRef> lowDetailedRoot;
+    std::atomic<int> levels;
+    ConcurrentNodePool<ConcurrentMiddleNode> middleNodes;
+    ConcurrentNodePool<TermNode> termNodes;
+    // unlinked nodes with the epochs they were unlinked in, oldest first
+    std::vector<std::pair<uint64_t, NodeRef>> retiredNodes;
+
+    typedef SkipLevels<ConcurrentSkipQuadTree> Levels;
+
+    template<class Nodes>
+    friend struct SkipLevels;
+
+    ConcurrentMiddleNode &middle(NodeRef node);
+
+    ConcurrentMiddleNode const &middle(NodeRef node) const;
+
+    TermNode const &term(NodeRef node) const;
+
+    // the links are loaded with acquire and stored with release, so the nodes are complete when reached
+    static NodeRef childOf(ConcurrentMiddleNode const &node, int i);
+
+    static NodeRef moreDetailedOf(ConcurrentMiddleNode const &node);
+
+    int nodeId(NodeRef node) const;
+
+    NodeRef root() const;
+
+    void setRoot(NodeRef root);
+
+    void addLevels(int count);
+
+    void setChild(NodeRef node, int i, NodeRef child);
+
+    void setMoreDetailed(NodeRef node, NodeRef link);
+
+    NodeRef newMiddleNode(Cell cell);
+
+    NodeRef newTermNode(point_2f point);
+
+    // the node is reused when no reader can reach it
+    void releaseNode(NodeRef node);
+
+    void reclaimRetiredNodes();
+};
+
+//_______________________________________________________IMPLEMENTATION_________________________________________________
+
+// EpochDomain implementation BEGIN
+// zero-initialized before any thread starts, so it is reached without a guard
+struct EpochThreadRegistry {
+    std::atomic<bool> claimed[EPOCH_MAX_THREADS];
+    std::atomic<size_t> bound;
+};
+
+inline EpochThreadRegistry &epochThreadRegistry() {
+    static EpochThreadRegistry registry;
+    return registry;
+}
+
+struct EpochThreadIndex {
+    size_t index;
+
+    EpochThreadIndex() : index(EPOCH_MAX_THREADS) {
+        EpochThreadRegistry &registry = epochThreadRegistry();
+        for (size_t i = 0; i < EPOCH_MAX_THREADS && index == EPOCH_MAX_THREADS; i++) {
+            bool expected = false;
+            if (!registry.claimed[i].load(std::memory_order_relaxed)
+                    && registry.claimed[i].compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                index = i;
+            }
+        }
+        if (index == EPOCH_MAX_THREADS) {
+            return;
+        }
+        // the bound only grows, each failure means another thread raised it
+        size_t bound = registry.bound.load(std::memory_order_relaxed);
+        while (bound <= index
+                && !registry.bound.compare_exchange_strong(bound, index + 1, std::memory_order_relaxed)) {
+        }
+    }
+
+    ~EpochThreadIndex() {
+        if (index != EPOCH_MAX_THREADS) {
+            epochThreadRegistry().claimed[index].store(false, std::memory_order_release);
+        }
+    }
+};
+
+inline size_t epochThreadIndex() {
+    static thread_local EpochThreadIndex threadIndex;
+    return threadIndex.index;
+}
+
+inline size_t epochThreadsBound() {
+    return epochThreadRegistry().bound.load(std::memory_order_relaxed);
+}
+
+inline EpochDomain::EpochDomain() : slots(new ThreadSlot[EPOCH_MAX_THREADS]) {
+    epoch.store(1);
+    overflowReaders.store(0);
+    for (size_t i = 0; i < EPOCH_MAX_THREADS; i++) {
+        slots[i].epoch.store(0);
+        slots[i].nesting = 0;
+    }
+}
+
+inline void EpochDomain::enter() {
+    size_t index = epochThreadIndex();
+    if (index == EPOCH_MAX_THREADS) {
+        overflowReaders.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        return;
+    }
+    ThreadSlot &slot = slots[index];
+    if (slot.nesting++ == 0) {
+        slot.epoch.store(epoch.load(std::memory_order_acquire), std::memory_order_relaxed);
+        // pairs with the fence in tryAdvance: either the writer sees this reader,
+        // or the reader sees every node the writer has unlinked so far
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+}
+
+inline void EpochDomain::exit() {
+    size_t index = epochThreadIndex();
+    if (index == EPOCH_MAX_THREADS) {
+        overflowReaders.fetch_sub(1, std::memory_order_release);
+        return;
+    }
+    ThreadSlot &slot = slots[index];
+    assert (slot.nesting > 0);
+    if (--slot.nesting == 0) {
+        slot.epoch.store(0, std::memory_order_release);
+    }
+}
+
+inline uint64_t EpochDomain::current() const {
+    return epoch.load(std::memory_order_acquire);
+}
+
+inline bool EpochDomain::tryAdvance() {
+    // a reader whose announcement is missed here has claimed its index after the fence too
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    uint64_t cur = epoch.load(std::memory_order_relaxed);
+    if (overflowReaders.load(std::memory_order_acquire) != 0) {
+        return false;
+    }
+    size_t bound = epochThreadsBound();
+    for (size_t i = 0; i < bound; i++) {
+        uint64_t seen = slots[i].epoch.load(std::memory_order_acquire);
+        if (seen != 0 && seen != cur) {
+            return false;
+        }
+    }
+    epoch.store(cur + 1, std::memory_order_release);
+    return true;
+}
+// EpochDomain implementation END
+
+// ConcurrentNodePool implementation BEGIN
+template<class T>
+ConcurrentNodePool<T>::ConcurrentNodePool() : used(0) {
+    for (int i = 0; i < SEGMENTS; i++) {
+        segments[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+ConcurrentNodePool<T>::~ConcurrentNodePool() {
+    for (int i = 0; i < SEGMENTS; i++) {
+        delete[] segments[i].load(std::memory_order_relaxed);
+    }
+}
+
+template<class T>
+int ConcurrentNodePool<T>::segmentOf(uint32_t index) {
+    return 31 - __builtin_clz((index >> FIRST_SEGMENT_BITS) + 1);
+}
+
+template<class T>
+uint32_t ConcurrentNodePool<T>::segmentBegin(int segment) {
+    return ((1u << segment) - 1) << FIRST_SEGMENT_BITS;
+}
+
+template<class T>
+template<class Arg>
+uint32_t ConcurrentNodePool<T>::create(Arg const &arg) {
+    uint32_t index;
+    if (!freeSlots.empty()) {
+        index = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        index = used++;
+        int segment = segmentOf(index);
+        assert (segment < SEGMENTS);
+        if (index == segmentBegin(segment)) {
+            segments[segment].store(new Slot[FIRST_SEGMENT_SIZE << segment], std::memory_order_release);
+        }
+    }
+    new(&(*this)[index]) T(arg);
+    return index;
+}
+
+template<class T>
+void ConcurrentNodePool<T>::release(uint32_t index) {
+    freeSlots.push_back(index);
+}
+
+template<class T>
+T &ConcurrentNodePool<T>::operator[](uint32_t index) {
+    int segment = segmentOf(index);
+    Slot *slots = segments[segment].load(std::memory_order_acquire);
+    return reinterpret_cast<T &>(slots[index - segmentBegin(segment)]);
+}
+
+template<class T>
+T const &ConcurrentNodePool<T>::operator[](uint32_t index) const {
+    int segment = segmentOf(index);
+    Slot const *slots = segments[segment].load(std::memory_order_acquire);
+    return reinterpret_cast<T const &>(slots[index - segmentBegin(segment)]);
+}
+
+template<class T>
+size_t ConcurrentNodePool<T>::size() const {
+    return used - freeSlots.size();
+}
+
+template<class T>
+size_t ConcurrentNodePool<T>::bytesUsed() const {
+    size_t res = sizeof(segments) + freeSlots.capacity() * sizeof(uint32_t);
+    for (int i = 0; i < SEGMENTS && used > segmentBegin(i); i++) {
+        res += (FIRST_SEGMENT_SIZE << i) * sizeof(Slot);
+    }
+    return res;
+}
+// ConcurrentNodePool implementation END
+
+// Node access implementation BEGIN
+inline ConcurrentMiddleNode &ConcurrentSkipQuadTree::middle(NodeRef node) {
+    assert (!isTermNode(node));
+    return middleNodes[node];
+}
+
+inline ConcurrentMiddleNode const &ConcurrentSkipQuadTree::middle(NodeRef node) const {
+    assert (!isTermNode(node));
+    return middleNodes[node];
+}
+
+inline TermNode const &ConcurrentSkipQuadTree::term(NodeRef node) const {
+    assert (isTermNode(node) && node != NULL_NODE);
+    return termNodes[node & ~TERM_NODE_BIT];
+}
+
+inline NodeRef ConcurrentSkipQuadTree::childOf(ConcurrentMiddleNode const &node, int i) {
+    return node.children[i].load(std::memory_order_acquire);
+}
+
+inline NodeRef ConcurrentSkipQuadTree::moreDetailedOf(ConcurrentMiddleNode const &node) {
+    return node.linkToMoreDetailed.load(std::memory_order_acquire);
+}
+
+inline int ConcurrentSkipQuadTree::nodeId(NodeRef node) const {
+    return node & ~TERM_NODE_BIT;
+}
+
+inline NodeRef ConcurrentSkipQuadTree::root() const {
+    return lowDetailedRoot.load(std::memory_order_acquire);
+}
+
+inline void ConcurrentSkipQuadTree::setRoot(NodeRef root) {
+    lowDetailedRoot.store(root, std::memory_order_release);
+}
+
+inline void ConcurrentSkipQuadTree::addLevels(int count) {
+    levels += count;
+}
+
+inline void ConcurrentSkipQuadTree::setChild(NodeRef node, int i, NodeRef child) {
+    middle(node).children[i].store(child, std::memory_order_release);
+}
+
+inline void ConcurrentSkipQuadTree::setMoreDetailed(NodeRef node, NodeRef link) {
+    middle(node).linkToMoreDetailed.store(link, std::memory_order_release);
+}
+
+inline NodeRef ConcurrentSkipQuadTree::newMiddleNode(Cell cell) {
+    return middleNodes.create(cell);
+}
+
+inline NodeRef ConcurrentSkipQuadTree::newTermNode(point_2f point) {
+    return termNodes.create(point) | TERM_NODE_BIT;
+}
+
+inline void ConcurrentSkipQuadTree::releaseNode(NodeRef node) {
+    retiredNodes.push_back(std::make_pair(epochs.current(), node));
+}
+
+inline void ConcurrentSkipQuadTree::reclaimRetiredNodes() {
+    if (retiredNodes.empty()) {
+        return;
+    }
+    epochs.tryAdvance();
+    uint64_t epoch = epochs.current();
+    size_t reclaimed = 0;
+    while (reclaimed != retiredNodes.size() && retiredNodes[reclaimed].first + 2 <= epoch) {
+        NodeRef node = retiredNodes[reclaimed].second;
+        if (isTermNode(node)) {
+            termNodes.release(node & ~TERM_NODE_BIT);
+        } else {
+            middleNodes.release(node);
+        }
+        reclaimed++;
+    }
+    retiredNodes.erase(retiredNodes.begin(), retiredNodes.begin() + reclaimed);
+}
+// Node access implementation END
+
+// ConcurrentSkipQuadTree implementation BEGIN
+inline ConcurrentSkipQuadTree::ConcurrentSkipQuadTree() {
+    lowDetailedRoot.store(NULL_NODE);
+    levels.store(1);
+}
+
+inline std::list<std::pair<int, point_2f>> ConcurrentSkipQuadTree::getContainWithId(point_2f p1, point_2f p2, float eps) const {
+    Range rect(-239,
+            std::min(p1.x, p2.x), std::max(p1.x, p2.x),
+            std::min(p1.y, p2.y), std::max(p1.y, p2.y));
+    return getContainWithId(rect, eps);
+}
+
+inline std::list<std::pair<int, point_2f>> ConcurrentSkipQuadTree::getContainWithId(Range range, float eps) const {
+    std::list<std::pair<int, point_2f>> res;
+    forEachInRange(range, eps, [&res](int id, point_2f point) {
+        res.push_back(std::make_pair(id, point));
+    });
+    return res;
+}
+
+inline std::list<point_2f> ConcurrentSkipQuadTree::getContain(point_2f p1, point_2f p2, float eps) const {
+    Range rect(-239,
+            std::min(p1.x, p2.x), std::max(p1.x, p2.x),
+            std::min(p1.y, p2.y), std::max(p1.y, p2.y));
+    return getContain(rect, eps);
+}
+
+inline std::list<point_2f> ConcurrentSkipQuadTree::getContain(Range range, float eps) const {
+    std::list<point_2f> res;
+    queryInto(range, eps, std::back_inserter(res));
+    return res;
+}
+
+template<class Visitor>
+void ConcurrentSkipQuadTree::forEachInRange(Range range, float eps, Visitor visitor) const {
+    EpochGuard guard(epochs);
+    NodeRef root = lowDetailedRoot.load(std::memory_order_acquire);
+    if (root != NULL_NODE) {
+        Levels::visitInRange(*this, root, RangeQuery<float>(range, eps), visitor);
+    }
+}
+
+template<class OutputIt>
+OutputIt ConcurrentSkipQuadTree::queryInto(Range range, float eps, OutputIt out) const {
+    forEachInRange(range, eps, [&out](int, point_2f point) {
+        *out++ = point;
+    });
+    return out;
+}
+
+inline size_t ConcurrentSkipQuadTree::countInRange(Range range, float eps) const {
+    size_t count = 0;
+    forEachInRange(range, eps, [&count](int, point_2f) {
+        count++;
+    });
+    return count;
+}
+
+inline bool ConcurrentSkipQuadTree::addPoint(point_2f p) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return Levels::addPoint(*this, p);
+}
+
+inline bool ConcurrentSkipQuadTree::deletePoint(point_2f point, float eps) {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    bool wasDeleted = Levels::deletePoint(*this, point, eps);
+    reclaimRetiredNodes();
+    return wasDeleted;
+}
+
+inline int ConcurrentSkipQuadTree::skipLevels() const {
+    return levels.load();
+}
+
+inline size_t ConcurrentSkipQuadTree::nodesCount() const {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return middleNodes.size() + termNodes.size();
+}
+
+inline size_t ConcurrentSkipQuadTree::bytesUsed() const {
+    std::lock_guard<std::mutex> lock(writeMutex);
+    return sizeof(ConcurrentSkipQuadTree) + middleNodes.bytesUsed() + termNodes.bytesUsed()
+            + retiredNodes.capacity() * sizeof(std::pair<uint64_t, NodeRef>);
+}
+// ConcurrentSkipQuadTree implementation END
@@ -0,0 +1,187 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <cg/primitives/point.h>
+
+namespace cg
+{
+   // Half-edge mesh on indices, each field in an array of its own so that a traversal reads only the links
+   // it follows. Half-edge h goes from vertex origin[h] along the face face[h] lying to its left,
+   // next[h] and prev[h] go around that face and twin[h] is the opposite half-edge (none on a border).
+   // Vertex v is at points[v], vertex_edge[v] is a half-edge going out of it; face_edge[f] is a half-edge of face f.
+   template <class Scalar>
+   struct half_edge_mesh_t
+   {
+      typedef uint32_t index_t;
+      static const index_t none = index_t(-1);
+
+      std::vector<point_2t<Scalar> > points;
+      std::vector<index_t> vertex_edge;
+
+      std::vector<index_t> origin;
+      std::vector<index_t> next;
+      std::vector<index_t> prev;
+      std::vector<index_t> twin;
+      std::vector<index_t> face;
+
+      std::vector<index_t> face_edge;
+
+      size_t vertices_num() const
+      {
+         return points.size();
+      }
+
+      size_t half_edges_num() const
+      {
+         return origin.size();
+      }
+
+      size_t faces_num() const
+      {
+         return face_edge.size();
+      }
+
+      index_t target(index_t h) const
+      {
+         return origin[next[h]];
+      }
+
+      void clear()
+      {
+         points.clear();
+         vertex_edge.clear();
+         origin.clear();
+         next.clear();
+         prev.clear();
+         twin.clear();
+         face.clear();
+         face_edge.clear();
+      }
+
+      void reserve(size_t vertices, size_t half_edges, size_t faces)
+      {
+         points.reserve(vertices);
+         vertex_edge.reserve(vertices);
+         origin.reserve(half_edges);
+         next.reserve(half_edges);
+         prev.reserve(half_edges);
+         twin.reserve(half_edges);
+         face.reserve(half_edges);
+         face_edge.reserve(faces);
+      }
+
+      index_t add_vertex(point_2t<Scalar> const & p)
+      {
+         points.push_back(p);
+         vertex_edge.push_back(none);
+         return index_t(points.size() - 1);
+      }
+
+      // appends half-edges with given links, their faces are set later (see set_faces)
+      index_t add_half_edge(index_t from, index_t next_h, index_t prev_h, index_t twin_h)
+      {
+         index_t h = index_t(origin.size());
+         origin.push_back(from);
+         next.push_back(next_h);
+         prev.push_back(prev_h);
+         twin.push_back(twin_h);
+         face.push_back(none);
+         if (from != none && vertex_edge[from] == none)
+            vertex_edge[from] = h;
+         return h;
+      }
+
+      // face on the vertices of [begin, end) in counterclockwise order, its half-edges have no twins yet
+      template <class VertexIt>
+      index_t add_face(VertexIt begin, VertexIt end)
+      {
+         index_t f = index_t(face_edge.size());
+         index_t first = index_t(origin.size());
+         index_t size = index_t(end - begin);
+         for (index_t i = 0; i != size; ++i, ++begin)
+         {
+            add_half_edge(*begin, first + (i + 1) % size, first + (i + size - 1) % size, none);
+            face.back() = f;
+         }
+         face_edge.push_back(first);
+         return f;
+      }
+
+      index_t add_triangle(index_t a, index_t b, index_t c)
+      {
+         index_t vertices[3] = {a, b, c};
+         return add_face(vertices, vertices + 3);
+      }
+
+      // pairs the half-edges without twins going between the same vertices in opposite directions
+      void link_twins()
+      {
+         std::vector<std::pair<uint64_t, index_t> > keys;
+         for (index_t h = 0; h != origin.size(); ++h)
+         {
+            if (twin[h] != none)
+               continue;
+            uint64_t a = origin[h], b = target(h);
+            keys.push_back(std::make_pair(std::min(a, b) << 32 | std::max(a, b), h));
+         }
+         std::sort(keys.begin(), keys.end());
+         for (size_t i = 0; i + 1 < keys.size(); ++i)
+         {
+            index_t h = keys[i].second, g = keys[i + 1].second;
+            if (keys[i].first == keys[i + 1].first && origin[h] == target(g))
+            {
+               twin[h] = g;
+               twin[g] = h;
+               ++i;
+            }
+         }
+      }
+
+      // numbers the cycles of next as faces
+      void set_faces()
+      {
+         face_edge.clear();
+         std::fill(face.begin(), face.end(), none);
+         for (index_t start = 0; start != origin.size(); ++start)
+         {
+            if (face[start] != none)
+               continue;
+            index_t f = index_t(face_edge.size());
+            face_edge.push_back(start);
+            index_t h = start;
+            do
+            {
+               face[h] = f;
+               h = next[h];
+            } while (h != start);
+         }
+      }
+
+      template <class Visitor>
+      void for_each_face_edge(index_t f, Visitor visitor) const
+      {
+         index_t start = face_edge[f], h = start;
+         do
+         {
+            visitor(h);
+            h = next[h];
+         } while (h != start);
+      }
+
+      size_t memory_usage() const
+      {
+         return points.capacity() * sizeof(point_2t<Scalar>)
+            + (vertex_edge.capacity() + origin.capacity() + next.capacity() + prev.capacity()
+               + twin.capacity() + face.capacity() + face_edge.capacity()) * sizeof(index_t);
+      }
+   };
+
+   template <class Scalar>
+   const typename half_edge_mesh_t<Scalar>::index_t half_edge_mesh_t<Scalar>::none;
+
+   typedef half_edge_mesh_t<double> half_edge_mesh;
+   typedef half_edge_mesh_t<float> half_edge_mesh_f;
+}
@@ -2,11 +2,20 @@
 
 //#include <memory>
 #include <vector>
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <limits>
+#include <future>
 #include <math.h>
 #include <stdio.h>
 
+#include <boost/optional.hpp>
+#include <gmpxx.h>
+
 #include "cg/primitives/point.h"
 #include "cg/operations/orientation.h"
+#include "cg/structures/half_edge_mesh.h"
 
 using std::vector;
 using std::nan;
@@ -62,6 +71,48 @@ struct Line {
     }
 };
 
+// Sign of the line at the crossing of first and second, positive to the right of the line (where a * x + b * y + c > 0).
+// It is det(first, second, line) / det(first, second) of the coefficients, the products of two floats are exact in double.
+struct LineSideD {
+    boost::optional<int> operator()(Line const &first, Line const &second, Line const &line) const {
+        double ab = double(first.a) * second.b;
+        double ba = double(first.b) * second.a;
+        double bc = double(first.b) * second.c;
+        double cb = double(first.c) * second.b;
+        double ca = double(first.c) * second.a;
+        double ac = double(first.a) * second.c;
+        double denominator = ab - ba;
+        double res = line.a * (bc - cb) + line.b * (ca - ac) + line.c * denominator;
+        double eps = (fabs(line.a) * (fabs(bc) + fabs(cb)) + fabs(line.b) * (fabs(ca) + fabs(ac))
+                + fabs(line.c) * (fabs(ab) + fabs(ba))) * 8 * std::numeric_limits<double>::epsilon();
+
+        if (res > eps) {
+            return denominator > 0 ? 1 : -1;
+        }
+        if (res < -eps) {
+            return denominator > 0 ? -1 : 1;
+        }
+        return boost::none;
+    }
+};
+
+struct LineSideR {
+    boost::optional<int> operator()(Line const &first, Line const &second, Line const &line) const {
+        mpq_class denominator = mpq_class(first.a) * second.b - mpq_class(first.b) * second.a;
+        mpq_class res = line.a * (mpq_class(first.b) * second.c - mpq_class(first.c) * second.b)
+                + line.b * (mpq_class(first.c) * second.a - mpq_class(first.a) * second.c)
+                + line.c * denominator;
+        return sgn(res) * sgn(denominator);
+    }
+};
+
+inline int lineSide(Line const &first, Line const &second, Line const &line) {
+    if (boost::optional<int> v = LineSideD()(first, second, line)) {
+        return *v;
+    }
+    return *LineSideR()(first, second, line);
+}
+
 struct DCEL {
     const int infinityVid = 0;
     vector<Vertex> vertexes;
@@ -70,6 +121,8 @@ struct DCEL {
     int nextEdgeId = 0;
     int nextLineId = 0;
     int nextVertexId = 1;
+    // edges leaving the infinite vertex, in the order of their ends at infinity, see isFartherBefore
+    vector<int> infinityRing;
 
     DCEL(Line line) {
         Line twinLine(-line.a, -line.b, -line.c);
@@ -92,210 +145,302 @@ struct DCEL {
 
         lines.push_back(line);
         lines.push_back(twinLine);
-    }
 
-    bool isLineBetween(Line line, Line toRight, Line toLeft) {
-        point_2f zero(0, 0);
-        point_2f lineN(line.a, line.b);
-        point_2f a(toRight.a, toRight.b);
-        point_2f b(toLeft.a, toLeft.b);
-        return orientation_r()(zero, a, lineN) == orientation_t::CG_LEFT
-                && orientation_r()(zero, b, lineN) == orientation_t::CG_RIGHT;
+        infinityRing.push_back(e1Id);
+        insertIntoRing(e2Id);
     }
 
-    bool isIntersect(Edge edge, Line line) {//TODO
-        if (edge.fromVid == infinityVid) {
-            if (edges[edge.nextEid].fromVid == infinityVid) {
-                return true;
-            }
-            point_2f b = vertexes[edges[edge.nextEid].fromVid].point;
-            float signB = line.a * b.x + line.b * b.y + line.c;
-            return signB < 0;
-        }
-        if (edges[edge.nextEid].fromVid == infinityVid) {
-            point_2f a = vertexes[edge.fromVid].point;
-            float signA = line.a * a.x + line.b * a.y + line.c;
-            return signA > 0;
+    // Zone walk: the line enters at the infinite vertex where the ring puts it and goes face by face,
+    // each face is split at the point where the line leaves it, a crossed edge or a vertex on the line.
+    // Lines through existing vertexes and parallel lines are supported, a line already in the arrangement is not.
+    int addLine(Line line) {
+        vector<int>::iterator at = std::lower_bound(infinityRing.begin(), infinityRing.end(), line,
+                [this](int eid, Line const &toFind) {
+            return isFartherBefore(lines[edges[eid].lineId], toFind);
+        });
+        if (at != infinityRing.end() && !isFartherBefore(line, lines[edges[*at].lineId])) {
+            throw std::invalid_argument("the line is already in the arrangement");
         }
 
-        point_2f a = vertexes[edge.fromVid].point;
-        point_2f b = vertexes[edges[edge.nextEid].fromVid].point;
-        float signA = line.a * a.x + line.b * a.y + line.c;
-        float signB = line.a * b.x + line.b * b.y + line.c;
-        return signA * signB < 0;
-    }
-
-    point_2f intersect(Edge edge, Line line) {//TODO
-        Line l1 = lines[edge.lineId];
-        Line l2 = line;
-        return point_2f((l1.b * l2.c - l1.c * l2.b) / (l1.a * l2.b - l1.b * l2.a),
-                (l1.a * l2.c - l1.c * l2.a) / (l1.b * l2.a - l1.a * l2.b));
-    }
-
-    bool fromRight(Line line, Line line2) {
-        float a1 = line.a;
-        float b1 = line.b;
-        float a2 = line2.a;
-        float b2 = line2.b;
-        return a1 * b2 < b1 * a2;
-    }
-
-    int addLine(Line line) {
         Line twinLine(-line.a, -line.b, -line.c);
         line.id = getNextLineId();
         twinLine.id = getNextLineId();
         line.twinLid = twinLine.id;
         twinLine.twinLid = line.id;
-
         lines.push_back(line);
         lines.push_back(twinLine);
 
-        Edge edgeLine1 = edges[vertexes[infinityVid].outEid];
+        int before = at == infinityRing.begin() ? infinityRing.back() : *(at - 1);
+        int inEid = edges[before].twinEid;
+        int firstEid = -1;
         while (true) {
-            Edge edgeLine2 = edges[edges[edgeLine1.twinEid].nextEid];
-            if (isLineBetween(line, lines[edgeLine1.lineId], lines[edgeLine2.lineId])) {
+            // the face is to the left of inEid, which ends where the line enters the face
+            int cur = edges[inEid].nextEid;
+            int fromSide = edges[cur].fromVid == infinityVid ? -infinitySide(cur, line) : 0;
+            int exitVid = -1;
+            bool split = false;
+            while (true) {
+                int toVid = edges[edges[cur].nextEid].fromVid;
+                int toSide = toVid == infinityVid ? infinitySide(cur, line) : vertexSide(toVid, line);
+                if (fromSide * toSide < 0) {
+                    exitVid = splitEdge(cur, line);
+                    split = true;
+                    if (cur == inEid) {
+                        // a whole line around the face, the line entered at its end
+                        inEid = edges[cur].nextEid;
+                    }
+                    break;
+                }
+                if (toVid == infinityVid) {
+                    // the arc at infinity up to the next edge
+                    int nextSide = -infinitySide(edges[cur].nextEid, line);
+                    if (toSide * nextSide <= 0) {
+                        break;
+                    }
+                    toSide = nextSide;
+                } else if (toSide == 0) {
+                    exitVid = toVid;
+                    break;
+                }
+                fromSide = toSide;
+                cur = edges[cur].nextEid;
+            }
+
+            int eid = connect(inEid, cur, line.id, twinLine.id);
+            if (firstEid == -1) {
+                firstEid = eid;
+            }
+            if (exitVid == -1) {
+                insertIntoRing(firstEid);
+                insertIntoRing(edges[eid].twinEid);
                 break;
             }
-            edgeLine1 = edgeLine2;
+            inEid = split ? edges[edges[eid].nextEid].twinEid : edgeInto(exitVid, line);
         }
-        int e1 = getNextEdgeId();
-        int e2 = getNextEdgeId();
+        vertexes[infinityVid].outEid = infinityRing[0];
+        return line.id;
+    }
+
+    // sign of the line at the vertex, positive to the right of the line
+    int vertexSide(int vid, Line const &line) const {
+        Vertex const &vertex = vertexes[vid];
+        return lineSide(lines[vertex.lineId1], lines[vertex.lineId2], line);
+    }
 
-        Edge curEdge = edges[edges[edgeLine1.twinEid].nextEid];
+    // sign of the line at the end at infinity of an edge going to the infinite vertex
+    int infinitySide(int eid, Line const &line) const {
+        Line const &edgeLine = lines[edges[eid].lineId];
+        double side = double(line.b) * edgeLine.a - double(line.a) * edgeLine.b;
+        return side > 0 ? 1 : side < 0 ? -1 : 0;
+    }
 
-        Edge curLineEdge(e1, infinityVid, -1, edgeLine1.twinEid, e2, line.id);
-        Edge curLineEdgeTwin(e2, -1, edges[edgeLine1.twinEid].nextEid, -1, e1, twinLine.id);
-        edges.push_back(curLineEdge);
-        edges.push_back(curLineEdgeTwin);
-        edges[edges[edgeLine1.twinEid].nextEid].prevEid = curLineEdgeTwin.id;
-        edges[edgeLine1.twinEid].nextEid = curLineEdge.id;
+    // the ends at infinity of the edges leaving the infinite vertex are at -(-b, a), counterclockwise,
+    // parallel edges are ordered along their normal (a, b)
+    static bool isFartherBefore(Line const &first, Line const &second) {
+        bool firstLower = -first.a < 0 || (first.a == 0 && first.b < 0);
+        bool secondLower = -second.a < 0 || (second.a == 0 && second.b < 0);
+        if (firstLower != secondLower) {
+            return secondLower;
+        }
+        double turn = double(first.a) * second.b - double(first.b) * second.a;
+        if (turn != 0) {
+            return turn > 0;
+        }
+        double offset = second.a != 0 ? (double(first.a) * second.c - double(first.c) * second.a) * second.a
+                : (double(first.b) * second.c - double(first.c) * second.b) * second.b;
+        return offset < 0;
+    }
+
+    void insertIntoRing(int eid) {
+        Line const &line = lines[edges[eid].lineId];
+        infinityRing.insert(std::lower_bound(infinityRing.begin(), infinityRing.end(), line,
+                [this](int ringEid, Line const &toFind) {
+            return isFartherBefore(lines[edges[ringEid].lineId], toFind);
+        }), eid);
+    }
+
+    // splits the edge and its twin at a new vertex on the line, the parts from the old origins keep their ids
+    int splitEdge(int eid, Line const &line) {
+        int twinEid = edges[eid].twinEid;
+        int lineId = edges[eid].lineId;
+        int vid = getNextVertexId();
+        int tailEid = getNextEdgeId();
+        int twinTailEid = getNextEdgeId();
+        vertexes.push_back(Vertex(vid, tailEid, crossing(lines[lineId], line), lineId, line.id));
+        edges.push_back(Edge(tailEid, vid, edges[eid].nextEid, eid, twinEid, lineId));
+        edges.push_back(Edge(twinTailEid, vid, edges[twinEid].nextEid, twinEid, eid, edges[twinEid].lineId));
+        edges[edges[eid].nextEid].prevEid = tailEid;
+        edges[edges[twinEid].nextEid].prevEid = twinTailEid;
+        edges[eid].nextEid = tailEid;
+        edges[twinEid].nextEid = twinTailEid;
+        edges[eid].twinEid = twinTailEid;
+        edges[twinEid].twinEid = tailEid;
+        return vid;
+    }
 
+    // new edge in the face of fromInEid and toInEid, from the end of the first to the end of the second
+    int connect(int fromInEid, int toInEid, int lineId, int twinLineId) {
+        int eid = getNextEdgeId();
+        int twinEid = getNextEdgeId();
+        if (fromInEid == toInEid) {
+            // a half-plane bounded by one edge and a line parallel to it, the part away from the edge is a face
+            // of one edge; it is the new edge if the line goes the same way as the old one
+            Line const &line = lines[lineId];
+            Line const &edgeLine = lines[edges[fromInEid].lineId];
+            bool sameWay = double(line.a) * edgeLine.a + double(line.b) * edgeLine.b > 0;
+            int aloneEid = sameWay ? eid : twinEid;
+            int joinedEid = sameWay ? twinEid : eid;
+            edges.push_back(Edge(eid, infinityVid, -1, -1, twinEid, lineId));
+            edges.push_back(Edge(twinEid, infinityVid, -1, -1, eid, twinLineId));
+            edges[aloneEid].nextEid = edges[aloneEid].prevEid = aloneEid;
+            edges[joinedEid].nextEid = edges[joinedEid].prevEid = fromInEid;
+            edges[fromInEid].nextEid = edges[fromInEid].prevEid = joinedEid;
+            return eid;
+        }
+        int fromOutEid = edges[fromInEid].nextEid;
+        int toOutEid = edges[toInEid].nextEid;
+        edges.push_back(Edge(eid, edges[fromOutEid].fromVid, toOutEid, fromInEid, twinEid, lineId));
+        edges.push_back(Edge(twinEid, edges[toOutEid].fromVid, fromOutEid, toInEid, eid, twinLineId));
+        edges[fromInEid].nextEid = eid;
+        edges[toOutEid].prevEid = eid;
+        edges[toInEid].nextEid = twinEid;
+        edges[fromOutEid].prevEid = twinEid;
+        return eid;
+    }
+
+    // the edge ending at the vertex of the face around it that the line goes into
+    int edgeInto(int vid, Line const &line) const {
+        cg::vector_2 direction(-line.b, line.a);
+        int outEid = vertexes[vid].outEid;
         while (true) {
-            if (isIntersect(curEdge, line)) {
-                point_2f p = intersect(curEdge, line);
-
-                curEdge = edges[curEdge.id];
-
-                Vertex vertex(getNextVertexId(), curLineEdgeTwin.id, p, curEdge.lineId, line.id);
-                vertexes.push_back(vertex);
-                edges[curLineEdgeTwin.id].fromVid = vertex.id;
-
-                Edge curTwin = edges[curEdge.twinEid];
-
-                int e1 = getNextEdgeId();
-                int e2 = getNextEdgeId();
-                Edge curEdge2 = Edge(e1, vertex.id, curEdge.nextEid, curLineEdge.id, curTwin.id, curEdge.lineId);
-                Edge curTwin2 = Edge(e2, vertex.id, curTwin.nextEid, -1, curEdge.id, curTwin.lineId);
-                edges[curEdge.nextEid].prevEid = curEdge2.id;
-                edges[curTwin.nextEid].prevEid = curTwin2.id;
-                edges[curEdge.id].twinEid = curTwin2.id;
-                edges[curTwin.id].twinEid = curEdge2.id;
-                edges[curLineEdge.id].nextEid = curEdge2.id;
-                edges[curLineEdgeTwin.id].prevEid = curEdge.id;
-                edges[curEdge.id].nextEid = curLineEdgeTwin.id;
-                edges[curLineEdgeTwin.id].fromVid = vertex.id;
-
-                e1 = getNextEdgeId();
-                e2 = getNextEdgeId();
-                curLineEdge = Edge(e1, vertex.id, -1, curTwin.id, e2, line.id);
-                curLineEdgeTwin = Edge(e2, -1, curTwin2.id, -1, e1, twinLine.id);
-                edges[curTwin.id].nextEid = curLineEdge.id;
-                curTwin2.prevEid = curLineEdgeTwin.id;
-
-                edges.push_back(curEdge2);
-                edges.push_back(curTwin2);
-                edges.push_back(curLineEdge);
-                edges.push_back(curLineEdgeTwin);
-
-                curEdge = curTwin2;
-            }
-            curEdge = edges[curEdge.nextEid];
-            if (curEdge.fromVid == infinityVid
-                    && fromRight(line, lines[curEdge.lineId])) {
-                edges[curEdge.id].prevEid = curLineEdge.id;
-                edges[curEdge.prevEid].nextEid = curLineEdgeTwin.id;
-                edges[curLineEdge.id].nextEid = curEdge.id;
-                edges[curLineEdgeTwin.id].fromVid = infinityVid;
-                edges[curLineEdgeTwin.id].prevEid = curEdge.prevEid;
-                break;
+            int nextOutEid = edges[edges[outEid].prevEid].twinEid;
+            cg::vector_2 from = edgeDirection(outEid);
+            cg::vector_2 to = edgeDirection(nextOutEid);
+            bool inside = (from ^ to) > 0 ? (from ^ direction) > 0 && (direction ^ to) > 0
+                    : (from ^ direction) > 0 || (direction ^ to) > 0;
+            if (inside) {
+                return edges[outEid].prevEid;
             }
+            outEid = nextOutEid;
         }
-        return line.id;
     }
 
-    void triangulate() {
-        int edgesWas = edges.size();
-        const int EDGE_NONE = 1;
-        const int EDGE_ADDED = 2;
-        const int EDGE_PROCESSED = 3;
-        int state[edgesWas];
-        for (int i = 0; i < edgesWas; i++) {
-            state[i] = EDGE_NONE;
-        }
-
-        int q[edgesWas];
-        q[0] = 22;
-        state[22] = EDGE_ADDED;
-        int next = 0;
-        int last = 0;
-        while (next <= last) {
-            {
-                int startID = q[next];
-                Edge e = edges[edges[startID].nextEid];
-                while(e.id != startID){
-                    state[e.id] = EDGE_PROCESSED;
-                    if(state[e.twinEid] == EDGE_NONE) {
-                        last++;
-                        q[last] = e.twinEid;
-                        state[e.twinEid] = EDGE_ADDED;
-                    }
-                    e = edges[e.nextEid];
-                }
-            }
+    cg::vector_2 edgeDirection(int eid) const {
+        Line const &line = lines[edges[eid].lineId];
+        return cg::vector_2(-line.b, line.a);
+    }
+
+    static point_2f crossing(Line const &first, Line const &second) {
+        return point_2f(crossingD(first, second));
+    }
 
-            Edge e = edges[q[next]];
-            next++;
-            if (state[e.id] == EDGE_PROCESSED) {
+    // the crossing before it is rounded to float
+    static cg::point_2 crossingD(Line const &first, Line const &second) {
+        double denominator = double(first.a) * second.b - double(first.b) * second.a;
+        return cg::point_2((double(first.b) * second.c - double(first.c) * second.b) / denominator,
+                (double(first.c) * second.a - double(first.a) * second.c) / denominator);
+    }
+
+    // Fans every bounded face out of the origin of its first edge, the diagonals have no line (lineId = -1).
+    // One pass with an edge-visited bitmap finds the faces and gives each of them the ids of its diagonals,
+    // then up to threads tasks fill disjoint faces at once.
+    void triangulate(size_t threads = 1) {
+        size_t edgesWas = edges.size();
+        vector<bool> visited(edgesWas, false);
+        vector<int> faceEids;
+        vector<int> diagonalEids;
+        size_t diagonalEid = edgesWas;
+        for (size_t start = 0; start < edgesWas; start++) {
+            if (visited[start]) {
                 continue;
             }
-            state[e.id] = EDGE_PROCESSED;
-
-            int prevEId = e.prevEid;
-            Edge prev = edges[e.nextEid];
-            Edge cur = edges[prev.nextEid];
-            while(cur.id != e.id && cur.id != prevEId) {
-                int e1 = getNextEdgeId();
-                int e2 = getNextEdgeId();
-                Edge a(e1, e.fromVid, cur.id, e.prevEid, e2, -1);
-                Edge twin(e2, cur.fromVid, e.id, prev.id, e1, -1);
-                edges[prev.id].nextEid = twin.id;
-                edges[cur.id].prevEid = a.id;
-                edges[e.id].prevEid = twin.id;
-                edges[prevEId].nextEid = a.id;
-                prev = cur;
-                cur = edges[cur.nextEid];
-                e = a;
-                edges.push_back(a);
-                edges.push_back(twin);
+            size_t size = 0;
+            bool bounded = true;
+            int eid = start;
+            do {
+                visited[eid] = true;
+                bounded = bounded && edges[eid].fromVid != infinityVid;
+                size++;
+                eid = edges[eid].nextEid;
+            } while (eid != (int) start);
+            if (bounded && size > 3) {
+                faceEids.push_back(start);
+                diagonalEids.push_back(diagonalEid);
+                diagonalEid += 2 * (size - 3);
             }
         }
+        edges.resize(diagonalEid, Edge(-1, -1, -1, -1, -1, -1));
+        nextEdgeId = diagonalEid;
+
+        threads = std::max<size_t>(threads, 1);
+        size_t chunk = std::max<size_t>((faceEids.size() + threads - 1) / threads, 1);
+        std::launch policy = threads > 1 ? std::launch::async : std::launch::deferred;
+        vector<std::future<void>> tasks;
+        for (size_t from = 0; from < faceEids.size(); from += chunk) {
+            size_t to = std::min(from + chunk, faceEids.size());
+            tasks.push_back(std::async(policy, [this, &faceEids, &diagonalEids, from, to]() {
+                for (size_t i = from; i < to; i++) {
+                    fanFace(faceEids[i], diagonalEids[i]);
+                }
+            }));
+        }
+        for (std::future<void> &task : tasks) {
+            task.get();
+        }
+    }
+
+    // cuts off the triangles at the second vertex of the face one by one, the diagonals take the ids from eid on
+    void fanFace(int startEid, int eid) {
+        int vid = edges[startEid].fromVid;
+        int lastEid = edges[startEid].prevEid;
+        int closingEid = startEid;
+        int prevEid = edges[startEid].nextEid;
+        int cur = edges[prevEid].nextEid;
+        while (cur != lastEid) {
+            int diagonalEid = eid++;
+            int twinEid = eid++;
+            edges[diagonalEid] = Edge(diagonalEid, vid, cur, lastEid, twinEid, -1);
+            edges[twinEid] = Edge(twinEid, edges[cur].fromVid, closingEid, prevEid, diagonalEid, -1);
+            edges[prevEid].nextEid = twinEid;
+            edges[closingEid].prevEid = twinEid;
+            edges[cur].prevEid = diagonalEid;
+            edges[lastEid].nextEid = diagonalEid;
+            closingEid = diagonalEid;
+            prevEid = cur;
+            cur = edges[cur].nextEid;
+        }
+    }
+
+    // the arrangement as an index mesh with the same ids of vertexes and edges, the infinite vertex is at NaN;
+    // the faces are numbered in the order of their least edge
+    void toMesh(cg::half_edge_mesh_f &mesh) const {
+        mesh.clear();
+        mesh.reserve(vertexes.size(), edges.size(), edges.size() / 2);
+        for (Vertex const &vertex : vertexes) {
+            mesh.add_vertex(vertex.point);
+            mesh.vertex_edge.back() = vertex.outEid;
+        }
+        for (Edge const &edge : edges) {
+            mesh.add_half_edge(edge.fromVid, edge.nextEid, edge.prevEid, edge.twinEid);
+        }
+        mesh.set_faces();
     }
 
     void print() {
         cout << "____Vertexes (count=" << vertexes.size() << ")" << endl;
         for (unsigned int i = 0; i < vertexes.size(); i++) {
-            Vertex v = vertexes[i];
+            Vertex const &v = vertexes[i];
             cout << " index=" << i << " id=" << v.id << " outputEdge=" << v.outEid << " point=(x=" << v.point.x << ", y=" << v.point.y << ")" << endl;
         }
         cout << "____Edges (count=" << edges.size() << ")" << endl;
         for (unsigned int i = 0; i < edges.size(); i++) {
-            Edge e = edges[i];
+            Edge const &e = edges[i];
             cout << " index=" << i << " id=" << e.id << " twinEdge=" << e.twinEid << " nextEdge=" << e.nextEid
                     << " prevEdge=" << e.prevEid << " fromVertex=" << e.fromVid << " line=" << e.lineId << endl;
         }
         cout << "____Lines (count=" << lines.size() << ")" << endl;
         for (unsigned int i = 0; i < lines.size(); i++) {
-            Line l = lines[i];
+            Line const &l = lines[i];
             cout << " index=" << i << " id=" << l.id << " a=" << l.a << " b=" << l.b << " c=" << l.c << " twinLine=" << l.twinLid << endl;
         }
         cout << "____________________" << endl;
@@ -312,4 +457,626 @@ struct DCEL {
     int getNextLineId() {
         return nextLineId++;
     }
+
+    // two points of the directed line carrying the edge, the edge goes from a towards b;
+    // unbounded edges go along the direction (-b, a) of their line
+    void supportingLine(int eid, cg::point_2 &a, cg::point_2 &b) const {
+        Edge const &edge = edges[eid];
+        Line const &line = lines[edge.lineId];
+        cg::vector_2 direction(-line.b, line.a);
+        int toVid = edges[edge.nextEid].fromVid;
+        if (edge.fromVid != infinityVid) {
+            a = vertexes[edge.fromVid].point;
+            b = toVid != infinityVid ? cg::point_2(vertexes[toVid].point) : a + direction;
+        } else if (toVid != infinityVid) {
+            b = vertexes[toVid].point;
+            a = b + -direction;
+        } else {
+            double norm = double(line.a) * line.a + double(line.b) * line.b;
+            a = cg::point_2(-line.a * double(line.c) / norm, -line.b * double(line.c) / norm);
+            b = a + direction;
+        }
+    }
+};
+
+enum LocationType {
+    LOCATION_FACE,
+    LOCATION_EDGE,
+    LOCATION_VERTEX
+};
+
+// What a point hits in an arrangement: a vertex by its id, an edge by the lesser id of the twin edges,
+// a face by the least id of the edges around it (faces lie to the left of their edges).
+struct Location {
+    LocationType type;
+    int id;
+
+    Location(LocationType type, int id) : type(type), id(id) {
+    }
+};
+
+// Kirkpatrick's point location in the arrangement of a DCEL built by addLine (not triangulated).
+// The arrangement is clipped by a box around its vertexes and its faces are triangulated, with the vertexes
+// at the crossings of their lines in double: rounded to float, the vertexes of tiny faces may make them
+// not convex or not even simple. Then level by level
+// an independent set of vertexes of low degree is removed and the holes are retriangulated, every new triangle
+// keeping the triangles below it that it overlaps, until only the two triangles of the box are left.
+// A query descends from them in O(log n) with O(n) triangles overall. Outside the box no lines cross,
+// there the rays leaving through each side are kept in order and searched by binary search.
+struct KirkpatrickLocator {
+    static const int MAX_DEGREE = 8;
+
+    explicit KirkpatrickLocator(DCEL const &dcel) : levels(1) {
+        setFaces(dcel);
+        setBox(dcel);
+        for (int side = 0; side < 4; side++) {
+            setOuterRays(dcel, side);
+        }
+        triangulateFaces(dcel);
+        buildHierarchy();
+    }
+
+    // throws std::logic_error if the hierarchy misses the point, which happens only if it is broken
+    Location locate(point_2f const &point) const {
+        int vid = vertexAt(point);
+        if (vid != -1) {
+            return Location(LOCATION_VERTEX, vid);
+        }
+        cg::point_2 q(point);
+        if (q.x < minX || q.x > maxX || q.y < minY || q.y > maxY) {
+            return locateOutside(q);
+        }
+        return locateInBox(q);
+    }
+
+    size_t trianglesCount() const {
+        return triangles.size();
+    }
+
+    // the count of triangles in the lowest level by the face ids, every face has at least one
+    vector<int> trianglesByFace() const {
+        vector<int> res(edgeFace.size(), 0);
+        for (size_t t = 0; t < bottomCount; t++) {
+            res[triangles[t].face]++;
+        }
+        return res;
+    }
+
+    int levelsCount() const {
+        return levels;
+    }
+
+private:
+    struct Triangle {
+        int vertex[3];
+        // in the lowest level, the edge along the side vertex[i], vertex[i + 1] or -1 for sides added by triangulation
+        int edge[3];
+        int face;
+        int childrenBegin;
+        int childrenEnd;
+    };
+
+    struct Ray {
+        cg::point_2 from;
+        cg::point_2 to;
+        double position;
+        int edge;
+        int leftFace;
+        int rightFace;
+    };
+
+    struct VertexPoint {
+        point_2f point;
+        int vid;
+    };
+
+    double minX, maxX, minY, maxY;
+    // corners of the box first, counterclockwise from (minX, minY)
+    vector<cg::point_2> points;
+    // the points of the vertexes as the DCEL keeps them, by x and then by y
+    vector<VertexPoint> vertexPoints;
+    vector<Triangle> triangles;
+    // the triangles of the lowest level come first
+    size_t bottomCount;
+    vector<int> children;
+    vector<int> top;
+    // rays going beyond the bottom, right, top and left sides of the box, ordered counterclockwise
+    vector<Ray> outerRays[4];
+    vector<int> edgeFace;
+    vector<int> edgeTwin;
+    vector<Line> edgeLine;
+    int levels;
+
+    static int edgeLabel(DCEL const &dcel, int eid) {
+        return std::min(eid, dcel.edges[eid].twinEid);
+    }
+
+    void setFaces(DCEL const &dcel) {
+        edgeFace.assign(dcel.edges.size(), -1);
+        edgeTwin.resize(dcel.edges.size());
+        edgeLine.clear();
+        for (size_t start = 0; start < dcel.edges.size(); start++) {
+            edgeTwin[start] = dcel.edges[start].twinEid;
+            edgeLine.push_back(dcel.lines[dcel.edges[start].lineId]);
+            if (edgeFace[start] != -1) {
+                continue;
+            }
+            int face = start;
+            for (int eid = dcel.edges[start].nextEid; eid != (int) start; eid = dcel.edges[eid].nextEid) {
+                face = std::min(face, eid);
+            }
+            int eid = start;
+            do {
+                edgeFace[eid] = face;
+                eid = dcel.edges[eid].nextEid;
+            } while (eid != (int) start);
+        }
+    }
+
+    // box around the vertexes, or around some points of the lines if they are parallel
+    void setBox(DCEL const &dcel) {
+        vector<cg::point_2> inside;
+        for (size_t vid = 1; vid < dcel.vertexes.size(); vid++) {
+            inside.push_back(dcel.vertexes[vid].point);
+        }
+        if (inside.empty()) {
+            for (size_t eid = 0; eid < dcel.edges.size(); eid++) {
+                cg::point_2 a, b;
+                dcel.supportingLine(eid, a, b);
+                inside.push_back(a);
+            }
+        }
+        minX = maxX = inside[0].x;
+        minY = maxY = inside[0].y;
+        for (cg::point_2 const &point : inside) {
+            minX = std::min(minX, point.x);
+            maxX = std::max(maxX, point.x);
+            minY = std::min(minY, point.y);
+            maxY = std::max(maxY, point.y);
+        }
+        double margin = std::max(std::max(maxX - minX, maxY - minY), 1.);
+        minX -= margin;
+        maxX += margin;
+        minY -= margin;
+        maxY += margin;
+        points.push_back(cg::point_2(minX, minY));
+        points.push_back(cg::point_2(maxX, minY));
+        points.push_back(cg::point_2(maxX, maxY));
+        points.push_back(cg::point_2(minX, maxY));
+
+        for (size_t vid = 1; vid < dcel.vertexes.size(); vid++) {
+            VertexPoint vertexPoint = {dcel.vertexes[vid].point, int(vid)};
+            vertexPoints.push_back(vertexPoint);
+        }
+        std::sort(vertexPoints.begin(), vertexPoints.end(), [](VertexPoint const &a, VertexPoint const &b) {
+            return a.point.x < b.point.x || (a.point.x == b.point.x && a.point.y < b.point.y);
+        });
+    }
+
+    void setOuterRays(DCEL const &dcel, int side) {
+        cg::vector_2 normal = side == 0 ? cg::vector_2(0, -1) : side == 1 ? cg::vector_2(1, 0)
+                : side == 2 ? cg::vector_2(0, 1) : cg::vector_2(-1, 0);
+        cg::vector_2 tangent(-normal.y, normal.x);
+        double offset = side == 0 ? -minY : side == 1 ? maxX : side == 2 ? maxY : -minX;
+        for (size_t eid = 0; eid < dcel.edges.size(); eid++) {
+            if (dcel.edges[dcel.edges[eid].nextEid].fromVid != dcel.infinityVid) {
+                continue;
+            }
+            Ray ray;
+            dcel.supportingLine(eid, ray.from, ray.to);
+            cg::vector_2 direction = ray.to - ray.from;
+            double speed = direction * normal;
+            if (speed <= 0) {
+                continue;
+            }
+            double shift = (offset - (ray.from - cg::point_2(0, 0)) * normal) / speed;
+            ray.position = (ray.from - cg::point_2(0, 0)) * tangent + shift * (direction * tangent);
+            ray.edge = edgeLabel(dcel, eid);
+            ray.leftFace = edgeFace[eid];
+            ray.rightFace = edgeFace[edgeTwin[eid]];
+            outerRays[side].push_back(ray);
+        }
+        std::sort(outerRays[side].begin(), outerRays[side].end(), [](Ray const &a, Ray const &b) {
+            return a.position < b.position;
+        });
+    }
+
+    // position of a point of the box boundary, counterclockwise from (minX, minY), the sides are of length 1
+    double boxPosition(cg::point_2 const &point) const {
+        if (point.y == minY && point.x < maxX) {
+            return (point.x - minX) / (maxX - minX);
+        }
+        if (point.x == maxX && point.y < maxY) {
+            return 1 + (point.y - minY) / (maxY - minY);
+        }
+        if (point.y == maxY && point.x > minX) {
+            return 2 + (maxX - point.x) / (maxX - minX);
+        }
+        return 3 + (maxY - point.y) / (maxY - minY);
+    }
+
+    // the point where an unbounded edge leaves the box, found from the line and not from the rounded vertex
+    int crossingPoint(int eid, vector<int> &edgePoint) {
+        if (edgePoint[eid] != -1) {
+            return edgePoint[eid];
+        }
+        Line const &line = edgeLine[eid];
+        double norm = double(line.a) * line.a + double(line.b) * line.b;
+        cg::point_2 from(-line.a * double(line.c) / norm, -line.b * double(line.c) / norm);
+        cg::vector_2 direction(-line.b, line.a);
+        double alongX = direction.x > 0 ? (maxX - from.x) / direction.x
+                : direction.x < 0 ? (minX - from.x) / direction.x : HUGE_VAL;
+        double alongY = direction.y > 0 ? (maxY - from.y) / direction.y
+                : direction.y < 0 ? (minY - from.y) / direction.y : HUGE_VAL;
+        cg::point_2 crossing;
+        if (alongX <= alongY) {
+            crossing.x = direction.x > 0 ? maxX : minX;
+            crossing.y = std::min(std::max(from.y + alongX * direction.y, minY), maxY);
+        } else {
+            crossing.x = std::min(std::max(from.x + alongY * direction.x, minX), maxX);
+            crossing.y = direction.y > 0 ? maxY : minY;
+        }
+        int id = std::find(points.begin(), points.begin() + 4, crossing) - points.begin();
+        if (id == 4) {
+            id = points.size();
+            points.push_back(crossing);
+        }
+        return edgePoint[eid] = id;
+    }
+
+    // faces clipped by the box, an unbounded face follows the boundary of the box between its two rays
+    void triangulateFaces(DCEL const &dcel) {
+        vector<int> vertexPoint(dcel.vertexes.size(), -1);
+        vector<int> edgePoint(dcel.edges.size(), -1);
+        vector<int> polygon;
+        vector<int> sides;
+        vector<int> cycle;
+        for (size_t start = 0; start < dcel.edges.size(); start++) {
+            if (edgeFace[start] != (int) start) {
+                continue;
+            }
+            cycle.clear();
+            int eid = start;
+            do {
+                cycle.push_back(eid);
+                eid = dcel.edges[eid].nextEid;
+            } while (eid != (int) start);
+
+            polygon.clear();
+            sides.clear();
+            for (size_t i = 0; i < cycle.size(); i++) {
+                int fromVid = dcel.edges[cycle[i]].fromVid;
+                if (fromVid != dcel.infinityVid) {
+                    if (vertexPoint[fromVid] == -1) {
+                        Vertex const &vertex = dcel.vertexes[fromVid];
+                        vertexPoint[fromVid] = points.size();
+                        points.push_back(DCEL::crossingD(dcel.lines[vertex.lineId1], dcel.lines[vertex.lineId2]));
+                    }
+                    polygon.push_back(vertexPoint[fromVid]);
+                    sides.push_back(edgeLabel(dcel, cycle[i]));
+                    continue;
+                }
+                int in = crossingPoint(cycle[(i + cycle.size() - 1) % cycle.size()], edgePoint);
+                int out = crossingPoint(edgeTwin[cycle[i]], edgePoint);
+                polygon.push_back(in);
+                sides.push_back(-1);
+                double inPosition = boxPosition(points[in]);
+                double outPosition = boxPosition(points[out]);
+                if (outPosition <= inPosition) {
+                    outPosition += 4;
+                }
+                for (int corner = int(inPosition) + 1; corner < outPosition; corner++) {
+                    polygon.push_back(corner % 4);
+                    sides.push_back(-1);
+                }
+                polygon.push_back(out);
+                sides.push_back(edgeLabel(dcel, cycle[i]));
+            }
+            // the faces are convex and the vertexes are close to exact in double, ear clipping may fail
+            // only on a face too thin to tell its sides apart
+            if (!triangulatePolygon(polygon, sides, start)) {
+                throw std::runtime_error("a face of the arrangement is too thin to be triangulated");
+            }
+        }
+        bottomCount = triangles.size();
+    }
+
+    // ear clipping of a counterclockwise polygon, a fan if it is strictly convex; false if no ear is found
+    bool triangulatePolygon(vector<int> const &polygon, vector<int> sides, int face) {
+        size_t size = polygon.size();
+        size_t trianglesWas = triangles.size();
+        bool convex = true;
+        for (size_t i = 0; i < size && convex; i++) {
+            convex = cg::orientation(points[polygon[i]], points[polygon[(i + 1) % size]],
+                    points[polygon[(i + 2) % size]]) == cg::CG_LEFT;
+        }
+        if (convex) {
+            for (size_t i = 1; i + 1 < size; i++) {
+                addTriangle(polygon[0], polygon[i], polygon[i + 1],
+                        i == 1 ? sides[0] : -1, sides[i], i + 2 == size ? sides[i + 1] : -1, face);
+            }
+            return true;
+        }
+
+        vector<int> prev(size);
+        vector<int> next(size);
+        for (size_t i = 0; i < size; i++) {
+            prev[i] = (i + size - 1) % size;
+            next[i] = (i + 1) % size;
+        }
+        size_t left = size;
+        size_t failures = 0;
+        int cur = 0;
+        while (left > 3) {
+            if (isEar(polygon, prev[cur], cur, next[cur])) {
+                int a = prev[cur];
+                int c = next[cur];
+                addTriangle(polygon[a], polygon[cur], polygon[c], sides[a], sides[cur], -1, face);
+                sides[a] = -1;
+                next[a] = c;
+                prev[c] = a;
+                left--;
+                failures = 0;
+                cur = a;
+            } else if (++failures > left) {
+                triangles.resize(trianglesWas);
+                return false;
+            } else {
+                cur = next[cur];
+            }
+        }
+        if (cg::orientation(points[polygon[prev[cur]]], points[polygon[cur]], points[polygon[next[cur]]]) != cg::CG_LEFT) {
+            triangles.resize(trianglesWas);
+            return false;
+        }
+        addTriangle(polygon[prev[cur]], polygon[cur], polygon[next[cur]], sides[prev[cur]], sides[cur], sides[next[cur]], face);
+        return true;
+    }
+
+    bool isEar(vector<int> const &polygon, int a, int b, int c) const {
+        cg::point_2 const &pa = points[polygon[a]];
+        cg::point_2 const &pb = points[polygon[b]];
+        cg::point_2 const &pc = points[polygon[c]];
+        if (cg::orientation(pa, pb, pc) != cg::CG_LEFT) {
+            return false;
+        }
+        for (size_t i = 0; i < polygon.size(); i++) {
+            int other = polygon[i];
+            if ((int) i == a || (int) i == b || (int) i == c) {
+                continue;
+            }
+            if (cg::orientation(pa, pb, points[other]) != cg::CG_RIGHT
+                    && cg::orientation(pb, pc, points[other]) != cg::CG_RIGHT
+                    && cg::orientation(pc, pa, points[other]) != cg::CG_RIGHT) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void addTriangle(int a, int b, int c, int ab, int bc, int ca, int face) {
+        Triangle triangle = {{a, b, c}, {ab, bc, ca}, face, 0, 0};
+        triangles.push_back(triangle);
+    }
+
+    bool contains(Triangle const &triangle, cg::point_2 const &point) const {
+        for (int i = 0; i < 3; i++) {
+            if (cg::orientation(points[triangle.vertex[i]], points[triangle.vertex[(i + 1) % 3]], point) == cg::CG_RIGHT) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // a side of first has the whole second on its outer side
+    bool separates(Triangle const &first, Triangle const &second) const {
+        for (int i = 0; i < 3; i++) {
+            cg::point_2 const &a = points[first.vertex[i]];
+            cg::point_2 const &b = points[first.vertex[(i + 1) % 3]];
+            bool outside = true;
+            for (int j = 0; j < 3 && outside; j++) {
+                outside = cg::orientation(a, b, points[second.vertex[j]]) != cg::CG_LEFT;
+            }
+            if (outside) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool overlap(Triangle const &a, Triangle const &b) const {
+        return !separates(a, b) && !separates(b, a);
+    }
+
+    void buildHierarchy() {
+        vector<int> live(triangles.size());
+        for (size_t i = 0; i < live.size(); i++) {
+            live[i] = i;
+        }
+        size_t alive = points.size();
+        vector<char> removed(points.size(), 0);
+        vector<int> incidentBegin;
+        vector<int> incident;
+        vector<char> blocked;
+        vector<char> replaced;
+        while (alive > 4) {
+            incidentBegin.assign(points.size() + 1, 0);
+            for (int t : live) {
+                for (int v : triangles[t].vertex) {
+                    incidentBegin[v + 1]++;
+                }
+            }
+            for (size_t v = 0; v < points.size(); v++) {
+                incidentBegin[v + 1] += incidentBegin[v];
+            }
+            incident.resize(incidentBegin.back());
+            vector<int> cursor(incidentBegin.begin(), incidentBegin.end() - 1);
+            for (int t : live) {
+                for (int v : triangles[t].vertex) {
+                    incident[cursor[v]++] = t;
+                }
+            }
+
+            blocked.assign(points.size(), 0);
+            replaced.assign(triangles.size(), 0);
+            size_t trianglesWas = triangles.size();
+            size_t removedNow = 0;
+            for (size_t v = 4; v < points.size(); v++) {
+                int degree = incidentBegin[v + 1] - incidentBegin[v];
+                if (removed[v] || blocked[v] || degree > MAX_DEGREE
+                        || !removeVertex(v, &incident[incidentBegin[v]], degree)) {
+                    continue;
+                }
+                for (int i = incidentBegin[v]; i < incidentBegin[v + 1]; i++) {
+                    replaced[incident[i]] = 1;
+                    for (int neighbour : triangles[incident[i]].vertex) {
+                        blocked[neighbour] = 1;
+                    }
+                }
+                removed[v] = 1;
+                removedNow++;
+            }
+            if (removedNow == 0) {
+                break;
+            }
+            alive -= removedNow;
+            levels++;
+
+            size_t kept = 0;
+            for (int t : live) {
+                if (!replaced[t]) {
+                    live[kept++] = t;
+                }
+            }
+            live.resize(kept);
+            for (size_t t = trianglesWas; t < triangles.size(); t++) {
+                live.push_back(t);
+            }
+        }
+        top = live;
+    }
+
+    // retriangulates the hole left by the vertex, it is closed by a side of the box if the vertex lies on it
+    bool removeVertex(int v, int const *incident, int degree) {
+        // a hole needs a closed fan of three triangles or an open one of two against the box
+        if (degree < 2) {
+            return false;
+        }
+        int from[MAX_DEGREE];
+        int to[MAX_DEGREE];
+        for (int i = 0; i < degree; i++) {
+            Triangle const &triangle = triangles[incident[i]];
+            int at = triangle.vertex[0] == v ? 0 : triangle.vertex[1] == v ? 1 : 2;
+            from[i] = triangle.vertex[(at + 1) % 3];
+            to[i] = triangle.vertex[(at + 2) % 3];
+        }
+        int start = 0;
+        for (int i = 0; i < degree; i++) {
+            if (std::find(to, to + degree, from[i]) == to + degree) {
+                start = i;
+            }
+        }
+        vector<int> polygon(1, from[start]);
+        for (int step = 0; step < degree; step++) {
+            int i = std::find(from, from + degree, polygon.back()) - from;
+            if (i == degree) {
+                return false;
+            }
+            polygon.push_back(to[i]);
+        }
+        if (polygon.back() == polygon.front()) {
+            polygon.pop_back();
+        } else if (cg::orientation(points[polygon.back()], points[polygon.front()], points[v]) != cg::CG_COLLINEAR) {
+            return false;
+        }
+
+        size_t trianglesWas = triangles.size();
+        if (!triangulatePolygon(polygon, vector<int>(polygon.size(), -1), -1)) {
+            return false;
+        }
+        for (size_t t = trianglesWas; t < triangles.size(); t++) {
+            triangles[t].childrenBegin = children.size();
+            for (int i = 0; i < degree; i++) {
+                if (overlap(triangles[t], triangles[incident[i]])) {
+                    children.push_back(incident[i]);
+                }
+            }
+            triangles[t].childrenEnd = children.size();
+        }
+        return true;
+    }
+
+    int vertexAt(point_2f const &point) const {
+        auto it = std::lower_bound(vertexPoints.begin(), vertexPoints.end(), point,
+                [](VertexPoint const &vertexPoint, point_2f const &point) {
+            return vertexPoint.point.x < point.x || (vertexPoint.point.x == point.x && vertexPoint.point.y < point.y);
+        });
+        return it != vertexPoints.end() && it->point == point ? it->vid : -1;
+    }
+
+    // the triangles of every level cover the box, so one of the candidates holds the point
+    int containing(int const *begin, int const *end, cg::point_2 const &point) const {
+        while (begin != end && !contains(triangles[*begin], point)) {
+            begin++;
+        }
+        if (begin == end) {
+            throw std::logic_error("the point location hierarchy does not cover the point");
+        }
+        return *begin;
+    }
+
+    Location locateInBox(cg::point_2 const &point) const {
+        int t = containing(top.data(), top.data() + top.size(), point);
+        while (triangles[t].childrenBegin != triangles[t].childrenEnd) {
+            t = containing(children.data() + triangles[t].childrenBegin,
+                    children.data() + triangles[t].childrenEnd, point);
+        }
+
+        Triangle const &leaf = triangles[t];
+        for (int i = 0; i < 3; i++) {
+            if (leaf.edge[i] != -1 && onLine(edgeLine[leaf.edge[i]], point)) {
+                return Location(LOCATION_EDGE, leaf.edge[i]);
+            }
+        }
+        return Location(LOCATION_FACE, leaf.face);
+    }
+
+    // exact: the products of floats are exact in double, the sum is checked in rationals when it is close to 0
+    static bool onLine(Line const &line, cg::point_2 const &point) {
+        double ax = line.a * point.x;
+        double by = line.b * point.y;
+        double res = ax + by + line.c;
+        double eps = (fabs(ax) + fabs(by) + fabs(line.c)) * 4 * std::numeric_limits<double>::epsilon();
+        if (fabs(res) > eps) {
+            return false;
+        }
+        return mpq_class(line.a) * point.x + mpq_class(line.b) * point.y + line.c == 0;
+    }
+
+    // the rays beyond a side of the box do not cross, the point lies between two of them
+    Location locateOutside(cg::point_2 const &point) const {
+        int side = point.y < minY ? 0 : point.x > maxX ? 1 : point.y > maxY ? 2 : 3;
+        vector<Ray> const &rays = outerRays[side];
+        if (rays.empty()) {
+            // no line goes there, the way to the box is free
+            return locateInBox(cg::point_2(std::min(std::max(point.x, minX), maxX), std::min(std::max(point.y, minY), maxY)));
+        }
+        size_t lo = 0;
+        size_t hi = rays.size();
+        while (lo < hi) {
+            size_t mid = (lo + hi) / 2;
+            if (cg::orientation(rays[mid].from, rays[mid].to, point) == cg::CG_LEFT) {
+                lo = mid + 1;
+            } else {
+                hi = mid;
+            }
+        }
+        if (lo == rays.size()) {
+            return Location(LOCATION_FACE, rays.back().leftFace);
+        }
+        if (cg::orientation(rays[lo].from, rays[lo].to, point) == cg::CG_COLLINEAR) {
+            return Location(LOCATION_EDGE, rays[lo].edge);
+        }
+        return Location(LOCATION_FACE, rays[lo].rightFace);
+    }
 };
@@ -0,0 +1,326 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <iterator>
+#include <future>
+#include <type_traits>
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+#include "cg/structures/skipquadtree.h"
+
+// Static index over a point set: the points are kept sorted by Morton code in flat arrays,
+// so the points of every cell of the key grid lie in one contiguous run found by binary search.
+// A range query walks this implicit quadtree down to the cells lying in the range, which are reported whole,
+// and to runs of at most SCAN_SIZE points, which are scanned (four or eight points at a time with SSE or AVX).
+// Adjacent runs are merged before the scan. Ids are the positions of the points in Morton order.
+template<class Scalar>
+struct LinearQuadTreeT {
+    typedef cg::point_2t<Scalar> Point;
+    typedef RangeT<Scalar> Range;
+
+    static const size_t SCAN_SIZE = 64;
+
+    LinearQuadTreeT();
+
+    template<class InputIt>
+    LinearQuadTreeT(InputIt begin, InputIt end, size_t threads = 1);
+
+    // Replaces the content of the index by the points of [begin, end) (duplicates are dropped).
+    // Up to threads tasks compute the codes and sort them.
+    template<class InputIt>
+    void build(InputIt begin, InputIt end, size_t threads = 1);
+
+    std::list<std::pair<int, Point>> getContainWithId(Point p1, Point p2, Scalar eps) const;
+
+    std::list<std::pair<int, Point>> getContainWithId(Range range, Scalar eps) const;
+
+    std::list<Point> getContain(Point p1, Point p2, Scalar eps) const;
+
+    std::list<Point> getContain(Range range, Scalar eps) const;
+
+    // points are reported in Morton order
+    template<class Visitor>
+    void forEachInRange(Range range, Scalar eps, Visitor visitor) const;
+
+    template<class OutputIt>
+    OutputIt queryInto(Range range, Scalar eps, OutputIt out) const;
+
+    size_t countInRange(Range range, Scalar eps) const;
+
+    Point point(int id) const;
+
+    size_t size() const;
+
+    size_t bytesUsed() const;
+
+private:
+    std::vector<uint64_t> codes;
+    std::vector<Scalar> xs;
+    std::vector<Scalar> ys;
+    // smallest cell containing all points
+    Cell root;
+
+    // the run [scanBegin, scanEnd) waits to be scanned until the next run that does not continue it
+    struct Query {
+        RangeQuery<Scalar> rangeQuery;
+        size_t scanBegin;
+        size_t scanEnd;
+
+        Query(Range const &range, Scalar eps) : rangeQuery(range, eps), scanBegin(0), scanEnd(0) {
+        }
+    };
+
+    template<class Visitor>
+    void visitCell(Cell const &cell, size_t begin, size_t end, Query &query, Visitor &visitor) const;
+
+    template<class Visitor>
+    void flushScan(Query &query, Visitor &visitor) const;
+
+    template<class Visitor>
+    void scan(size_t begin, size_t end, Range const &rect, Visitor &visitor) const;
+};
+
+typedef LinearQuadTreeT<float> LinearQuadTree;
+
+//_______________________________________________________IMPLEMENTATION_________________________________________________
+
+// LinearQuadTree implementation BEGIN
+template<class Scalar>
+LinearQuadTreeT<Scalar>::LinearQuadTreeT() {
+    Cell whole = {0, 0, 0};
+    root = whole;
+}
+
+template<class Scalar>
+template<class InputIt>
+LinearQuadTreeT<Scalar>::LinearQuadTreeT(InputIt begin, InputIt end, size_t threads) {
+    build(begin, end, threads);
+}
+
+template<class Scalar>
+template<class InputIt>
+void LinearQuadTreeT<Scalar>::build(InputIt begin, InputIt end, size_t threads) {
+    std::vector<Point> input(begin, end);
+    size_t n = input.size();
+    threads = std::max<size_t>(threads, 1);
+    size_t chunk = std::max<size_t>((n + threads - 1) / threads, 1);
+    std::launch policy = threads > 1 ? std::launch::async : std::launch::deferred;
+
+    codes.resize(n);
+    std::vector<std::future<void>> tasks;
+    for (size_t from = 0; from < n; from += chunk) {
+        tasks.push_back(std::async(policy, [this, &input, from, chunk, n]() {
+            for (size_t i = from; i < std::min(n, from + chunk); i++) {
+                codes[i] = mortonCode(toKeyPoint(input[i]));
+            }
+        }));
+    }
+    for (auto &task : tasks) {
+        task.get();
+    }
+    std::vector<Point>().swap(input);
+
+    sortMortonCodes(codes, threads);
+    codes.erase(std::unique(codes.begin(), codes.end()), codes.end());
+    codes.shrink_to_fit();
+
+    n = codes.size();
+    xs.assign(n, Scalar());
+    ys.assign(n, Scalar());
+    tasks.clear();
+    for (size_t from = 0; from < n; from += chunk) {
+        tasks.push_back(std::async(policy, [this, from, chunk, n]() {
+            for (size_t i = from; i < std::min(n, from + chunk); i++) {
+                Point point = mortonPoint<Scalar>(codes[i]);
+                xs[i] = point.x;
+                ys[i] = point.y;
+            }
+        }));
+    }
+    for (auto &task : tasks) {
+        task.get();
+    }
+
+    Cell whole = {0, 0, 0};
+    root = n == 0 ? whole : mortonCell(codes.front(), commonLevel(codes.front(), codes.back()));
+}
+
+template<class Scalar>
+template<class Visitor>
+void LinearQuadTreeT<Scalar>::visitCell(Cell const &cell, size_t begin, size_t end, Query &query,
+        Visitor &visitor) const {
+    if (begin == end || query.rangeQuery.misses(cell)) {
+        return;
+    }
+
+    if (query.rangeQuery.accepts(cell)) {
+        // the waiting run comes first in Morton order
+        flushScan(query, visitor);
+        for (size_t i = begin; i < end; i++) {
+            visitor(int(i), Point(xs[i], ys[i]));
+        }
+        query.scanBegin = query.scanEnd = end;
+        return;
+    }
+
+    if (end - begin <= SCAN_SIZE) {
+        if (query.scanEnd != begin) {
+            flushScan(query, visitor);
+            query.scanBegin = begin;
+        }
+        query.scanEnd = end;
+        return;
+    }
+
+    int shift = 31 - cell.lvl;
+    uint64_t const *first = codes.data();
+    size_t childBegin = begin;
+    for (int i = 0; i < 4; i++) {
+        Cell child = {cell.lvl + 1, cell.fromX | (uint32_t(i >> 1) << shift), cell.fromY | (uint32_t(i & 1) << shift)};
+        size_t childEnd = i == 3 ? end
+                : std::upper_bound(first + childBegin, first + end, mortonCellLast(child)) - first;
+        visitCell(child, childBegin, childEnd, query, visitor);
+        childBegin = childEnd;
+    }
+}
+
+template<class Scalar>
+template<class Visitor>
+void LinearQuadTreeT<Scalar>::flushScan(Query &query, Visitor &visitor) const {
+    if (query.scanBegin != query.scanEnd) {
+        scan(query.scanBegin, query.scanEnd, query.rangeQuery.rect, visitor);
+    }
+    query.scanBegin = query.scanEnd;
+}
+
+// points of [begin, end) lying in rect
+template<class Scalar>
+template<class Visitor>
+void LinearQuadTreeT<Scalar>::scan(size_t begin, size_t end, Range const &rect, Visitor &visitor) const {
+    size_t i = begin;
+#if defined(__AVX__)
+    if (std::is_same<Scalar, float>::value) {
+        float const *x = reinterpret_cast<float const *>(xs.data());
+        float const *y = reinterpret_cast<float const *>(ys.data());
+        __m256 fromX = _mm256_set1_ps(rect.fromX), toX = _mm256_set1_ps(rect.toX);
+        __m256 fromY = _mm256_set1_ps(rect.fromY), toY = _mm256_set1_ps(rect.toY);
+        for (; i + 8 <= end; i += 8) {
+            __m256 px = _mm256_loadu_ps(x + i);
+            __m256 py = _mm256_loadu_ps(y + i);
+            __m256 in = _mm256_and_ps(
+                    _mm256_and_ps(_mm256_cmp_ps(px, fromX, _CMP_GE_OQ), _mm256_cmp_ps(px, toX, _CMP_LT_OQ)),
+                    _mm256_and_ps(_mm256_cmp_ps(py, fromY, _CMP_GE_OQ), _mm256_cmp_ps(py, toY, _CMP_LT_OQ)));
+            for (int mask = _mm256_movemask_ps(in); mask != 0; mask &= mask - 1) {
+                size_t j = i + __builtin_ctz(mask);
+                visitor(int(j), Point(xs[j], ys[j]));
+            }
+        }
+    }
+#elif defined(__SSE2__)
+    if (std::is_same<Scalar, float>::value) {
+        float const *x = reinterpret_cast<float const *>(xs.data());
+        float const *y = reinterpret_cast<float const *>(ys.data());
+        __m128 fromX = _mm_set1_ps(rect.fromX), toX = _mm_set1_ps(rect.toX);
+        __m128 fromY = _mm_set1_ps(rect.fromY), toY = _mm_set1_ps(rect.toY);
+        for (; i + 4 <= end; i += 4) {
+            __m128 px = _mm_loadu_ps(x + i);
+            __m128 py = _mm_loadu_ps(y + i);
+            __m128 in = _mm_and_ps(
+                    _mm_and_ps(_mm_cmpge_ps(px, fromX), _mm_cmplt_ps(px, toX)),
+                    _mm_and_ps(_mm_cmpge_ps(py, fromY), _mm_cmplt_ps(py, toY)));
+            for (int mask = _mm_movemask_ps(in); mask != 0; mask &= mask - 1) {
+                size_t j = i + __builtin_ctz(mask);
+                visitor(int(j), Point(xs[j], ys[j]));
+            }
+        }
+    }
+#endif
+    for (; i < end; i++) {
+        if (xs[i] >= rect.fromX && xs[i] < rect.toX && ys[i] >= rect.fromY && ys[i] < rect.toY) {
+            visitor(int(i), Point(xs[i], ys[i]));
+        }
+    }
+}
+
+template<class Scalar>
+std::list<std::pair<int, cg::point_2t<Scalar>>> LinearQuadTreeT<Scalar>::getContainWithId(Point p1, Point p2,
+        Scalar eps) const {
+    Range rect(-239,
+            std::min(p1.x, p2.x), std::max(p1.x, p2.x),
+            std::min(p1.y, p2.y), std::max(p1.y, p2.y));
+    return getContainWithId(rect, eps);
+}
+
+template<class Scalar>
+std::list<std::pair<int, cg::point_2t<Scalar>>> LinearQuadTreeT<Scalar>::getContainWithId(Range range,
+        Scalar eps) const {
+    std::list<std::pair<int, Point>> res;
+    forEachInRange(range, eps, [&res](int id, Point point) {
+        res.push_back(std::make_pair(id, point));
+    });
+    return res;
+}
+
+template<class Scalar>
+std::list<cg::point_2t<Scalar>> LinearQuadTreeT<Scalar>::getContain(Point p1, Point p2, Scalar eps) const {
+    Range rect(-239,
+            std::min(p1.x, p2.x), std::max(p1.x, p2.x),
+            std::min(p1.y, p2.y), std::max(p1.y, p2.y));
+    return getContain(rect, eps);
+}
+
+template<class Scalar>
+std::list<cg::point_2t<Scalar>> LinearQuadTreeT<Scalar>::getContain(Range range, Scalar eps) const {
+    std::list<Point> res;
+    queryInto(range, eps, std::back_inserter(res));
+    return res;
+}
+
+template<class Scalar>
+template<class Visitor>
+void LinearQuadTreeT<Scalar>::forEachInRange(Range range, Scalar eps, Visitor visitor) const {
+    Query query(range, eps);
+    visitCell(root, 0, codes.size(), query, visitor);
+    flushScan(query, visitor);
+}
+
+template<class Scalar>
+template<class OutputIt>
+OutputIt LinearQuadTreeT<Scalar>::queryInto(Range range, Scalar eps, OutputIt out) const {
+    forEachInRange(range, eps, [&out](int, Point point) {
+        *out++ = point;
+    });
+    return out;
+}
+
+template<class Scalar>
+size_t LinearQuadTreeT<Scalar>::countInRange(Range range, Scalar eps) const {
+    size_t count = 0;
+    forEachInRange(range, eps, [&count](int, Point) {
+        count++;
+    });
+    return count;
+}
+
+template<class Scalar>
+cg::point_2t<Scalar> LinearQuadTreeT<Scalar>::point(int id) const {
+    return Point(xs[id], ys[id]);
+}
+
+template<class Scalar>
+size_t LinearQuadTreeT<Scalar>::size() const {
+    return codes.size();
+}
+
+template<class Scalar>
+size_t LinearQuadTreeT<Scalar>::bytesUsed() const {
+    return codes.capacity() * sizeof(uint64_t) + (xs.capacity() + ys.capacity()) * sizeof(Scalar);
+}
+// LinearQuadTree implementation END
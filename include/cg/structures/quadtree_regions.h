@@ -0,0 +1,226 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+#include "cg/primitives/contour.h"
+#include "cg/primitives/rectangle.h"
+#include "cg/primitives/segment.h"
+#include "cg/operations/orientation.h"
+#include "cg/operations/contains/contour_point.h"
+#include "cg/operations/has_intersection/rectangle_segment.h"
+#include "cg/structures/skipquadtree.h"
+
+// Regions for SkipQuadTree::forEachInRegion. Boxes are closed, so cells with points on the border
+// of a region are never skipped or reported whole by mistake. Points are tested with the exact predicates
+// of the library, except the disc, which compares squared distances in double.
+
+// Closed disc.
+struct DiscRegion {
+    DiscRegion(cg::point_2 center, double radius);
+
+    template<class Scalar>
+    RegionPosition locate(RangeT<Scalar> const &box) const;
+
+    template<class Scalar>
+    bool contains(cg::point_2t<Scalar> point) const;
+
+private:
+    cg::point_2 center;
+    double squaredRadius;
+};
+
+// Closed half-plane to the left of the directed line through a and b.
+struct HalfPlaneRegion {
+    HalfPlaneRegion(cg::point_2 a, cg::point_2 b);
+
+    template<class Scalar>
+    RegionPosition locate(RangeT<Scalar> const &box) const;
+
+    template<class Scalar>
+    bool contains(cg::point_2t<Scalar> point) const;
+
+private:
+    cg::point_2 a;
+    cg::point_2 b;
+};
+
+// Convex polygon with its border, the contour is counterclockwise.
+struct ConvexRegion {
+    explicit ConvexRegion(cg::contour_2 const &contour);
+
+    template<class Scalar>
+    RegionPosition locate(RangeT<Scalar> const &box) const;
+
+    template<class Scalar>
+    bool contains(cg::point_2t<Scalar> point) const;
+
+private:
+    cg::contour_2 contour;
+    cg::rectangle_2 bounds;
+};
+
+// Simple polygon with its border, in any orientation.
+struct PolygonRegion {
+    explicit PolygonRegion(cg::contour_2 const &contour);
+
+    template<class Scalar>
+    RegionPosition locate(RangeT<Scalar> const &box) const;
+
+    template<class Scalar>
+    bool contains(cg::point_2t<Scalar> point) const;
+
+private:
+    cg::contour_2 contour;
+    cg::rectangle_2 bounds;
+    std::vector<cg::segment_2> edges;
+};
+
+//_______________________________________________________IMPLEMENTATION_________________________________________________
+
+// the corners of the closed box
+template<class Scalar>
+void boxCorners(RangeT<Scalar> const &box, cg::point_2 corners[4]) {
+    corners[0] = cg::point_2(box.fromX, box.fromY);
+    corners[1] = cg::point_2(box.toX, box.fromY);
+    corners[2] = cg::point_2(box.toX, box.toY);
+    corners[3] = cg::point_2(box.fromX, box.toY);
+}
+
+template<class Scalar>
+cg::rectangle_2 boxRectangle(RangeT<Scalar> const &box) {
+    return cg::rectangle_2(cg::range_t<double>(box.fromX, box.toX), cg::range_t<double>(box.fromY, box.toY));
+}
+
+inline cg::rectangle_2 regionBounds(cg::contour_2 const &contour) {
+    double fromX = HUGE_VAL, toX = -HUGE_VAL, fromY = HUGE_VAL, toY = -HUGE_VAL;
+    for (cg::point_2 const &point : contour) {
+        fromX = std::min(fromX, point.x);
+        toX = std::max(toX, point.x);
+        fromY = std::min(fromY, point.y);
+        toY = std::max(toY, point.y);
+    }
+    return cg::rectangle_2(cg::range_t<double>(fromX, toX), cg::range_t<double>(fromY, toY));
+}
+
+inline bool disjointBoxes(cg::rectangle_2 const &a, cg::rectangle_2 const &b) {
+    return a.x.sup < b.x.inf || b.x.sup < a.x.inf || a.y.sup < b.y.inf || b.y.sup < a.y.inf;
+}
+
+// DiscRegion implementation BEGIN
+inline DiscRegion::DiscRegion(cg::point_2 center, double radius) : center(center), squaredRadius(radius * radius) {
+}
+
+// the box is decided only when it is clearly apart from the circle, the error of the squares
+// is far below the margin
+template<class Scalar>
+RegionPosition DiscRegion::locate(RangeT<Scalar> const &box) const {
+    double nearX = std::max(std::max(box.fromX - center.x, center.x - box.toX), 0.);
+    double nearY = std::max(std::max(box.fromY - center.y, center.y - box.toY), 0.);
+    if (nearX * nearX + nearY * nearY > squaredRadius * (1 + 1e-9)) {
+        return REGION_OUTSIDE;
+    }
+    double farX = std::max(std::abs(box.fromX - center.x), std::abs(box.toX - center.x));
+    double farY = std::max(std::abs(box.fromY - center.y), std::abs(box.toY - center.y));
+    if (farX * farX + farY * farY < squaredRadius * (1 - 1e-9)) {
+        return REGION_INSIDE;
+    }
+    return REGION_BOUNDARY;
+}
+
+template<class Scalar>
+bool DiscRegion::contains(cg::point_2t<Scalar> point) const {
+    double dx = point.x - center.x;
+    double dy = point.y - center.y;
+    return dx * dx + dy * dy <= squaredRadius;
+}
+// DiscRegion implementation END
+
+// HalfPlaneRegion implementation BEGIN
+inline HalfPlaneRegion::HalfPlaneRegion(cg::point_2 a, cg::point_2 b) : a(a), b(b) {
+}
+
+template<class Scalar>
+RegionPosition HalfPlaneRegion::locate(RangeT<Scalar> const &box) const {
+    cg::point_2 corners[4];
+    boxCorners(box, corners);
+    int right = 0;
+    for (cg::point_2 const &corner : corners) {
+        right += cg::orientation(a, b, corner) == cg::CG_RIGHT;
+    }
+    return right == 0 ? REGION_INSIDE : right == 4 ? REGION_OUTSIDE : REGION_BOUNDARY;
+}
+
+template<class Scalar>
+bool HalfPlaneRegion::contains(cg::point_2t<Scalar> point) const {
+    return cg::orientation(a, b, cg::point_2(point)) != cg::CG_RIGHT;
+}
+// HalfPlaneRegion implementation END
+
+// ConvexRegion implementation BEGIN
+inline ConvexRegion::ConvexRegion(cg::contour_2 const &contour) : contour(contour), bounds(regionBounds(contour)) {
+}
+
+// outside if an edge separates the box from the polygon, inside if the corners are
+template<class Scalar>
+RegionPosition ConvexRegion::locate(RangeT<Scalar> const &box) const {
+    if (contour.size() == 0 || disjointBoxes(bounds, boxRectangle(box))) {
+        return REGION_OUTSIDE;
+    }
+    cg::point_2 corners[4];
+    boxCorners(box, corners);
+    if (contour.size() >= 3) {
+        for (size_t prev = contour.size() - 1, cur = 0; cur != contour.size(); prev = cur++) {
+            bool separates = true;
+            for (int i = 0; i < 4 && separates; i++) {
+                separates = cg::orientation(contour[prev], contour[cur], corners[i]) == cg::CG_RIGHT;
+            }
+            if (separates) {
+                return REGION_OUTSIDE;
+            }
+        }
+    }
+    for (cg::point_2 const &corner : corners) {
+        if (!cg::convex_contains(contour, corner)) {
+            return REGION_BOUNDARY;
+        }
+    }
+    return REGION_INSIDE;
+}
+
+template<class Scalar>
+bool ConvexRegion::contains(cg::point_2t<Scalar> point) const {
+    return cg::convex_contains(contour, cg::point_2(point));
+}
+// ConvexRegion implementation END
+
+// PolygonRegion implementation BEGIN
+inline PolygonRegion::PolygonRegion(cg::contour_2 const &contour) : contour(contour), bounds(regionBounds(contour)) {
+    for (size_t prev = contour.size() - 1, cur = 0; cur < contour.size(); prev = cur++) {
+        edges.push_back(cg::segment_2(contour[prev], contour[cur]));
+    }
+}
+
+// a box crossed by no edge is inside or outside as a whole, like any of its corners
+template<class Scalar>
+RegionPosition PolygonRegion::locate(RangeT<Scalar> const &box) const {
+    cg::rectangle_2 rectangle = boxRectangle(box);
+    if (contour.size() == 0 || disjointBoxes(bounds, rectangle)) {
+        return REGION_OUTSIDE;
+    }
+    for (cg::segment_2 const &edge : edges) {
+        cg::rectangle_2 edgeBounds(cg::range_t<double>(std::min(edge[0].x, edge[1].x), std::max(edge[0].x, edge[1].x)),
+                cg::range_t<double>(std::min(edge[0].y, edge[1].y), std::max(edge[0].y, edge[1].y)));
+        if (!disjointBoxes(edgeBounds, rectangle) && cg::has_intersection(rectangle, edge)) {
+            return REGION_BOUNDARY;
+        }
+    }
+    return cg::contains(contour, cg::point_2(box.fromX, box.fromY)) ? REGION_INSIDE : REGION_OUTSIDE;
+}
+
+template<class Scalar>
+bool PolygonRegion::contains(cg::point_2t<Scalar> point) const {
+    return cg::contains(contour, cg::point_2(point));
+}
+// PolygonRegion implementation END
@@ -0,0 +1,429 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <string>
+#include <ostream>
+#include <fstream>
+#include <cstdint>
+#include <cstring>
+#include <cassert>
+#include <stdexcept>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "cg/structures/skipquadtree.h"
+
+// Snapshot of a SkipQuadTree: a header followed by the middle nodes and the term nodes of all skip levels.
+// Nodes refer to each other by their indices in these arrays, so the image holds no pointers and
+// may be mapped at any address. All numbers are in the byte order of the writer, which is checked on load.
+const char SNAPSHOT_MAGIC[8] = {'C', 'G', 'S', 'K', 'I', 'P', 'Q', 'T'};
+const uint32_t SNAPSHOT_VERSION = 1;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    // see SnapshotScalar
+    uint32_t scalar;
+    uint32_t skipLevels;
+    NodeRef lowDetailedRoot;
+    uint32_t reserved;
+    // offsets from the beginning of the image
+    uint64_t middleOffset;
+    uint64_t middleCount;
+    uint64_t termOffset;
+    uint64_t termCount;
+    uint64_t size;
+};
+
+template<class Scalar>
+struct SnapshotScalar;
+
+template<>
+struct SnapshotScalar<float> {
+    static const uint32_t TAG = 1;
+};
+
+template<>
+struct SnapshotScalar<int> {
+    static const uint32_t TAG = 2;
+};
+
+// Writes the reachable nodes of the tree, level by level from the least detailed one,
+// every level in depth-first order. Throws std::runtime_error if the stream fails.
+template<class Scalar>
+void writeSnapshot(SkipQuadTreeT<Scalar> const &tree, std::ostream &os);
+
+template<class Scalar>
+void saveSnapshot(SkipQuadTreeT<Scalar> const &tree, std::string const &path);
+
+// Read-only mapping of a whole file, the file may be removed while it is mapped.
+struct MappedFile {
+    // throws std::runtime_error if the file can not be mapped
+    explicit MappedFile(std::string const &path);
+
+    ~MappedFile();
+
+    void const *data() const;
+
+    size_t size() const;
+
+private:
+    MappedFile(MappedFile const &);
+
+    MappedFile &operator=(MappedFile const &);
+
+    void *address;
+    size_t length;
+};
+
+// Queries over a snapshot image in place, nothing is copied or deserialized.
+// The header and the links of every node are checked once on construction, so the queries
+// need no checks. The image must not change while the snapshot is used.
+template<class Scalar>
+struct SkipQuadTreeSnapshotT {
+    typedef cg::point_2t<Scalar> Point;
+    typedef RangeT<Scalar> Range;
+    typedef TermNodeT<Scalar> TermNode;
+
+    // throws std::runtime_error if data is not aligned to 8 bytes, the image is not
+    // a snapshot of this version and scalar type or a link of a node is broken
+    SkipQuadTreeSnapshotT(void const *data, size_t size);
+
+    std::list<std::pair<int, Point>> getContainWithId(Range range, Scalar eps) const;
+
+    std::list<Point> getContain(Point p1, Point p2, Scalar eps) const;
+
+    std::list<Point> getContain(Range range, Scalar eps) const;
+
+    template<class Visitor>
+    void forEachInRange(Range range, Scalar eps, Visitor visitor) const;
+
+    template<class OutputIt>
+    OutputIt queryInto(Range range, Scalar eps, OutputIt out) const;
+
+    size_t countInRange(Range range, Scalar eps) const;
+
+    int skipLevels() const;
+
+    size_t nodesCount() const;
+
+private:
+    SnapshotHeader const *header;
+    MiddleNode const *middleNodes;
+    TermNode const *termNodes;
+
+    typedef SkipLevels<SkipQuadTreeSnapshotT> Levels;
+
+    template<class Nodes>
+    friend struct SkipLevels;
+
+    // every ref is of an existing node, children have deeper cells than their parents and links
+    // lead to the nodes written later, so every walk ends
+    void checkNodes() const;
+
+    bool isValidRef(NodeRef node) const;
+
+    MiddleNode const &middle(NodeRef node) const;
+
+    TermNode const &term(NodeRef node) const;
+
+    static NodeRef childOf(MiddleNode const &node, int i);
+
+    static NodeRef moreDetailedOf(MiddleNode const &node);
+
+    int nodeId(NodeRef node) const;
+};
+
+typedef SkipQuadTreeSnapshotT<float> SkipQuadTreeSnapshot;
+
+//_______________________________________________________IMPLEMENTATION_________________________________________________
+
+// Writing implementation BEGIN
+static_assert(std::is_standard_layout<MiddleNode>::value && sizeof(MiddleNode) == 32,
+        "MiddleNode is written as is");
+static_assert(sizeof(SnapshotHeader) % 8 == 0, "nodes follow the header");
+
+template<class Scalar>
+void writeSnapshot(SkipQuadTreeT<Scalar> const &tree, std::ostream &os) {
+    typedef TermNodeT<Scalar> TermNode;
+
+    // new indices of the old ones, the nodes are numbered in the order they are written
+    std::vector<NodeRef> middleIndex;
+    std::vector<NodeRef> termIndex;
+    std::vector<NodeRef> middleOrder;
+    std::vector<NodeRef> termOrder;
+    auto renumber = [&](NodeRef node) -> NodeRef {
+        std::vector<NodeRef> &index = isTermNode(node) ? termIndex : middleIndex;
+        std::vector<NodeRef> &order = isTermNode(node) ? termOrder : middleOrder;
+        uint32_t id = tree.nodeId(node);
+        if (id >= index.size()) {
+            index.resize(id + 1, NULL_NODE);
+        }
+        if (index[id] == NULL_NODE) {
+            index[id] = NodeRef(order.size());
+            order.push_back(node);
+        }
+        return isTermNode(node) ? index[id] | TERM_NODE_BIT : index[id];
+    };
+
+    std::vector<NodeRef> stack;
+    for (NodeRef level = tree.lowDetailedRoot; level != NULL_NODE;
+            level = isTermNode(level) ? NULL_NODE : tree.middle(level).linkToMoreDetailed) {
+        stack.push_back(level);
+        while (!stack.empty()) {
+            NodeRef node = stack.back();
+            stack.pop_back();
+            renumber(node);
+            if (!isTermNode(node)) {
+                MiddleNode const &middleNode = tree.middle(node);
+                for (int i = 3; i >= 0; i--) {
+                    if (middleNode.children[i] != NULL_NODE) {
+                        stack.push_back(middleNode.children[i]);
+                    }
+                }
+            }
+        }
+    }
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.byteOrder = SNAPSHOT_BYTE_ORDER;
+    header.scalar = SnapshotScalar<Scalar>::TAG;
+    header.skipLevels = tree.skipLevels;
+    header.lowDetailedRoot = tree.lowDetailedRoot == NULL_NODE ? NULL_NODE : renumber(tree.lowDetailedRoot);
+    header.middleOffset = sizeof(SnapshotHeader);
+    header.middleCount = middleOrder.size();
+    header.termOffset = header.middleOffset + header.middleCount * sizeof(MiddleNode);
+    header.termCount = termOrder.size();
+    size_t termBytes = header.termCount * sizeof(TermNode);
+    header.size = header.termOffset + (termBytes + 7) / 8 * 8;
+    os.write(reinterpret_cast<char const *>(&header), sizeof(header));
+
+    for (NodeRef node : middleOrder) {
+        MiddleNode middleNode = tree.middle(node);
+        for (NodeRef &child : middleNode.children) {
+            if (child != NULL_NODE) {
+                child = renumber(child);
+            }
+        }
+        if (middleNode.linkToMoreDetailed != NULL_NODE) {
+            middleNode.linkToMoreDetailed = renumber(middleNode.linkToMoreDetailed);
+        }
+        os.write(reinterpret_cast<char const *>(&middleNode), sizeof(middleNode));
+    }
+    for (NodeRef node : termOrder) {
+        TermNode termNode = tree.term(node);
+        os.write(reinterpret_cast<char const *>(&termNode), sizeof(termNode));
+    }
+    char const padding[8] = {};
+    os.write(padding, header.size - header.termOffset - termBytes);
+
+    if (!os) {
+        throw std::runtime_error("can not write the snapshot");
+    }
+}
+
+template<class Scalar>
+void saveSnapshot(SkipQuadTreeT<Scalar> const &tree, std::string const &path) {
+    std::ofstream os(path.c_str(), std::ios::binary | std::ios::trunc);
+    if (!os) {
+        throw std::runtime_error("can not open " + path);
+    }
+    writeSnapshot(tree, os);
+    os.close();
+    if (!os) {
+        throw std::runtime_error("can not write " + path);
+    }
+}
+// Writing implementation END
+
+// MappedFile implementation BEGIN
+inline MappedFile::MappedFile(std::string const &path) : address(NULL), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd == -1) {
+        throw std::runtime_error("can not open " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) == -1) {
+        close(fd);
+        throw std::runtime_error("can not stat " + path);
+    }
+    length = st.st_size;
+    if (length != 0) {
+        address = mmap(NULL, length, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw std::runtime_error("can not map " + path);
+    }
+}
+
+inline MappedFile::~MappedFile() {
+    if (address != NULL) {
+        munmap(address, length);
+    }
+}
+
+inline void const *MappedFile::data() const {
+    return address;
+}
+
+inline size_t MappedFile::size() const {
+    return length;
+}
+// MappedFile implementation END
+
+// SkipQuadTreeSnapshot implementation BEGIN
+template<class Scalar>
+SkipQuadTreeSnapshotT<Scalar>::SkipQuadTreeSnapshotT(void const *data, size_t size) {
+    if (reinterpret_cast<uintptr_t>(data) % 8 != 0) {
+        throw std::runtime_error("snapshot is not aligned to 8 bytes");
+    }
+    header = static_cast<SnapshotHeader const *>(data);
+    if (size < sizeof(SnapshotHeader) || std::memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        throw std::runtime_error("not a skip quadtree snapshot");
+    }
+    if (header->version != SNAPSHOT_VERSION || header->byteOrder != SNAPSHOT_BYTE_ORDER) {
+        throw std::runtime_error("unsupported snapshot version or byte order");
+    }
+    if (header->scalar != SnapshotScalar<Scalar>::TAG) {
+        throw std::runtime_error("snapshot of another coordinate type");
+    }
+    if (header->size > size
+            || header->middleOffset < sizeof(SnapshotHeader)
+            || header->middleCount > (header->size - header->middleOffset) / sizeof(MiddleNode)
+            || header->termOffset < header->middleOffset + header->middleCount * sizeof(MiddleNode)
+            || header->termCount > (header->size - header->termOffset) / sizeof(TermNode)) {
+        throw std::runtime_error("truncated snapshot");
+    }
+    char const *base = static_cast<char const *>(data);
+    middleNodes = reinterpret_cast<MiddleNode const *>(base + header->middleOffset);
+    termNodes = reinterpret_cast<TermNode const *>(base + header->termOffset);
+    checkNodes();
+}
+
+template<class Scalar>
+void SkipQuadTreeSnapshotT<Scalar>::checkNodes() const {
+    if (header->lowDetailedRoot != NULL_NODE && !isValidRef(header->lowDetailedRoot)) {
+        throw std::runtime_error("broken root of the snapshot");
+    }
+    for (uint64_t i = 0; i < header->middleCount; i++) {
+        MiddleNode const &node = middleNodes[i];
+        if (node.cell.lvl < 0 || node.cell.lvl > 32) {
+            throw std::runtime_error("broken cell in the snapshot");
+        }
+        for (NodeRef child : node.children) {
+            if (child != NULL_NODE && (!isValidRef(child)
+                    || (!isTermNode(child) && middleNodes[child].cell.lvl <= node.cell.lvl))) {
+                throw std::runtime_error("broken child link in the snapshot");
+            }
+        }
+        NodeRef link = node.linkToMoreDetailed;
+        if (link != NULL_NODE && (isTermNode(link) || link >= header->middleCount || link <= i)) {
+            throw std::runtime_error("broken link to a more detailed level in the snapshot");
+        }
+    }
+}
+
+template<class Scalar>
+bool SkipQuadTreeSnapshotT<Scalar>::isValidRef(NodeRef node) const {
+    return isTermNode(node) ? (node & ~TERM_NODE_BIT) < header->termCount : node < header->middleCount;
+}
+
+template<class Scalar>
+MiddleNode const &SkipQuadTreeSnapshotT<Scalar>::middle(NodeRef node) const {
+    assert (!isTermNode(node) && node < header->middleCount);
+    return middleNodes[node];
+}
+
+template<class Scalar>
+typename SkipQuadTreeSnapshotT<Scalar>::TermNode const &SkipQuadTreeSnapshotT<Scalar>::term(NodeRef node) const {
+    assert (isTermNode(node) && (node & ~TERM_NODE_BIT) < header->termCount);
+    return termNodes[node & ~TERM_NODE_BIT];
+}
+
+template<class Scalar>
+NodeRef SkipQuadTreeSnapshotT<Scalar>::childOf(MiddleNode const &node, int i) {
+    return node.children[i];
+}
+
+template<class Scalar>
+NodeRef SkipQuadTreeSnapshotT<Scalar>::moreDetailedOf(MiddleNode const &node) {
+    return node.linkToMoreDetailed;
+}
+
+template<class Scalar>
+int SkipQuadTreeSnapshotT<Scalar>::nodeId(NodeRef node) const {
+    return node & ~TERM_NODE_BIT;
+}
+
+template<class Scalar>
+std::list<std::pair<int, cg::point_2t<Scalar>>> SkipQuadTreeSnapshotT<Scalar>::getContainWithId(Range range,
+        Scalar eps) const {
+    std::list<std::pair<int, Point>> res;
+    forEachInRange(range, eps, [&res](int id, Point point) {
+        res.push_back(std::make_pair(id, point));
+    });
+    return res;
+}
+
+template<class Scalar>
+std::list<cg::point_2t<Scalar>> SkipQuadTreeSnapshotT<Scalar>::getContain(Point p1, Point p2, Scalar eps) const {
+    Range rect(-239,
+            std::min(p1.x, p2.x), std::max(p1.x, p2.x),
+            std::min(p1.y, p2.y), std::max(p1.y, p2.y));
+    return getContain(rect, eps);
+}
+
+template<class Scalar>
+std::list<cg::point_2t<Scalar>> SkipQuadTreeSnapshotT<Scalar>::getContain(Range range, Scalar eps) const {
+    std::list<Point> res;
+    queryInto(range, eps, std::back_inserter(res));
+    return res;
+}
+
+template<class Scalar>
+template<class Visitor>
+void SkipQuadTreeSnapshotT<Scalar>::forEachInRange(Range range, Scalar eps, Visitor visitor) const {
+    if (header->lowDetailedRoot != NULL_NODE) {
+        Levels::visitInRange(*this, header->lowDetailedRoot, RangeQuery<Scalar>(range, eps), visitor);
+    }
+}
+
+template<class Scalar>
+template<class OutputIt>
+OutputIt SkipQuadTreeSnapshotT<Scalar>::queryInto(Range range, Scalar eps, OutputIt out) const {
+    forEachInRange(range, eps, [&out](int, Point point) {
+        *out++ = point;
+    });
+    return out;
+}
+
+template<class Scalar>
+size_t SkipQuadTreeSnapshotT<Scalar>::countInRange(Range range, Scalar eps) const {
+    size_t count = 0;
+    forEachInRange(range, eps, [&count](int, Point) {
+        count++;
+    });
+    return count;
+}
+
+template<class Scalar>
+int SkipQuadTreeSnapshotT<Scalar>::skipLevels() const {
+    return header->skipLevels;
+}
+
+template<class Scalar>
+size_t SkipQuadTreeSnapshotT<Scalar>::nodesCount() const {
+    return header->middleCount + header->termCount;
+}
+// SkipQuadTreeSnapshot implementation END
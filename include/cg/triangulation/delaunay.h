@@ -0,0 +1,606 @@
+#pragma once
+
+#include <algorithm>
+#include <vector>
+#include <cstdint>
+#include <random>
+#include <deque>
+#include <cmath>
+#include <cg/primitives/point.h>
+#include <cg/operations/orientation.h>
+#include <cg/operations/incircle.h>
+#include <cg/triangulation/triangulation.h>
+
+namespace cg {
+   namespace detail {
+      // position of (x, y) along the Hilbert curve over the 2^16 by 2^16 grid
+      inline uint32_t hilbert_index(uint32_t x, uint32_t y) {
+         const uint32_t n = 1u << 16;
+         uint32_t d = 0;
+         for (uint32_t s = n / 2; s > 0; s /= 2) {
+            uint32_t rx = (x & s) ? 1 : 0;
+            uint32_t ry = (y & s) ? 1 : 0;
+            d += s * s * ((3 * rx) ^ ry);
+            if (ry == 0) {
+               if (rx == 1) {
+                  x = n - 1 - x;
+                  y = n - 1 - y;
+               }
+               std::swap(x, y);
+            }
+         }
+         return d;
+      }
+
+      // Biased randomized insertion order: the points shuffled and cut into rounds, each twice as large
+      // as the one before it, the points of a round sorted along the Hilbert curve over their bounding box.
+      // rounds gets the position where each round begins.
+      inline void brio_order(const std::vector<point_2> &points, std::vector<uint32_t> &order,
+            std::vector<size_t> &rounds, std::mt19937 &gen) {
+         size_t n = points.size();
+         order.resize(n);
+         rounds.clear();
+         if (n == 0) return;
+         double min_x = points[0].x, max_x = min_x, min_y = points[0].y, max_y = min_y;
+         for (const point_2 &p : points) {
+            min_x = std::min(min_x, p.x);
+            max_x = std::max(max_x, p.x);
+            min_y = std::min(min_y, p.y);
+            max_y = std::max(max_y, p.y);
+         }
+         double size = std::max(max_x - min_x, max_y - min_y);
+         double scale = size > 0 ? 65535 / size : 0;
+
+         // the Hilbert index in the high half, the point in the low one
+         std::vector<uint64_t> keys(n);
+         for (uint32_t i = 0; i < n; i++) {
+            const point_2 &p = points[i];
+            keys[i] = uint64_t(hilbert_index(uint32_t((p.x - min_x) * scale), uint32_t((p.y - min_y) * scale))) << 32 | i;
+         }
+         std::shuffle(keys.begin(), keys.end(), gen);
+         for (size_t end = n; end > 0;) {
+            size_t begin = end > 64 ? end / 2 : 0;
+            std::sort(keys.begin() + begin, keys.begin() + end);
+            rounds.push_back(begin);
+            end = begin;
+         }
+         std::reverse(rounds.begin(), rounds.end());
+         for (size_t i = 0; i < n; i++) order[i] = uint32_t(keys[i]);
+      }
+   }
+
+   // Delaunay triangulation of a point set by randomized incremental insertion in BRIO order.
+   // A point is located by a walk from the vertex inserted last, which is near along the Hilbert curve;
+   // the first point of a round jumps to the nearest of about k^(1/3) random inserted vertices first.
+   // The triangles whose circumcircles contain the point are replaced by a fan around it. The hull edges
+   // have triangles on an infinite vertex outside, so points beyond the hull are inserted the same way.
+   struct delaunay_triangulator {
+      // vertices are the indices of the points, a repeated point is used once;
+      // collinear points give no triangles
+      void triangulate_into(const std::vector<point_2> &points, indexed_triangles &out) {
+         out.clear();
+         points_ = &points;
+         infinite_ = uint32_t(points.size());
+         tv_.clear();
+         tn_.clear();
+         free_.clear();
+         mark_.clear();
+         stamp_ = 0;
+         inserted_.clear();
+         vertex_triangle_.assign(points.size() + 1, uint32_t(none));
+         slot_.assign(points.size() + 1, uint32_t(none));
+         gen_.seed(std::mt19937::default_seed);
+         detail::brio_order(points, order_, rounds_, gen_);
+         if (!start()) return;
+
+         size_t triangles = 2 * points.size() + 2;
+         tv_.reserve(3 * triangles);
+         tn_.reserve(3 * triangles);
+         mark_.reserve(triangles);
+         auto round = rounds_.begin();
+         for (size_t i = 3; i < order_.size(); i++) {
+            bool jump = false;
+            while (round != rounds_.end() && *round <= i) {
+               jump = true;
+               ++round;
+            }
+            if (insert(order_[i], jump)) inserted_.push_back(order_[i]);
+         }
+
+         // finite triangles numbered again without the free ones
+         std::vector<uint32_t> &number = mark_;
+         uint32_t finite = 0;
+         for (uint32_t t = 0; t < number.size(); t++) {
+            number[t] = tv_[3 * t] == none || infinite(t) ? uint32_t(none) : finite++;
+         }
+         out.vertices.reserve(3 * finite);
+         out.neighbours.reserve(3 * finite);
+         for (uint32_t t = 0; t < number.size(); t++) {
+            if (number[t] == none) continue;
+            for (uint32_t k = 0; k < 3; k++) {
+               out.vertices.push_back(tv_[3 * t + k]);
+               out.neighbours.push_back(number[tn_[3 * t + k]]);
+            }
+         }
+      }
+
+   private:
+      static const uint32_t none = uint32_t(-1);
+
+      struct boundary_edge {
+         uint32_t from, to, outer, triangle;
+      };
+
+      const point_2 & point(uint32_t v) const {
+         return (*points_)[v];
+      }
+
+      // position of the infinite vertex in the triangle, 3 if it is finite
+      uint32_t infinite_index(uint32_t t) const {
+         for (uint32_t k = 0; k < 3; k++) {
+            if (tv_[3 * t + k] == infinite_) return k;
+         }
+         return 3;
+      }
+
+      bool infinite(uint32_t t) const {
+         return infinite_index(t) != 3;
+      }
+
+      // the circumcircle of a finite triangle contains p; for an infinite one p is beyond its hull edge
+      // or inside that edge
+      bool conflict(uint32_t t, const point_2 &p) const {
+         const uint32_t *v = &tv_[3 * t];
+         uint32_t k = infinite_index(t);
+         if (k == 3) return incircle(point(v[0]), point(v[1]), point(v[2]), p) == CG_INSIDE;
+         const point_2 &a = point(v[(k + 1) % 3]), &b = point(v[(k + 2) % 3]);
+         orientation_t o = orientation(a, b, p);
+         return o == CG_LEFT || (o == CG_COLLINEAR && p != a && p != b && collinear_are_ordered_along_line(a, p, b));
+      }
+
+      uint32_t new_triangle(uint32_t a, uint32_t b, uint32_t c) {
+         uint32_t t;
+         if (free_.empty()) {
+            t = uint32_t(mark_.size());
+            tv_.resize(tv_.size() + 3);
+            tn_.resize(tn_.size() + 3, uint32_t(none));
+            mark_.push_back(0);
+         } else {
+            t = free_.back();
+            free_.pop_back();
+         }
+         tv_[3 * t] = a;
+         tv_[3 * t + 1] = b;
+         tv_[3 * t + 2] = c;
+         vertex_triangle_[a] = vertex_triangle_[b] = vertex_triangle_[c] = t;
+         return t;
+      }
+
+      void link(uint32_t t, uint32_t side, uint32_t u, uint32_t u_side) {
+         tn_[3 * t + side] = u;
+         tn_[3 * u + u_side] = t;
+      }
+
+      // the first triangle with its infinite neighbours, from the first three points of the order
+      // that are not collinear; false if there are none
+      bool start() {
+         if (order_.size() < 3) return false;
+         size_t b = 1, c;
+         while (b < order_.size() && point(order_[b]) == point(order_[0])) b++;
+         for (c = b + 1; c < order_.size(); c++) {
+            if (orientation(point(order_[0]), point(order_[b]), point(order_[c])) != CG_COLLINEAR) break;
+         }
+         if (c >= order_.size()) return false;
+         uint32_t vb = order_[b], vc = order_[c];
+         order_.erase(order_.begin() + c);
+         order_.erase(order_.begin() + b);
+         order_.insert(order_.begin() + 1, {vb, vc});
+
+         uint32_t v[3] = {order_[0], order_[1], order_[2]};
+         if (orientation(point(v[0]), point(v[1]), point(v[2])) == CG_RIGHT) std::swap(v[1], v[2]);
+         uint32_t t = new_triangle(v[0], v[1], v[2]);
+         uint32_t i0 = new_triangle(v[1], v[0], infinite_);
+         uint32_t i1 = new_triangle(v[2], v[1], infinite_);
+         uint32_t i2 = new_triangle(v[0], v[2], infinite_);
+         link(t, 0, i0, 0);
+         link(t, 1, i1, 0);
+         link(t, 2, i2, 0);
+         link(i0, 1, i2, 2);
+         link(i0, 2, i1, 1);
+         link(i1, 2, i2, 1);
+         inserted_.assign(v, v + 3);
+         return true;
+      }
+
+      // a triangle in conflict with p, or a finite one with p at its vertex
+      uint32_t locate(const point_2 &p, bool jump) {
+         uint32_t start = inserted_.back();
+         double best = (point(start) - p) * (point(start) - p);
+         std::uniform_int_distribution<size_t> sample(0, inserted_.size() - 1);
+         size_t samples = jump ? size_t(std::cbrt(double(inserted_.size()))) : 0;
+         for (size_t i = 0; i < samples; i++) {
+            uint32_t v = inserted_[sample(gen_)];
+            double dist = (point(v) - p) * (point(v) - p);
+            if (dist < best) {
+               best = dist;
+               start = v;
+            }
+         }
+
+         uint32_t t = vertex_triangle_[start], from = none;
+         for (uint32_t step = 0;; step++) {
+            const uint32_t *v = &tv_[3 * t];
+            uint32_t k = infinite_index(t);
+            if (k != 3) {
+               if (conflict(t, p)) return t;
+               from = t;
+               t = tn_[3 * t + (k + 1) % 3];
+               continue;
+            }
+            uint32_t next = none;
+            for (uint32_t i = 0; i < 3; i++) {
+               uint32_t side = (step + i) % 3;
+               uint32_t u = tn_[3 * t + side];
+               if (u != from && orientation(point(v[side]), point(v[(side + 1) % 3]), p) == CG_RIGHT) {
+                  next = u;
+                  break;
+               }
+            }
+            if (next == none) return t;
+            from = t;
+            t = next;
+         }
+      }
+
+      // false for a repeated point
+      bool insert(uint32_t vertex, bool jump) {
+         const point_2 &p = point(vertex);
+         uint32_t t = locate(p, jump);
+         if (!infinite(t)) {
+            for (uint32_t k = 0; k < 3; k++) {
+               if (point(tv_[3 * t + k]) == p) return false;
+            }
+         }
+
+         stamp_++;
+         cavity_.assign(1, t);
+         mark_[t] = stamp_;
+         boundary_.clear();
+         for (size_t i = 0; i < cavity_.size(); i++) {
+            uint32_t s = cavity_[i];
+            for (uint32_t k = 0; k < 3; k++) {
+               uint32_t u = tn_[3 * s + k];
+               if (mark_[u] == stamp_) continue;
+               if (conflict(u, p)) {
+                  mark_[u] = stamp_;
+                  cavity_.push_back(u);
+               } else {
+                  boundary_.push_back(boundary_edge {tv_[3 * s + k], tv_[3 * s + (k + 1) % 3], u, none});
+               }
+            }
+         }
+         for (uint32_t s : cavity_) {
+            tv_[3 * s] = none;
+            free_.push_back(s);
+         }
+
+         // a fan of triangles on the boundary edges, the one on an edge from a vertex is in slot_ of that vertex
+         for (boundary_edge &e : boundary_) {
+            uint32_t n = new_triangle(e.from, e.to, vertex);
+            e.triangle = n;
+            tn_[3 * n] = e.outer;
+            uint32_t *outer = &tv_[3 * e.outer];
+            for (uint32_t k = 0; k < 3; k++) {
+               if (outer[k] == e.to && outer[(k + 1) % 3] == e.from) tn_[3 * e.outer + k] = n;
+            }
+            slot_[e.from] = n;
+         }
+         for (const boundary_edge &e : boundary_) link(e.triangle, 1, slot_[e.to], 2);
+         return true;
+      }
+
+      const std::vector<point_2> *points_;
+      uint32_t infinite_;
+      std::vector<uint32_t> order_;
+      std::vector<size_t> rounds_;
+      std::vector<uint32_t> inserted_;
+      std::vector<uint32_t> tv_;
+      std::vector<uint32_t> tn_;
+      std::vector<uint32_t> free_;
+      std::vector<uint32_t> mark_;
+      uint32_t stamp_;
+      std::vector<uint32_t> vertex_triangle_;
+      std::vector<uint32_t> slot_;
+      std::vector<uint32_t> cavity_;
+      std::vector<boundary_edge> boundary_;
+      std::mt19937 gen_;
+   };
+
+   inline void delaunay_triangulate(const std::vector<point_2> &points, indexed_triangles &out) {
+      delaunay_triangulator().triangulate_into(points, out);
+   }
+
+   namespace detail {
+      // A triangulation in indexed_triangles with constrained edges, which are never flipped. An edge is
+      // made constrained by flipping away the edges crossing it, the flips that follow keep every edge
+      // that is not constrained locally Delaunay.
+      struct constrained_triangulation {
+         static const uint32_t none = indexed_triangles::none;
+
+         constrained_triangulation(const std::vector<point_2> &points, indexed_triangles &out)
+            : points_(points), tv_(out.vertices), tn_(out.neighbours), constrained_(out.vertices.size(), false),
+              vertex_triangle_(points.size(), uint32_t(none)) {
+            for (uint32_t i = 0; i < tv_.size(); i++) vertex_triangle_[tv_[i]] = i / 3;
+         }
+
+         // makes the segment between vertices u and w an edge, through the vertices lying on it
+         void insert(uint32_t u, uint32_t w) {
+            while (u != w) {
+               uint32_t end = cross(u, w);
+               recover(u, end);
+               u = end;
+            }
+         }
+
+         // Keeps the triangles inside an odd number of the constrained contours, renumbered in their order.
+         // Sides towards a removed triangle get no neighbour.
+         void remove_outside() {
+            uint32_t count = tv_.size() / 3;
+            // the number of constrained edges between a triangle and the outside, by a 0-1 breadth-first search
+            std::vector<uint32_t> depth(count, uint32_t(none));
+            std::deque<uint32_t> queue;
+            for (uint32_t i = 0; i < tn_.size(); i++) {
+               if (tn_[i] != none) continue;
+               uint32_t d = constrained_[i] ? 1 : 0;
+               if (d < depth[i / 3]) {
+                  depth[i / 3] = d;
+                  if (d == 0) queue.push_front(i / 3);
+                  else queue.push_back(i / 3);
+               }
+            }
+            while (!queue.empty()) {
+               uint32_t t = queue.front();
+               queue.pop_front();
+               for (uint32_t k = 0; k < 3; k++) {
+                  uint32_t n = tn_[3 * t + k];
+                  if (n == none) continue;
+                  uint32_t d = depth[t] + (constrained_[3 * t + k] ? 1 : 0);
+                  if (d < depth[n]) {
+                     depth[n] = d;
+                     if (d == depth[t]) queue.push_front(n);
+                     else queue.push_back(n);
+                  }
+               }
+            }
+
+            std::vector<uint32_t> number(count, uint32_t(none));
+            uint32_t kept = 0;
+            for (uint32_t t = 0; t < count; t++) {
+               if (depth[t] % 2 == 1) number[t] = kept++;
+            }
+            for (uint32_t t = 0; t < count; t++) {
+               if (number[t] == none) continue;
+               for (uint32_t k = 0; k < 3; k++) {
+                  uint32_t n = tn_[3 * t + k];
+                  tv_[3 * number[t] + k] = tv_[3 * t + k];
+                  tn_[3 * number[t] + k] = n == none ? uint32_t(none) : number[n];
+               }
+            }
+            tv_.resize(3 * kept);
+            tn_.resize(3 * kept);
+         }
+
+      private:
+         typedef std::pair<uint32_t, uint32_t> edge_t;
+
+         uint32_t index(uint32_t t, uint32_t v) const {
+            return tv_[3 * t] == v ? 0 : (tv_[3 * t + 1] == v ? 1 : 2);
+         }
+
+         // the next triangle around vertex i of t, counterclockwise over the side coming to it or clockwise
+         // over the side leaving it
+         uint32_t rotate(uint32_t t, uint32_t i, bool ccw) const {
+            return tn_[3 * t + (ccw ? (i + 2) % 3 : i)];
+         }
+
+         // the triangle and side going from vertex a to vertex b, none if there is no such edge
+         edge_t find(uint32_t a, uint32_t b) const {
+            uint32_t start = vertex_triangle_[a];
+            for (bool ccw : {true, false}) {
+               uint32_t t = start;
+               do {
+                  uint32_t i = index(t, a);
+                  if (tv_[3 * t + (i + 1) % 3] == b) return edge_t(t, i);
+                  t = rotate(t, i, ccw);
+               } while (t != none && t != start);
+            }
+            return edge_t(none, 0);
+         }
+
+         // Collects in crossing_ the edges crossed by the segment from u towards w, each going from its right
+         // to its left, and returns the first vertex on the segment where they end.
+         uint32_t cross(uint32_t u, uint32_t w) {
+            crossing_.clear();
+            const point_2 &pu = points_[u], &pw = points_[w];
+            uint32_t start = vertex_triangle_[u], t = start, x = none, y = none;
+            for (bool ccw : {true, false}) {
+               t = start;
+               do {
+                  uint32_t i = index(t, u);
+                  uint32_t a = tv_[3 * t + (i + 1) % 3], b = tv_[3 * t + (i + 2) % 3];
+                  if (a == w || b == w) return w;
+                  orientation_t oa = orientation(pu, points_[a], pw), ob = orientation(pu, points_[b], pw);
+                  if (oa == CG_COLLINEAR && (points_[a] - pu) * (pw - pu) > 0) return a;
+                  if (ob == CG_COLLINEAR && (points_[b] - pu) * (pw - pu) > 0) return b;
+                  if (oa == CG_LEFT && ob == CG_RIGHT) {
+                     x = a;
+                     y = b;
+                     break;
+                  }
+                  t = rotate(t, i, ccw);
+               } while (t != none && t != start);
+               if (x != none) break;
+            }
+            for (;;) {
+               crossing_.push_back(edge_t(x, y));
+               uint32_t n = tn_[3 * t + index(t, x)];
+               uint32_t z = tv_[3 * n + (index(n, x) + 1) % 3];
+               if (z == w) return w;
+               orientation_t o = orientation(pu, pw, points_[z]);
+               if (o == CG_COLLINEAR) return z;
+               if (o == CG_RIGHT) x = z;
+               else y = z;
+               t = n;
+            }
+         }
+
+         // flips the edges of crossing_ until u and w are joined, then legalizes the new edges
+         void recover(uint32_t u, uint32_t w) {
+            const point_2 &pu = points_[u], &pw = points_[w];
+            stack_.clear();
+            for (size_t i = 0; i < crossing_.size(); i++) {
+               uint32_t x = crossing_[i].first, y = crossing_[i].second;
+               edge_t e = find(x, y);
+               uint32_t n = tn_[3 * e.first + e.second];
+               uint32_t a = tv_[3 * e.first + (e.second + 2) % 3];
+               uint32_t b = tv_[3 * n + (index(n, x) + 1) % 3];
+               if (!opposite(orientation(points_[a], points_[b], points_[x]), orientation(points_[a], points_[b], points_[y]))) {
+                  // not a convex quadrilateral yet, comes back after the flips around it
+                  crossing_.push_back(crossing_[i]);
+                  continue;
+               }
+               flip(e.first, e.second);
+               orientation_t oa = orientation(pu, pw, points_[a]);
+               if (opposite(oa, orientation(pu, pw, points_[b]))
+                   && opposite(orientation(points_[a], points_[b], pu), orientation(points_[a], points_[b], pw))) {
+                  crossing_.push_back(oa == CG_RIGHT ? edge_t(a, b) : edge_t(b, a));
+               } else {
+                  stack_.push_back(edge_t(a, b));
+               }
+            }
+            edge_t e = find(u, w);
+            constrained_[3 * e.first + e.second] = true;
+            uint32_t n = tn_[3 * e.first + e.second];
+            if (n != none) constrained_[3 * n + index(n, w)] = true;
+            legalize();
+         }
+
+         // Flips the edges on stack_ and the edges around them while they are not locally Delaunay. Edges
+         // are kept as vertex pairs, as flips rewrite the triangles, and an edge flipped away meanwhile is skipped.
+         void legalize() {
+            while (!stack_.empty()) {
+               edge_t e = find(stack_.back().first, stack_.back().second);
+               stack_.pop_back();
+               uint32_t a = e.first, k = e.second;
+               if (a == none) continue;
+               uint32_t b = tn_[3 * a + k];
+               if (b == none || constrained_[3 * a + k]) continue;
+               uint32_t p0 = tv_[3 * a + k], p1 = tv_[3 * a + (k + 1) % 3], p2 = tv_[3 * a + (k + 2) % 3];
+               uint32_t q = tv_[3 * b + (index(b, p1) + 2) % 3];
+               if (incircle(points_[p0], points_[p1], points_[p2], points_[q]) != CG_INSIDE) continue;
+               flip(a, k);
+               stack_.push_back(edge_t(p0, q));
+               stack_.push_back(edge_t(p2, p0));
+               stack_.push_back(edge_t(q, p1));
+               stack_.push_back(edge_t(p1, p2));
+            }
+         }
+
+         // Side k of triangle a goes from p0 to p1 and triangle b across it has vertex q, the quadrilateral
+         // p0, q, p1, p2 is strictly convex. Makes a into (p0, q, p2) and b into (q, p1, p2).
+         void flip(uint32_t a, uint32_t k) {
+            uint32_t b = tn_[3 * a + k];
+            uint32_t p0 = tv_[3 * a + k], p1 = tv_[3 * a + (k + 1) % 3], p2 = tv_[3 * a + (k + 2) % 3];
+            uint32_t j = index(b, p1);
+            uint32_t q = tv_[3 * b + (j + 2) % 3];
+            // the outer sides p1 p2, p2 p0, p0 q and q p1
+            uint32_t n12 = tn_[3 * a + (k + 1) % 3], n20 = tn_[3 * a + (k + 2) % 3];
+            uint32_t n0q = tn_[3 * b + (j + 1) % 3], nq1 = tn_[3 * b + (j + 2) % 3];
+            bool c12 = constrained_[3 * a + (k + 1) % 3], c20 = constrained_[3 * a + (k + 2) % 3];
+            bool c0q = constrained_[3 * b + (j + 1) % 3], cq1 = constrained_[3 * b + (j + 2) % 3];
+            set(a, p0, q, p2, n0q, b, n20);
+            set(b, q, p1, p2, nq1, n12, a);
+            constrained_[3 * a] = c0q;
+            constrained_[3 * a + 1] = false;
+            constrained_[3 * a + 2] = c20;
+            constrained_[3 * b] = cq1;
+            constrained_[3 * b + 1] = c12;
+            constrained_[3 * b + 2] = false;
+            if (n12 != none) tn_[3 * n12 + index(n12, p2)] = b;
+            if (n0q != none) tn_[3 * n0q + index(n0q, q)] = a;
+            vertex_triangle_[p0] = vertex_triangle_[p2] = a;
+            vertex_triangle_[p1] = vertex_triangle_[q] = b;
+         }
+
+         void set(uint32_t t, uint32_t a, uint32_t b, uint32_t c, uint32_t ab, uint32_t bc, uint32_t ca) {
+            tv_[3 * t] = a;
+            tv_[3 * t + 1] = b;
+            tv_[3 * t + 2] = c;
+            tn_[3 * t] = ab;
+            tn_[3 * t + 1] = bc;
+            tn_[3 * t + 2] = ca;
+         }
+
+         const std::vector<point_2> &points_;
+         std::vector<uint32_t> &tv_;
+         std::vector<uint32_t> &tn_;
+         std::vector<bool> constrained_;
+         std::vector<uint32_t> vertex_triangle_;
+         std::vector<edge_t> crossing_;
+         std::vector<edge_t> stack_;
+      };
+   }
+
+   // Constrained Delaunay triangulation of a polygon with holes: the Delaunay triangulation of its
+   // vertices with the polygon edges recovered by flips, restricted to the inside of the polygon.
+   // The vertices index points, which are the contours one after another, and sides on the boundary
+   // of the polygon have no neighbour. A repeated vertex is referred to by one of its indices.
+   inline void constrained_delaunay_triangulate(const std::vector<contour_2> &polygon, indexed_triangles &out,
+                                                std::vector<point_2> &points) {
+      points.clear();
+      for (const contour_2 &c : polygon) points.insert(points.end(), c.begin(), c.end());
+      delaunay_triangulate(points, out);
+      if (out.size() == 0) return;
+
+      std::vector<uint32_t> id(points.size());
+      std::vector<bool> used(points.size(), false);
+      for (uint32_t v : out.vertices) used[v] = true;
+      for (uint32_t i = 0; i < id.size(); i++) id[i] = i;
+      if (std::count(used.begin(), used.end(), true) < std::ptrdiff_t(points.size())) {
+         std::vector<uint32_t> order(id);
+         std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return points[a] < points[b]; });
+         for (size_t i = 0, j; i < order.size(); i = j) {
+            uint32_t kept = order[i];
+            for (j = i; j < order.size() && points[order[j]] == points[order[i]]; j++) {
+               if (used[order[j]]) kept = order[j];
+            }
+            for (size_t k = i; k < j; k++) id[order[k]] = kept;
+         }
+      }
+
+      detail::constrained_triangulation t(points, out);
+      size_t first = 0;
+      for (const contour_2 &c : polygon) {
+         for (size_t i = 0; i < c.size(); i++) t.insert(id[first + i], id[first + (i + 1) % c.size()]);
+         first += c.size();
+      }
+      t.remove_outside();
+   }
+
+   inline void constrained_delaunay_triangulate(const std::vector<contour_2> &polygon, indexed_triangles &out) {
+      std::vector<point_2> points;
+      constrained_delaunay_triangulate(polygon, out, points);
+   }
+
+   inline std::vector<triangle_2> constrained_delaunay_triangulate(const std::vector<contour_2> &polygon) {
+      std::vector<point_2> points;
+      indexed_triangles t;
+      constrained_delaunay_triangulate(polygon, t, points);
+      std::vector<triangle_2> res;
+      res.reserve(t.size());
+      for (size_t i = 0; i < t.size(); i++) {
+         res.push_back(triangle_2(points[t.vertices[3 * i]], points[t.vertices[3 * i + 1]], points[t.vertices[3 * i + 2]]));
+      }
+      return res;
+   }
+}
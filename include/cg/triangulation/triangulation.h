@@ -2,173 +2,667 @@
 
 #include <algorithm>
 #include <vector>
-#include <map>
-#include <memory>
+#include <cstdint>
+#include <future>
 #include <cg/primitives/point.h>
 #include <cg/primitives/contour.h>
 #include <cg/primitives/triangle.h>
 #include <cg/primitives/segment.h>
 #include <cg/operations/orientation.h>
+#include <cg/structures/half_edge_mesh.h>
 
 namespace cg {
    enum v_type {SPLIT, MERGE, LEFT_REGULAR, RIGHT_REGULAR, START, END};
 
-   v_type vertex_type(const contour_2::circulator_t &c) {
-      auto cur = *c;
-      auto prev = *(c - 1);
-      auto next = *(c + 1);
-
+   inline v_type vertex_type(const point_2 &prev, const point_2 &cur, const point_2 &next) {
       bool right = orientation(prev, cur, next) == CG_RIGHT;
       if (cur > prev && cur > next) return right ? SPLIT : START;
       if (cur < prev && cur < next) return right ? MERGE : END;
       return next > cur ? RIGHT_REGULAR : LEFT_REGULAR;
    }
 
-   struct monotone_chain {
-      bool left;
-      std::vector<point_2> v;
-      monotone_chain() {}
+   inline v_type vertex_type(const contour_2::circulator_t &c) {
+      return vertex_type(*(c - 1), *c, *(c + 1));
+   }
+
+   // Triangles by the indices of their vertices, the vertices of the contours numbered one after another.
+   // Triangle t is vertices[3 * t] to vertices[3 * t + 2] in counterclockwise order, neighbours[3 * t + k]
+   // is the triangle across its side from vertex k to vertex k + 1, none on the border of the polygon.
+   struct indexed_triangles {
+      typedef uint32_t index_t;
+      static const index_t none = index_t(-1);
 
-      monotone_chain(const segment_2 &s1, bool left) : left(left) {
-         v.push_back(s1[0]);
-         v.push_back(s1[1]);
+      std::vector<index_t> vertices;
+      std::vector<index_t> neighbours;
+
+      size_t size() const {
+         return vertices.size() / 3;
+      }
+
+      void clear() {
+         vertices.clear();
+         neighbours.clear();
       }
    };
 
-   void add(std::vector<triangle_2> &result, std::vector<std::shared_ptr<monotone_chain>> &chains,
-         const segment_2 &s1, bool left = false) {
-      if (chains.size() == 0) {
-         chains.push_back(std::shared_ptr<monotone_chain>(new monotone_chain(s1, left)));
-         return;
-      }
-      for (auto &chain : chains) {
-         auto &v = chain->v;
-         auto &p1 = s1[1];
-         if (v.size() == 2 && s1[0] == v[0] && s1[1] == v[1]) continue;
-         if (s1[0] == v[0]) {
-            //other side
-            for (size_t i = 0; i < v.size() - 1; i++) {
-               result.push_back(triangle_2(p1, v[i + 1], v[i]));
-            }
-            v.erase(v.begin(), v.end() - 1);
-            v.push_back(p1);
-            chain->left ^= 1;
-         } else if (s1[0] == v.back()) {
-            //same side
-            orientation_t need = chain->left ? CG_RIGHT : CG_LEFT;
-            while (v.size() > 1 && orientation(p1, v[v.size() - 1], v[v.size() - 2]) == need) {
-               result.push_back(triangle_2(p1, v[v.size() - 1], v[v.size() - 2]));
-               v.pop_back();
-            }
-            v.push_back(p1);
+   namespace detail {
+      // Monotone chains of the sweep in one pool. Status entries refer to them by index and count the references,
+      // a chain no entry refers to after a vertex is done goes back to the pool with its buffer.
+      // A chain holds vertex indices, edges[i] is the id of its edge from v[i] to v[i + 1] (see triangle_sink).
+      struct chain_pool {
+         static const uint32_t none = uint32_t(-1);
+
+         struct chain {
+            bool left;
+            bool free;
+            uint32_t refs;
+            std::vector<uint32_t> v;
+            std::vector<uint32_t> edges;
+         };
+
+         std::vector<chain> chains;
+         std::vector<uint32_t> free_ids;
+         std::vector<uint32_t> unreferenced;
+
+         chain & operator [] (uint32_t id) {
+            return chains[id];
          }
-      }
-   }
 
-   std::vector<triangle_2> triangulate(const std::vector<contour_2> &polygon) {
-      std::vector<triangle_2> result;
+         uint32_t create(uint32_t from, uint32_t to, uint32_t edge, bool left) {
+            uint32_t id;
+            if (free_ids.empty()) {
+               id = uint32_t(chains.size());
+               chains.push_back(chain());
+            } else {
+               id = free_ids.back();
+               free_ids.pop_back();
+            }
+            chain &c = chains[id];
+            c.left = left;
+            c.free = false;
+            c.refs = 0;
+            c.v.clear();
+            c.v.push_back(from);
+            c.v.push_back(to);
+            c.edges.clear();
+            c.edges.push_back(edge);
+            unreferenced.push_back(id);
+            return id;
+         }
 
-      std::vector<contour_2::circulator_t> p;
-      for (const contour_2 &c : polygon) {
-         auto start = c.circulator();
-         auto cur = start;
-         do {
-            p.push_back(cur++);
-         } while (cur != start);
-      }
-      std::sort(p.begin(), p.end(),
-      [](const contour_2::circulator_t &c1, const contour_2::circulator_t &c2) { return *c1 > *c2; });
-      auto segment_comp = [](const segment_2 &s1, const segment_2 &s2) {
-               if (s1[0].x < s2[0].x) {
-                  auto res = orientation(s2[0], s2[1], s1[0]);
-                  if (res != CG_COLLINEAR) return res == CG_LEFT;
-               } else if (s2[0].x < s1[0].x) {
-                  auto res = orientation(s1[0], s1[1], s2[0]);
-                  if (res != CG_COLLINEAR) return res == CG_RIGHT;
+         void retain(uint32_t id) {
+            if (id != none) chains[id].refs++;
+         }
+
+         void release(uint32_t id) {
+            if (id != none && --chains[id].refs == 0) unreferenced.push_back(id);
+         }
+
+         // called between vertices, when no chain is held outside the status
+         void collect() {
+            for (uint32_t id : unreferenced) {
+               chain &c = chains[id];
+               if (c.refs == 0 && !c.free) {
+                  c.free = true;
+                  free_ids.push_back(id);
                }
-               if (s1[0] != s2[0]) return s1[0] < s2[0];
-               return s1[1] < s2[1];
-            };
-      typedef std::vector<std::shared_ptr<monotone_chain>> chains_t;
-      std::map<segment_2, std::pair<point_2, std::vector<std::shared_ptr<monotone_chain>>>,
-         decltype(segment_comp)> helper(segment_comp);
-      auto left_cont = [&helper, &result](const segment_2 &prev_edge, const point_2 &p, chains_t &res) {
-               const auto &ej = helper.lower_bound(prev_edge);
-               auto &old_helper = ej->second.first;
-               auto &chains = ej->second.second;
-               segment_2 new_seg(old_helper, p);
-               add(result, chains, prev_edge, true);
-               if (chains.size() == 2) {
-                  add(result, chains, new_seg);
-                  res[res.size() - 1] = chains[1];
-               } else {
-                  res[res.size() - 1] = chains[0];
+            }
+            unreferenced.clear();
+         }
+
+         void clear() {
+            chains.clear();
+            free_ids.clear();
+            unreferenced.clear();
+         }
+      };
+
+      // the chains of a status entry, there are never more than two
+      struct chain_set {
+         uint32_t id[2];
+         uint32_t size;
+
+         explicit chain_set(uint32_t size = 0) : size(size) {
+            id[0] = id[1] = chain_pool::none;
+         }
+
+         void push_back(uint32_t chain) {
+            id[size++] = chain;
+         }
+      };
+
+      // order of the edges crossing the sweep line, from left to right
+      struct segment_less {
+         bool operator () (const segment_2 &s1, const segment_2 &s2) const {
+            if (s1[0].x < s2[0].x) {
+               auto res = orientation(s2[0], s2[1], s1[0]);
+               if (res != CG_COLLINEAR) return res == CG_LEFT;
+            } else if (s2[0].x < s1[0].x) {
+               auto res = orientation(s1[0], s1[1], s2[0]);
+               if (res != CG_COLLINEAR) return res == CG_RIGHT;
+            }
+            if (s1[0] != s2[0]) return s1[0] < s2[0];
+            return s1[1] < s2[1];
+         }
+      };
+
+      struct status_entry {
+         segment_2 edge;
+         uint32_t helper;
+         chain_set chains;
+      };
+
+      // The sweep status: entries ordered by their edges in runs of contiguous memory, a run is split in two
+      // when it grows past 2 * run_size entries. Entries are updated in place and keep the chain references counted.
+      template <class Compare>
+      struct sweep_status {
+         static const size_t run_size = 64;
+
+         struct position {
+            size_t run;
+            size_t index;
+         };
+
+         sweep_status(Compare comp, chain_pool &pool) : comp(comp), pool(pool) {}
+
+         position lower_bound(const segment_2 &edge) const {
+            size_t from = 0, to = runs.size();
+            while (from < to) {
+               size_t mid = (from + to) / 2;
+               if (comp(runs[mid].back().edge, edge)) from = mid + 1;
+               else to = mid;
+            }
+            if (from == runs.size()) return position {from, 0};
+            const std::vector<status_entry> &run = runs[from];
+            auto it = std::lower_bound(run.begin(), run.end(), edge,
+                  [this](const status_entry &e, const segment_2 &s) { return comp(e.edge, s); });
+            return position {from, size_t(it - run.begin())};
+         }
+
+         status_entry & at(position pos) {
+            return runs[pos.run][pos.index];
+         }
+
+         bool equivalent(position pos, const segment_2 &edge) const {
+            return pos.run != runs.size() && !comp(edge, runs[pos.run][pos.index].edge);
+         }
+
+         void assign_at(position pos, uint32_t helper, const chain_set &chains) {
+            status_entry &e = at(pos);
+            for (uint32_t i = 0; i < chains.size; i++) pool.retain(chains.id[i]);
+            for (uint32_t i = 0; i < e.chains.size; i++) pool.release(e.chains.id[i]);
+            e.helper = helper;
+            e.chains = chains;
+         }
+
+         // the new edge takes the place of the old one in the order
+         void replace_at(position pos, const segment_2 &edge, uint32_t helper, const chain_set &chains) {
+            assign_at(pos, helper, chains);
+            at(pos).edge = edge;
+         }
+
+         // like operator [] of a map, an equivalent edge keeps its entry
+         void assign(const segment_2 &edge, uint32_t helper, const chain_set &chains) {
+            position pos = lower_bound(edge);
+            if (equivalent(pos, edge)) {
+               assign_at(pos, helper, chains);
+               return;
+            }
+            status_entry e;
+            e.edge = edge;
+            e.helper = helper;
+            e.chains = chains;
+            for (uint32_t i = 0; i < chains.size; i++) pool.retain(chains.id[i]);
+            if (runs.empty()) runs.push_back(std::vector<status_entry>());
+            if (pos.run == runs.size()) {
+               pos.run--;
+               pos.index = runs[pos.run].size();
+            }
+            std::vector<status_entry> &run = runs[pos.run];
+            run.insert(run.begin() + pos.index, e);
+            if (run.size() > 2 * run_size) {
+               std::vector<status_entry> rest(run.begin() + run_size, run.end());
+               run.resize(run_size);
+               runs.insert(runs.begin() + pos.run + 1, std::move(rest));
+            }
+         }
+
+         void erase(const segment_2 &edge) {
+            position pos = lower_bound(edge);
+            if (!equivalent(pos, edge)) return;
+            std::vector<status_entry> &run = runs[pos.run];
+            for (uint32_t i = 0; i < run[pos.index].chains.size; i++) pool.release(run[pos.index].chains.id[i]);
+            run.erase(run.begin() + pos.index);
+            if (run.empty()) runs.erase(runs.begin() + pos.run);
+         }
+
+         // the entries left by a broken polygon
+         void clear() {
+            for (auto &run : runs) {
+               for (auto &e : run) {
+                  for (uint32_t i = 0; i < e.chains.size; i++) pool.release(e.chains.id[i]);
                }
-               helper[ej->first] = std::make_pair(p, res);
-               helper.erase(prev_edge);
-            };
-      auto right_cont = [&helper, &result](const segment_2 &rev_cur_edge, const point_2 &p, chains_t &res) {
-               segment_2 cur_vertex(p, p);
-               const auto &ej = helper.lower_bound(cur_vertex);
-               auto &old_helper = ej->second.first;
-               auto &chains = ej->second.second;
-               segment_2 new_seg(old_helper, p);
-               add(result, chains, rev_cur_edge, false);
-               res[0] = chains[0];
-               if (chains.size() == 2) add(result, chains, new_seg);
-               helper[ej->first] = std::make_pair(p, res);
-               helper.erase(cur_vertex);
-            };
-      for (auto &c : p) {
-         v_type type = vertex_type(c);
-         segment_2 prev_edge(*(c - 1), *c);
-         segment_2 cur_edge(*c, *(c + 1));
-         segment_2 rev_cur_edge(*(c + 1), *c);
-         segment_2 cur_vertex(*c, *c);
-         if (type == SPLIT) {
-            const auto &ej = helper.lower_bound(cur_vertex);
-            auto &old_helper = ej->second.first;
-            auto &chains = ej->second.second;
-            segment_2 new_seg(old_helper, *c);
-            chains_t new_chains;
-            point_2 new_helper;
-            new_helper = old_helper = *c;
-            add(result, chains, new_seg, false);
-            if (chains.size() == 2) {
-               //merge
-               new_chains.push_back(*(--chains.end()));
-               chains.erase(--chains.end());
-               helper[ej->first] = std::make_pair(old_helper, chains);
-               helper[cur_edge] = std::make_pair(new_helper, new_chains);
-            } else {
-               //ordinary
-               add(result, new_chains, new_seg, !chains[0]->left);
-               if (chains[0]->left) {
-                  helper[cur_edge] = std::make_pair(old_helper, chains);
-                  helper[ej->first] = std::make_pair(new_helper, new_chains);
+            }
+            runs.clear();
+         }
+
+      private:
+         Compare comp;
+         chain_pool &pool;
+         std::vector<std::vector<status_entry>> runs;
+      };
+
+      template <class Compare>
+      const size_t sweep_status<Compare>::run_size;
+
+      // Takes the triangles of the sweep: their points, or their vertex indices with the neighbours.
+      // Every side of a triangle goes over an edge id, the first triangle on an edge waits in edge_sides
+      // for the second one. Sides on the border of the polygon have no id.
+      struct triangle_sink {
+         const std::vector<point_2> *points;
+         std::vector<triangle_2> *triangles;
+         indexed_triangles *indexed;
+         std::vector<uint32_t> edge_sides;
+
+         uint32_t new_edge() {
+            if (!indexed) return chain_pool::none;
+            edge_sides.push_back(uint32_t(indexed_triangles::none));
+            return uint32_t(edge_sides.size() - 1);
+         }
+
+         // the triangle on vertices a, b and c with sides over the edges ab, bc and ca
+         void emit(uint32_t a, uint32_t b, uint32_t c, uint32_t ab, uint32_t bc, uint32_t ca) {
+            const std::vector<point_2> &p = *points;
+            if (!indexed) {
+               triangles->push_back(triangle_2(p[a], p[b], p[c]));
+               return;
+            }
+            if (orientation(p[a], p[b], p[c]) == CG_RIGHT) {
+               std::swap(b, c);
+               std::swap(ab, ca);
+            }
+            uint32_t t = uint32_t(indexed->size());
+            indexed->vertices.push_back(a);
+            indexed->vertices.push_back(b);
+            indexed->vertices.push_back(c);
+            indexed->neighbours.insert(indexed->neighbours.end(), 3, uint32_t(indexed_triangles::none));
+            link(ab, 3 * t);
+            link(bc, 3 * t + 1);
+            link(ca, 3 * t + 2);
+         }
+
+         // two ids turned out to be the same edge, the side waiting on the first one goes to the one kept
+         uint32_t join(uint32_t a, uint32_t b) {
+            if (a == chain_pool::none) return b;
+            if (b == chain_pool::none || a == b) return a;
+            if (edge_sides[a] != indexed_triangles::none) link(b, edge_sides[a]);
+            return b;
+         }
+
+      private:
+         void link(uint32_t edge, uint32_t side) {
+            if (edge == chain_pool::none) return;
+            uint32_t other = edge_sides[edge];
+            if (other == indexed_triangles::none) {
+               edge_sides[edge] = side;
+               return;
+            }
+            indexed->neighbours[side] = other / 3;
+            indexed->neighbours[other] = side / 3;
+         }
+      };
+
+      // the segment from vertex from to vertex to, over the given edge id
+      inline void add(triangle_sink &sink, chain_pool &pool, chain_set &chains,
+            uint32_t from, uint32_t to, uint32_t edge, bool left = false) {
+         if (chains.size == 0) {
+            chains.push_back(pool.create(from, to, edge, left));
+            return;
+         }
+         const std::vector<point_2> &p = *sink.points;
+         for (uint32_t i = 0; i < chains.size; i++) {
+            chain_pool::chain &chain = pool[chains.id[i]];
+            auto &v = chain.v;
+            auto &edges = chain.edges;
+            if (v.size() == 2 && from == v[0] && to == v[1]) {
+               edges[0] = sink.join(edges[0], edge);
+               continue;
+            }
+            if (from == v[0]) {
+               //other side
+               uint32_t side = edge;
+               for (size_t i = 0; i < v.size() - 1; i++) {
+                  uint32_t next = sink.new_edge();
+                  sink.emit(to, v[i + 1], v[i], next, edges[i], side);
+                  side = next;
+               }
+               v.erase(v.begin(), v.end() - 1);
+               v.push_back(to);
+               edges.assign(1, side);
+               chain.left ^= 1;
+            } else if (from == v.back()) {
+               //same side
+               orientation_t need = chain.left ? CG_RIGHT : CG_LEFT;
+               uint32_t side = edge;
+               while (v.size() > 1 && orientation(p[to], p[v[v.size() - 1]], p[v[v.size() - 2]]) == need) {
+                  uint32_t next = sink.new_edge();
+                  sink.emit(to, v[v.size() - 1], v[v.size() - 2], side, edges.back(), next);
+                  side = next;
+                  v.pop_back();
+                  edges.pop_back();
+               }
+               v.push_back(to);
+               edges.push_back(side);
+            }
+         }
+      }
+
+      // add on the chains of a status entry, a chain created for it is referred to by the entry
+      inline void add(triangle_sink &sink, chain_pool &pool, status_entry &entry,
+            uint32_t from, uint32_t to, uint32_t edge, bool left = false) {
+         bool empty = entry.chains.size == 0;
+         add(sink, pool, entry.chains, from, to, edge, left);
+         if (empty) pool.retain(entry.chains.id[0]);
+      }
+   }
+
+   // Triangulates polygons one after another with the same buffers, for batches of small polygons.
+   // A polygon is a counterclockwise outer contour with clockwise holes. A strictly convex contour is cut into a fan,
+   // a contour of at most ear_clipping_size vertices into ears, anything else goes to the monotone sweep.
+   struct triangulator {
+      static const size_t ear_clipping_size = 12;
+
+      triangulator() : status_(detail::segment_less(), pool_) {}
+      triangulator(const triangulator &) = delete;
+      triangulator & operator = (const triangulator &) = delete;
+
+      // appends the triangles of the polygon to out
+      void triangulate_into(const std::vector<contour_2> &polygon, std::vector<triangle_2> &out) {
+         if (polygon.size() == 1) {
+            const contour_2 &c = polygon[0];
+            if (strictly_convex(c)) {
+               for (size_t i = 1; i + 1 < c.size(); i++) out.push_back(triangle_2(c[0], c[i], c[i + 1]));
+               return;
+            }
+            if (c.size() <= ear_clipping_size && ear_clip_into(c, out)) return;
+         }
+         sweep_into(polygon, out);
+      }
+
+      // the monotone sweep alone, the triangles of cg::triangulate
+      void sweep_into(const std::vector<contour_2> &polygon, std::vector<triangle_2> &out) {
+         sink_.triangles = &out;
+         sink_.indexed = nullptr;
+         out.reserve(out.size() + sweep_size(polygon));
+         sweep(polygon);
+      }
+
+      // the same triangles by vertex indices, with their neighbours; out is overwritten
+      void sweep_into(const std::vector<contour_2> &polygon, indexed_triangles &out) {
+         sink_.triangles = nullptr;
+         sink_.indexed = &out;
+         sink_.edge_sides.clear();
+         out.clear();
+         size_t size = sweep_size(polygon);
+         out.vertices.reserve(3 * size);
+         out.neighbours.reserve(3 * size);
+         sweep(polygon);
+      }
+
+   private:
+      typedef detail::chain_set chains_t;
+
+      static size_t sweep_size(const std::vector<contour_2> &polygon) {
+         size_t size = 0;
+         for (const contour_2 &c : polygon) size += c.size() + 2;
+         return size;
+      }
+
+      void sweep(const std::vector<contour_2> &polygon) {
+         points_.clear();
+         prev_.clear();
+         next_.clear();
+         for (const contour_2 &c : polygon) {
+            uint32_t first = uint32_t(points_.size()), n = uint32_t(c.size());
+            for (uint32_t i = 0; i < n; i++) {
+               points_.push_back(c[i]);
+               prev_.push_back(first + (i + n - 1) % n);
+               next_.push_back(first + (i + 1) % n);
+            }
+         }
+         sink_.points = &points_;
+         order_.resize(points_.size());
+         for (uint32_t v = 0; v < order_.size(); v++) order_[v] = v;
+         std::sort(order_.begin(), order_.end(), [this](uint32_t v1, uint32_t v2) { return points_[v1] > points_[v2]; });
+         for (uint32_t v : order_) {
+            const point_2 &p = points_[v];
+            v_type type = vertex_type(points_[prev_[v]], p, points_[next_[v]]);
+            segment_2 cur_edge(p, points_[next_[v]]);
+            segment_2 cur_vertex(p, p);
+            if (type == SPLIT) {
+               auto ej = status_.lower_bound(cur_vertex);
+               detail::status_entry &e = status_.at(ej);
+               uint32_t helper = e.helper, diagonal = sink_.new_edge();
+               e.helper = v;
+               detail::add(sink_, pool_, e, helper, v, diagonal, false);
+               chains_t new_chains;
+               if (e.chains.size == 2) {
+                  //merge
+                  new_chains.push_back(e.chains.id[1]);
+                  e.chains.size = 1;
+                  pool_.release(new_chains.id[0]);
+                  status_.assign(cur_edge, v, new_chains);
                } else {
-                  helper[cur_edge] = std::make_pair(new_helper, new_chains);
-                  helper[ej->first] = std::make_pair(old_helper, chains);
+                  //ordinary
+                  bool left = pool_[e.chains.id[0]].left;
+                  detail::add(sink_, pool_, new_chains, helper, v, diagonal, !left);
+                  if (left) {
+                     chains_t chains = e.chains;
+                     status_.assign_at(ej, v, new_chains);
+                     status_.assign(cur_edge, v, chains);
+                  } else {
+                     status_.assign(cur_edge, v, new_chains);
+                  }
                }
             }
+            chains_t res;
+            if (type == MERGE) res = chains_t(2);
+            else if (type == LEFT_REGULAR || type == RIGHT_REGULAR || type == END) res = chains_t(1);
+
+            if (type == MERGE) {
+               left_cont(v, res, false);
+               right_cont(v, res);
+            }
+            if (type == END) {
+               right_cont(v, res);
+               left_cont(v, res, false);
+            }
+            if (type == LEFT_REGULAR) left_cont(v, res, true);
+            if (type == RIGHT_REGULAR) right_cont(v, res);
+
+            if (type == START) status_.assign(cur_edge, v, res);
+            pool_.collect();
          }
-         chains_t res;
-         if (type == MERGE) res = chains_t(2);
-         else if (type == LEFT_REGULAR || type == RIGHT_REGULAR || type == END) res = chains_t(1);
+         status_.clear();
+         pool_.collect();
+      }
 
-         if (type == MERGE) {
-            left_cont(prev_edge, *c, res);
-            right_cont(rev_cur_edge, *c, res);
+      // the entry of the edge coming to v goes away, or takes the edge going from v
+      void left_cont(uint32_t v, chains_t &res, bool continued) {
+         const point_2 &p = points_[v];
+         segment_2 prev_edge(points_[prev_[v]], p);
+         auto ej = status_.lower_bound(prev_edge);
+         detail::status_entry &e = status_.at(ej);
+         uint32_t helper = e.helper;
+         detail::add(sink_, pool_, e, prev_[v], v, detail::chain_pool::none, true);
+         if (e.chains.size == 2) {
+            detail::add(sink_, pool_, e.chains, helper, v, sink_.new_edge());
+            res.id[res.size - 1] = e.chains.id[1];
+         } else {
+            res.id[res.size - 1] = e.chains.id[0];
          }
-         if (type == END) {
-            right_cont(rev_cur_edge, *c, res);
-            left_cont(prev_edge, *c, res);
+         segment_2 cur_edge(p, points_[next_[v]]);
+         if (!status_.equivalent(ej, prev_edge)) {
+            status_.assign_at(ej, v, res);
+         } else if (continued) {
+            status_.replace_at(ej, cur_edge, v, res);
+            return;
          }
-         if (type == LEFT_REGULAR) left_cont(prev_edge, *c, res);
-         if (type == RIGHT_REGULAR) right_cont(rev_cur_edge, *c, res);
+         status_.erase(prev_edge);
+         if (continued) status_.assign(cur_edge, v, res);
+      }
 
-         if (type == LEFT_REGULAR || type == START) helper[cur_edge] = std::make_pair(*c, res);
+      void right_cont(uint32_t v, chains_t &res) {
+         const point_2 &p = points_[v];
+         segment_2 cur_vertex(p, p);
+         auto ej = status_.lower_bound(cur_vertex);
+         detail::status_entry &e = status_.at(ej);
+         uint32_t helper = e.helper;
+         detail::add(sink_, pool_, e, next_[v], v, detail::chain_pool::none, false);
+         res.id[0] = e.chains.id[0];
+         if (e.chains.size == 2) detail::add(sink_, pool_, e.chains, helper, v, sink_.new_edge());
+         status_.assign_at(ej, v, res);
       }
+
+      static bool strictly_convex(const contour_2 &c) {
+         size_t n = c.size();
+         if (n < 3) return false;
+         for (size_t i = 0; i < n; i++) {
+            if (orientation(c[i], c[(i + 1) % n], c[(i + 2) % n]) != CG_LEFT) return false;
+         }
+         return true;
+      }
+
+      // false, with out as it was, if no ear is left before the last triangle
+      bool ear_clip_into(const contour_2 &c, std::vector<triangle_2> &out) {
+         size_t n = c.size();
+         if (n < 3) return false;
+         size_t was = out.size();
+         prev_.resize(n);
+         next_.resize(n);
+         for (size_t i = 0; i < n; i++) {
+            prev_[i] = (i + n - 1) % n;
+            next_[i] = (i + 1) % n;
+         }
+         size_t i = 0, left = n, misses = 0;
+         while (left > 3) {
+            if (is_ear(c, i)) {
+               out.push_back(triangle_2(c[prev_[i]], c[i], c[next_[i]]));
+               next_[prev_[i]] = next_[i];
+               prev_[next_[i]] = prev_[i];
+               i = prev_[i];
+               left--;
+               misses = 0;
+            } else if (++misses > left) {
+               out.resize(was);
+               return false;
+            } else {
+               i = next_[i];
+            }
+         }
+         if (orientation(c[prev_[i]], c[i], c[next_[i]]) != CG_LEFT) {
+            out.resize(was);
+            return false;
+         }
+         out.push_back(triangle_2(c[prev_[i]], c[i], c[next_[i]]));
+         return true;
+      }
+
+      // a strictly convex corner with no other vertex in the triangle or on its sides
+      bool is_ear(const contour_2 &c, size_t i) const {
+         const point_2 &a = c[prev_[i]], &b = c[i], &d = c[next_[i]];
+         if (orientation(a, b, d) != CG_LEFT) return false;
+         for (size_t j = next_[next_[i]]; j != prev_[i]; j = next_[j]) {
+            const point_2 &q = c[j];
+            if (q == a || q == b || q == d) continue;
+            if (orientation(a, b, q) != CG_RIGHT && orientation(b, d, q) != CG_RIGHT && orientation(d, a, q) != CG_RIGHT) {
+               return false;
+            }
+         }
+         return true;
+      }
+
+      detail::chain_pool pool_;
+      detail::sweep_status<detail::segment_less> status_;
+      detail::triangle_sink sink_;
+      std::vector<point_2> points_;
+      std::vector<uint32_t> order_;
+      std::vector<uint32_t> prev_;
+      std::vector<uint32_t> next_;
+   };
+
+   inline std::vector<triangle_2> triangulate(const std::vector<contour_2> &polygon) {
+      std::vector<triangle_2> result;
+      triangulator().sweep_into(polygon, result);
       return result;
    }
+
+   inline void triangulate(const std::vector<contour_2> &polygon, indexed_triangles &out) {
+      triangulator().sweep_into(polygon, out);
+   }
+
+   // Triangulates the polygons by up to threads tasks, each with a triangulator of its own.
+   // The triangles of polygons[i] are triangles[offsets[i]] to triangles[offsets[i + 1]].
+   inline void triangulate_many(const std::vector<std::vector<contour_2>> &polygons, std::vector<triangle_2> &triangles,
+         std::vector<size_t> &offsets, size_t threads = 1) {
+      triangles.clear();
+      offsets.clear();
+      threads = std::max<size_t>(threads, 1);
+      size_t n = polygons.size();
+      size_t chunk = std::max<size_t>((n + threads - 1) / threads, 1);
+      size_t parts = (n + chunk - 1) / chunk;
+      // the first part goes right to the output
+      std::vector<std::vector<triangle_2>> part_triangles(parts);
+      std::vector<std::vector<size_t>> part_offsets(parts);
+      std::launch policy = threads > 1 ? std::launch::async : std::launch::deferred;
+      std::vector<std::future<void>> tasks;
+      for (size_t k = 0; k < parts; k++) {
+         std::vector<triangle_2> &out = k == 0 ? triangles : part_triangles[k];
+         std::vector<size_t> &out_offsets = k == 0 ? offsets : part_offsets[k];
+         tasks.push_back(std::async(policy, [&polygons, &out, &out_offsets, k, chunk, n]() {
+            size_t begin = k * chunk, end = std::min(n, (k + 1) * chunk), size = 0;
+            for (size_t i = begin; i < end; i++) {
+               for (const contour_2 &c : polygons[i]) size += c.size() + 2;
+            }
+            out.reserve(size);
+            out_offsets.reserve(end - begin + 1);
+            triangulator t;
+            for (size_t i = begin; i < end; i++) {
+               out_offsets.push_back(out.size());
+               t.triangulate_into(polygons[i], out);
+            }
+         }));
+      }
+      for (auto &task : tasks) task.get();
+      for (size_t k = 1; k < parts; k++) {
+         for (size_t offset : part_offsets[k]) offsets.push_back(triangles.size() + offset);
+         triangles.insert(triangles.end(), part_triangles[k].begin(), part_triangles[k].end());
+      }
+      offsets.push_back(triangles.size());
+   }
+
+   // The same triangulation on shared vertices: the vertices of the contours in their order, counterclockwise
+   // triangles as faces, twins between adjacent triangles and none on the border of the polygon.
+   inline void triangulate(const std::vector<contour_2> &polygon, half_edge_mesh &mesh) {
+      indexed_triangles triangles;
+      triangulate(polygon, triangles);
+      mesh.clear();
+      size_t vertices = 0;
+      for (const contour_2 &c : polygon) vertices += c.size();
+      mesh.reserve(vertices, 3 * triangles.size(), triangles.size());
+      for (const contour_2 &c : polygon) {
+         for (const point_2 &p : c) mesh.add_vertex(p);
+      }
+      // half-edge 3 * t + k is side k of triangle t
+      for (size_t t = 0; t < triangles.size(); t++) {
+         mesh.add_triangle(triangles.vertices[3 * t], triangles.vertices[3 * t + 1], triangles.vertices[3 * t + 2]);
+      }
+      for (half_edge_mesh::index_t h = 0; h != mesh.half_edges_num(); h++) {
+         half_edge_mesh::index_t t = triangles.neighbours[h];
+         if (t == indexed_triangles::none) continue;
+         for (half_edge_mesh::index_t g = 3 * t; g != 3 * t + 3; g++) {
+            if (triangles.neighbours[g] == h / 3) mesh.twin[h] = g;
+         }
+      }
+   }
 }
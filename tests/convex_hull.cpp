@@ -5,10 +5,13 @@
 #include <cg/convex_hull/graham.h>
 #include <cg/convex_hull/andrew.h>
 #include <cg/convex_hull/jarvis.h>
+#include <cg/convex_hull/chan.h>
 #include <cg/operations/contains/segment_point.h>
 #include <cg/convex_hull/quick_hull.h>
+#include <cg/convex_hull/quick_hull_par.h>
 
 #include "random_utils.h"
+#include "timer.h"
 
 template <class FwdIter>
 bool is_convex_hull(FwdIter p, FwdIter c, FwdIter q)
@@ -253,6 +256,84 @@ TEST(quick_hull, uniform)
 }
 
 
+TEST(quick_hull, pred_a)
+{
+   using cg::point_2;
+
+   util::uniform_random_real<double, std::mt19937> distr(-(1LL << 53), (1LL << 53));
+
+   std::vector<point_2> pts = uniform_points(10001);
+   for (size_t l = 0; l + 1 < pts.size(); ++l)
+   {
+      point_2 a = pts[l], b = pts[l + 1];
+      point_2 c = pts[pts.size() - l - 1];
+      point_2 d = c + distr() * (b - a);
+
+      boost::optional<cg::orientation_t> res = cg::pred_a()(a, b, c, d);
+      ASSERT_TRUE(res);
+      EXPECT_EQ(*cg::pred_r()(a, b, c, d), *res);
+   }
+}
+
+TEST(quick_hull, grid)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts;
+   for (int i = 0; i != 300; ++i)
+      for (int j = 0; j != 300; ++j)
+         pts.push_back(point_2(i * 0.1, j * 0.1));
+   std::random_shuffle(pts.begin(), pts.end());
+
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::quick_hull(pts.begin(), pts.end()), pts.end()));
+}
+
+TEST(quick_hull_par, uniform)
+{
+   using cg::point_2;
+
+   for (size_t threads = 1; threads <= 8; threads *= 2)
+   {
+      std::vector<point_2> pts = uniform_points(200000);
+      std::vector<point_2> serial = pts;
+
+      auto par_end = cg::quick_hull_par(pts.begin(), pts.end(), threads);
+      auto serial_end = cg::quick_hull(serial.begin(), serial.end());
+
+      EXPECT_TRUE(is_convex_hull(pts.begin(), par_end, pts.end()));
+      EXPECT_TRUE(std::equal(pts.begin(), par_end, serial.begin()));
+      EXPECT_EQ(serial_end - serial.begin(), par_end - pts.begin());
+   }
+}
+
+TEST(quick_hull_par, grid)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts;
+   for (int i = 0; i != 300; ++i)
+      for (int j = 0; j != 300; ++j)
+         pts.push_back(point_2(i, j));
+   std::random_shuffle(pts.begin(), pts.end());
+
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::quick_hull_par(pts.begin(), pts.end(), 4), pts.end()));
+}
+
+TEST(quick_hull_par, benchmark)
+{
+   using cg::point_2;
+
+   std::vector<point_2> const pts = uniform_points(1000000);
+
+   for (size_t threads = 1; threads <= 64; threads *= 2)
+   {
+      std::vector<point_2> cur = pts;
+      char what[64];
+      sprintf(what, "quick_hull_par, %zu threads", threads);
+      print_timing(what, measure_ms([&] { cg::quick_hull_par(cur.begin(), cur.end(), threads); }));
+   }
+}
+
 TEST(jarvis_hull, simple)
 {
    using cg::point_2;
@@ -300,3 +381,195 @@ TEST(jarvis_hull, same_line)
       std::random_shuffle(pts.begin(), pts.end());
    }
 }
+
+TEST(chan_hull, simple)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = boost::assign::list_of(point_2(0, 0))
+                                                    (point_2(1, 0))
+                                                    (point_2(0, 1))
+                                                    (point_2(2, 0))
+                                                    (point_2(0, 2))
+                                                    (point_2(3, 0));
+
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::chan_hull(pts.begin(), pts.end()), pts.end()));
+}
+
+TEST(chan_hull, line)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = boost::assign::list_of(point_2(0, 0))
+                                                    (point_2(1, 1))
+                                                    (point_2(3, 3))
+                                                    (point_2(-1, -1))
+                                                    (point_2(4, 4));
+
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::chan_hull(pts.begin(), pts.end()), pts.end()));
+}
+
+TEST(chan_hull, same_points)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts(10, point_2(1, 1));
+
+   auto it = cg::chan_hull(pts.begin(), pts.end());
+   EXPECT_EQ(1, it - pts.begin());
+}
+
+TEST(chan_hull, uniform)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = uniform_points(1000000);
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::chan_hull(pts.begin(), pts.end()), pts.end()));
+}
+
+TEST(chan_hull, uniform_small)
+{
+   using cg::point_2;
+
+   for (int cnt = 1; cnt <= 40; ++cnt)
+   {
+      for (int i = 0; i < 100; ++i)
+      {
+         std::vector<point_2> pts = uniform_points(cnt);
+         std::vector<point_2> graham = pts;
+
+         auto it = cg::chan_hull(pts.begin(), pts.end());
+         EXPECT_TRUE(is_convex_hull(pts.begin(), it, pts.end()));
+         EXPECT_EQ(cg::graham_hull(graham.begin(), graham.end()) - graham.begin(), it - pts.begin());
+      }
+   }
+}
+
+TEST(chan_hull, circle)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts;
+   for (int i = 0; i != 1000; ++i)
+      pts.push_back(point_2(cos(i * 2 * M_PI / 1000) * 100, sin(i * 2 * M_PI / 1000) * 100));
+   std::random_shuffle(pts.begin(), pts.end());
+
+   std::vector<point_2> graham = pts;
+   auto it = cg::chan_hull(pts.begin(), pts.end());
+   EXPECT_TRUE(is_convex_hull(pts.begin(), it, pts.end()));
+   EXPECT_EQ(cg::graham_hull(graham.begin(), graham.end()) - graham.begin(), it - pts.begin());
+}
+
+TEST(chan_hull, grid_with_duplicates)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts;
+   for (int k = 0; k != 3; ++k)
+      for (int i = 0; i != 50; ++i)
+         for (int j = 0; j != 50; ++j)
+            pts.push_back(point_2(i, j));
+   std::random_shuffle(pts.begin(), pts.end());
+
+   auto it = cg::chan_hull(pts.begin(), pts.end());
+   EXPECT_TRUE(is_convex_hull(pts.begin(), it, pts.end()));
+   EXPECT_EQ(4, it - pts.begin());
+}
+
+TEST(chan_hull, benchmark)
+{
+   using cg::point_2;
+
+   std::vector<point_2> const pts = uniform_points(1000000);
+
+   std::vector<point_2> cur = pts;
+   print_timing("graham_hull", measure_ms([&] { cg::graham_hull(cur.begin(), cur.end()); }));
+   cur = pts;
+   print_timing("andrew_hull", measure_ms([&] { cg::andrew_hull(cur.begin(), cur.end()); }));
+   cur = pts;
+   print_timing("chan_hull", measure_ms([&] { cg::chan_hull(cur.begin(), cur.end()); }));
+}
+
+TEST(cull_interior, keeps_hull)
+{
+   using cg::point_2;
+
+   for (int cnt = 1; cnt <= 100; ++cnt)
+   {
+      for (int i = 0; i < 20; ++i)
+      {
+         std::vector<point_2> pts = uniform_points(cnt);
+         std::vector<point_2> culled = pts;
+         std::vector<point_2>::iterator m = cg::cull_interior(culled.begin(), culled.end());
+
+         std::vector<point_2>::iterator hull_end = cg::graham_hull(pts.begin(), pts.end());
+         for (std::vector<point_2>::iterator it = pts.begin(); it != hull_end; ++it)
+            EXPECT_TRUE(std::find(culled.begin(), m, *it) != m);
+      }
+   }
+}
+
+TEST(cull_interior, uniform)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = uniform_points(100000);
+   std::vector<point_2> cur = pts;
+   EXPECT_LT(cg::cull_interior(cur.begin(), cur.end()) - cur.begin(), 10000);
+
+   cur = pts;
+   EXPECT_TRUE(is_convex_hull(cur.begin(), cg::graham_hull(cur.begin(), cur.end(), true), cur.end()));
+   cur = pts;
+   EXPECT_TRUE(is_convex_hull(cur.begin(), cg::andrew_hull(cur.begin(), cur.end(), true), cur.end()));
+   cur = pts;
+   EXPECT_TRUE(is_convex_hull(cur.begin(), cg::quick_hull(cur.begin(), cur.end(), true), cur.end()));
+   cur = pts;
+   EXPECT_TRUE(is_convex_hull(cur.begin(), cg::jarvis_hull(cur.begin(), cur.end(), true), cur.end()));
+   cur = pts;
+   EXPECT_TRUE(is_convex_hull(cur.begin(), cg::chan_hull(cur.begin(), cur.end(), true), cur.end()));
+}
+
+TEST(cull_interior, grid)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts;
+   for (int i = 0; i != 100; ++i)
+      for (int j = 0; j != 100; ++j)
+         pts.push_back(point_2(i, j));
+   std::random_shuffle(pts.begin(), pts.end());
+
+   EXPECT_TRUE(is_convex_hull(pts.begin(), cg::andrew_hull(pts.begin(), pts.end(), true), pts.end()));
+}
+
+TEST(cull_interior, benchmark)
+{
+   using cg::point_2;
+
+   std::vector<std::pair<char const *, std::vector<point_2> > > distributions;
+   distributions.push_back(std::make_pair("uniform", uniform_points(1000000)));
+   distributions.push_back(std::make_pair("disk", disk_points(1000000)));
+   distributions.push_back(std::make_pair("normal", normal_points(1000000)));
+   distributions.push_back(std::make_pair("circle", circle_points(100000)));
+
+   for (size_t d = 0; d != distributions.size(); ++d)
+   {
+      std::vector<point_2> const & pts = distributions[d].second;
+      char what[128];
+
+      for (int cull = 0; cull != 2; ++cull)
+      {
+         std::vector<point_2> cur = pts;
+         sprintf(what, "%s, graham_hull%s", distributions[d].first, cull ? " + cull" : "");
+         print_timing(what, measure_ms([&] { cg::graham_hull(cur.begin(), cur.end(), cull != 0); }));
+
+         cur = pts;
+         sprintf(what, "%s, andrew_hull%s", distributions[d].first, cull ? " + cull" : "");
+         print_timing(what, measure_ms([&] { cg::andrew_hull(cur.begin(), cur.end(), cull != 0); }));
+
+         cur = pts;
+         sprintf(what, "%s, quick_hull%s", distributions[d].first, cull ? " + cull" : "");
+         print_timing(what, measure_ms([&] { cg::quick_hull(cur.begin(), cur.end(), cull != 0); }));
+      }
+   }
+}
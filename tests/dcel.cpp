@@ -0,0 +1,558 @@
+#include <gtest/gtest.h>
+
+#include "random_utils.h"
+#include "timer.h"
+#include <memory>
+#include <set>
+
+#include <cg/structures/kirkpatrickLinesByPoint.h>
+
+// line through every two consecutive points
+DCEL arrangementThrough(std::vector<point_2f> const &points) {
+    size_t count = points.size() / 2;
+    std::vector<Line> lines;
+    for (size_t i = 0; i < count; i++) {
+        point_2f a = points[2 * i];
+        point_2f b = points[2 * i + 1];
+        lines.push_back(Line(a.y - b.y, b.x - a.x, a.x * b.y - a.y * b.x));
+    }
+    DCEL dcel(lines[0]);
+    for (size_t i = 1; i < count; i++) {
+        dcel.addLine(lines[i]);
+    }
+    return dcel;
+}
+
+// line through two random points
+DCEL randomArrangement(size_t count, float range) {
+    return arrangementThrough(uniform_points<float>(2 * count, -range, range));
+}
+
+int faceOf(DCEL const &dcel, int eid) {
+    int face = eid;
+    for (int cur = dcel.edges[eid].nextEid; cur != eid; cur = dcel.edges[cur].nextEid) {
+        face = std::min(face, cur);
+    }
+    return face;
+}
+
+// the point is not to the right of any edge of the face
+bool faceContains(DCEL const &dcel, int face, cg::point_2 const &point) {
+    int eid = face;
+    do {
+        cg::point_2 a, b;
+        dcel.supportingLine(eid, a, b);
+        if (cg::orientation(a, b, point) == cg::CG_RIGHT) {
+            return false;
+        }
+        eid = dcel.edges[eid].nextEid;
+    } while (eid != face);
+    return true;
+}
+
+// walks from the face of from to the face of the point along the segment between them
+int walkLocate(DCEL const &dcel, int face, cg::point_2 from, cg::point_2 const &point) {
+    for (size_t steps = 0; steps < dcel.edges.size(); steps++) {
+        int exit = -1;
+        double exitAt = HUGE_VAL;
+        int eid = face;
+        do {
+            cg::point_2 a, b;
+            dcel.supportingLine(eid, a, b);
+            double toPoint = (b - a) ^ (point - a);
+            if (cg::orientation(a, b, point) == cg::CG_RIGHT) {
+                double toFrom = (b - a) ^ (from - a);
+                double at = toFrom / (toFrom - toPoint);
+                if (at < exitAt) {
+                    exitAt = at;
+                    exit = eid;
+                }
+            }
+            eid = dcel.edges[eid].nextEid;
+        } while (eid != face);
+        if (exit == -1) {
+            break;
+        }
+        from = from + (point - from) * std::max(exitAt, 0.);
+        face = dcel.edges[exit].twinEid;
+    }
+    return faceOf(dcel, face);
+}
+
+// lines with small integer coefficients, many of them parallel or through common vertexes;
+// the duplicates are rejected by addLine and left out
+std::vector<Line> addIntegerLines(DCEL &dcel, size_t count, int range) {
+    util::uniform_random_int<int, std::mt19937> random(-range, range);
+    std::vector<Line> added(1, dcel.lines[0]);
+    while (added.size() < count) {
+        Line line(random(), random(), random());
+        if (line.a == 0 && line.b == 0) {
+            continue;
+        }
+        bool duplicate = false;
+        for (Line const &other : added) {
+            duplicate |= line.a * other.b == line.b * other.a && line.a * other.c == line.c * other.a
+                    && line.b * other.c == line.c * other.b;
+        }
+        if (duplicate) {
+            EXPECT_THROW(dcel.addLine(line), std::invalid_argument);
+        } else {
+            dcel.addLine(line);
+            added.push_back(line);
+        }
+    }
+    return added;
+}
+
+// the edges are consistent and there are as many vertexes and edges as the crossings of the lines give
+void expectValidArrangement(DCEL const &dcel, std::vector<Line> const &lines) {
+    for (size_t eid = 0; eid < dcel.edges.size(); eid++) {
+        Edge const &edge = dcel.edges[eid];
+        EXPECT_EQ(int(eid), dcel.edges[edge.twinEid].twinEid);
+        EXPECT_EQ(int(eid), dcel.edges[edge.nextEid].prevEid);
+        EXPECT_EQ(dcel.edges[edge.twinEid].fromVid, dcel.edges[edge.nextEid].fromVid);
+        EXPECT_EQ(dcel.lines[edge.lineId].twinLid, dcel.lines[dcel.edges[edge.twinEid].lineId].id);
+    }
+    std::set<std::pair<mpq_class, mpq_class>> crossings;
+    size_t pieces = 0;
+    for (Line const &line : lines) {
+        std::set<std::pair<mpq_class, mpq_class>> onLine;
+        for (Line const &other : lines) {
+            mpq_class denominator = mpq_class(line.a) * other.b - mpq_class(line.b) * other.a;
+            if (denominator != 0) {
+                onLine.insert(std::make_pair((mpq_class(line.b) * other.c - mpq_class(line.c) * other.b) / denominator,
+                        (mpq_class(line.c) * other.a - mpq_class(line.a) * other.c) / denominator));
+            }
+        }
+        crossings.insert(onLine.begin(), onLine.end());
+        pieces += onLine.size() + 1;
+    }
+    EXPECT_EQ(crossings.size() + 1, dcel.vertexes.size());
+    EXPECT_EQ(2 * pieces, dcel.edges.size());
+    EXPECT_EQ(2 * lines.size(), dcel.infinityRing.size());
+}
+
+TEST(dcel_arrangement, randomLines) {
+    for (size_t count : {2, 3, 10, 300}) {
+        DCEL dcel = randomArrangement(count, 100);
+        EXPECT_EQ(count * (count - 1) / 2 + 1, dcel.vertexes.size());
+        EXPECT_EQ(2 * count * count, dcel.edges.size());
+        std::vector<Line> lines;
+        for (size_t lid = 0; lid < dcel.lines.size(); lid += 2) {
+            lines.push_back(dcel.lines[lid]);
+        }
+        if (count <= 10) {
+            expectValidArrangement(dcel, lines);
+        }
+    }
+}
+
+TEST(dcel_arrangement, parallelAndConcurrent) {
+    // a grid with both diagonals through its center, then lines of small integer coefficients
+    DCEL dcel(Line(1, 0, 0));
+    std::vector<Line> lines(1, dcel.lines[0]);
+    for (int i = 0; i < 5; i++) {
+        if (i != 0) {
+            lines.push_back(Line(1, 0, -i));
+        }
+        lines.push_back(Line(0, 1, -i));
+    }
+    lines.push_back(Line(1, -1, 0));
+    lines.push_back(Line(1, 1, -4));
+    for (size_t i = 1; i < lines.size(); i++) {
+        dcel.addLine(lines[i]);
+    }
+    EXPECT_EQ(26u, dcel.vertexes.size());
+    EXPECT_EQ(144u, dcel.edges.size());
+    expectValidArrangement(dcel, lines);
+    EXPECT_THROW(dcel.addLine(Line(-2, 2, 0)), std::invalid_argument);
+
+    DCEL parallel(Line(0, 1, -1));
+    std::vector<Line> parallelLines(1, parallel.lines[0]);
+    for (Line line : {Line(0, 1, 3), Line(0, -1, 10), Line(0, -2, -1), Line(0, 3, 30)}) {
+        parallel.addLine(line);
+        parallelLines.push_back(line);
+    }
+    expectValidArrangement(parallel, parallelLines);
+    parallel.addLine(Line(1, 0, 0));
+    parallelLines.push_back(Line(1, 0, 0));
+    expectValidArrangement(parallel, parallelLines);
+
+    for (int range : {2, 3, 10}) {
+        DCEL integer(Line(1, 1, 0));
+        std::vector<Line> added = addIntegerLines(integer, 30, range);
+        expectValidArrangement(integer, added);
+    }
+}
+
+TEST(dcel_arrangement, benchmark) {
+    for (size_t count : {500, 1000, 2000}) {
+        std::unique_ptr<DCEL> dcel;
+        double ms = measure_ms([&] {
+            dcel.reset(new DCEL(randomArrangement(count, 100)));
+        });
+        EXPECT_EQ(2 * count * count, dcel->edges.size());
+        printf("[          ] %zu lines: %.2f ms, %.2f ns per square of the count of lines\n",
+                count, ms, ms * 1e6 / (count * count));
+    }
+}
+
+// the bounded faces are triangles with the vertexes of the old faces, the unbounded faces are left as they were
+void expectTriangulated(DCEL const &before, DCEL const &after) {
+    size_t diagonals = 0;
+    std::vector<bool> visited(before.edges.size(), false);
+    for (size_t start = 0; start < before.edges.size(); start++) {
+        if (visited[start]) {
+            continue;
+        }
+        size_t size = 0;
+        bool bounded = true;
+        int eid = start;
+        do {
+            visited[eid] = true;
+            bounded = bounded && before.edges[eid].fromVid != before.infinityVid;
+            size++;
+            eid = before.edges[eid].nextEid;
+        } while (eid != (int) start);
+        if (bounded) {
+            diagonals += 2 * (size - 3);
+        } else {
+            EXPECT_EQ(size_t(before.edges[start].nextEid), size_t(after.edges[start].nextEid));
+        }
+    }
+    ASSERT_EQ(before.edges.size() + diagonals, after.edges.size());
+    for (size_t eid = 0; eid < after.edges.size(); eid++) {
+        Edge const &edge = after.edges[eid];
+        EXPECT_EQ(int(eid), edge.id);
+        EXPECT_EQ(int(eid), after.edges[edge.twinEid].twinEid);
+        EXPECT_EQ(int(eid), after.edges[edge.nextEid].prevEid);
+        EXPECT_EQ(after.edges[edge.twinEid].fromVid, after.edges[edge.nextEid].fromVid);
+        bool bounded = true;
+        int cur = eid;
+        do {
+            bounded = bounded && after.edges[cur].fromVid != after.infinityVid;
+            cur = after.edges[cur].nextEid;
+        } while (cur != (int) eid);
+        if (bounded) {
+            EXPECT_EQ(int(eid), after.edges[after.edges[edge.nextEid].nextEid].nextEid);
+        }
+        if (eid >= before.edges.size()) {
+            EXPECT_EQ(-1, edge.lineId);
+        }
+    }
+}
+
+TEST(dcel_triangulate, randomLines) {
+    for (size_t count : {2, 3, 4, 10, 200}) {
+        DCEL dcel = randomArrangement(count, 100);
+        DCEL triangulated = dcel;
+        triangulated.triangulate();
+        expectTriangulated(dcel, triangulated);
+    }
+}
+
+TEST(dcel_triangulate, parallelAndConcurrent) {
+    DCEL dcel(Line(1, 0, 0));
+    for (int i = 0; i < 6; i++) {
+        if (i != 0) {
+            dcel.addLine(Line(1, 0, -i));
+        }
+        dcel.addLine(Line(0, 1, -i));
+    }
+    dcel.addLine(Line(1, -1, 0));
+    DCEL triangulated = dcel;
+    triangulated.triangulate();
+    expectTriangulated(dcel, triangulated);
+
+    DCEL integer(Line(1, 1, 0));
+    addIntegerLines(integer, 30, 3);
+    DCEL integerTriangulated = integer;
+    integerTriangulated.triangulate();
+    expectTriangulated(integer, integerTriangulated);
+}
+
+TEST(dcel_triangulate, tasks) {
+    DCEL dcel = randomArrangement(300, 100);
+    DCEL single = dcel;
+    single.triangulate();
+    dcel.triangulate(3);
+    ASSERT_EQ(single.edges.size(), dcel.edges.size());
+    for (size_t eid = 0; eid < dcel.edges.size(); eid++) {
+        EXPECT_EQ(single.edges[eid].nextEid, dcel.edges[eid].nextEid);
+        EXPECT_EQ(single.edges[eid].fromVid, dcel.edges[eid].fromVid);
+    }
+}
+
+TEST(dcel_triangulate, benchmark) {
+    size_t const count = 2000;
+    DCEL dcel = randomArrangement(count, 100);
+    size_t edgesWas = dcel.edges.size();
+    for (size_t threads : {1, 4}) {
+        std::unique_ptr<DCEL> triangulated(new DCEL(dcel));
+        double ms = measure_ms([&] {
+            triangulated->triangulate(threads);
+        });
+        printf("[          ] %zu lines, %zu half-edges: %zu diagonals in %.2f ms with %zu tasks\n",
+                count, edgesWas, (triangulated->edges.size() - edgesWas) / 2, ms, threads);
+    }
+}
+
+TEST(dcel_mesh, sameEdges) {
+    DCEL dcel = randomArrangement(50, 100);
+    dcel.triangulate();
+    cg::half_edge_mesh_f mesh;
+    dcel.toMesh(mesh);
+    ASSERT_EQ(dcel.vertexes.size(), mesh.vertices_num());
+    ASSERT_EQ(dcel.edges.size(), mesh.half_edges_num());
+    for (size_t eid = 0; eid < dcel.edges.size(); eid++) {
+        Edge const &edge = dcel.edges[eid];
+        EXPECT_EQ(uint32_t(edge.fromVid), mesh.origin[eid]);
+        EXPECT_EQ(uint32_t(edge.nextEid), mesh.next[eid]);
+        EXPECT_EQ(uint32_t(edge.prevEid), mesh.prev[eid]);
+        EXPECT_EQ(uint32_t(edge.twinEid), mesh.twin[eid]);
+        EXPECT_EQ(mesh.face[eid], mesh.face[mesh.next[eid]]);
+        EXPECT_EQ(faceOf(dcel, eid), int(mesh.face_edge[mesh.face[eid]]));
+    }
+    for (size_t vid = 1; vid < dcel.vertexes.size(); vid++) {
+        EXPECT_EQ(dcel.vertexes[vid].point, mesh.points[vid]);
+        EXPECT_EQ(uint32_t(vid), mesh.origin[mesh.vertex_edge[vid]]);
+    }
+}
+
+// walks every face around its edges, in the edge structs of the DCEL and in the link arrays of the mesh
+TEST(dcel_mesh, benchmark) {
+    size_t const count = 2000;
+    DCEL dcel = randomArrangement(count, 100);
+    cg::half_edge_mesh_f mesh;
+    double meshMs = measure_ms([&] {
+        dcel.toMesh(mesh);
+    });
+    size_t dcelBytes = dcel.edges.capacity() * sizeof(Edge) + dcel.vertexes.capacity() * sizeof(Vertex);
+    printf("[          ] %zu half-edges: DCEL %zu bytes, mesh %zu bytes built in %.2f ms\n",
+            dcel.edges.size(), dcelBytes, mesh.memory_usage(), meshMs);
+
+    std::vector<int> faces;
+    for (size_t f = 0; f < mesh.faces_num(); f++) {
+        faces.push_back(mesh.face_edge[f]);
+    }
+    std::shuffle(faces.begin(), faces.end(), std::mt19937(1));
+    size_t dcelSteps = 0, meshSteps = 0;
+    double dcelMs = measure_ms([&] {
+        for (int face : faces) {
+            int eid = face;
+            do {
+                dcelSteps += dcel.edges[eid].fromVid != dcel.infinityVid;
+                eid = dcel.edges[eid].nextEid;
+            } while (eid != face);
+        }
+    });
+    double meshSoaMs = measure_ms([&] {
+        for (int face : faces) {
+            uint32_t h = face;
+            do {
+                meshSteps += mesh.origin[h] != uint32_t(dcel.infinityVid);
+                h = mesh.next[h];
+            } while (h != uint32_t(face));
+        }
+    });
+    EXPECT_EQ(dcelSteps, meshSteps);
+    printf("[          ] %zu faces in random order: DCEL %.2f ms, mesh %.2f ms\n", faces.size(), dcelMs, meshSoaMs);
+}
+
+void expectLocated(DCEL const &dcel, KirkpatrickLocator const &locator, point_2f point) {
+    Location location = locator.locate(point);
+    cg::point_2 q(point);
+    if (location.type == LOCATION_FACE) {
+        EXPECT_EQ(faceOf(dcel, location.id), location.id);
+        EXPECT_TRUE(faceContains(dcel, location.id, q));
+    } else if (location.type == LOCATION_EDGE) {
+        int twin = dcel.edges[location.id].twinEid;
+        EXPECT_LT(location.id, twin);
+        EXPECT_TRUE(faceContains(dcel, faceOf(dcel, location.id), q));
+        EXPECT_TRUE(faceContains(dcel, faceOf(dcel, twin), q));
+    } else {
+        EXPECT_EQ(point, dcel.vertexes[location.id].point);
+    }
+}
+
+TEST(dcel_kirkpatrick, sameAsBruteForce) {
+    for (size_t count : {1, 2, 3, 10, 40}) {
+        DCEL dcel = randomArrangement(count, 100);
+        KirkpatrickLocator locator(dcel);
+        for (point_2f point : uniform_points<float>(2000, -300, 300)) {
+            expectLocated(dcel, locator, point);
+        }
+        for (point_2f point : uniform_points<float>(200, -1e6f, 1e6f)) {
+            expectLocated(dcel, locator, point);
+        }
+        for (size_t vid = 1; vid < dcel.vertexes.size(); vid++) {
+            Location location = locator.locate(dcel.vertexes[vid].point);
+            EXPECT_EQ(LOCATION_VERTEX, location.type);
+            EXPECT_EQ(int(vid), location.id);
+        }
+        // the hierarchy stays linear
+        EXPECT_LT(locator.trianglesCount(), 20 * dcel.vertexes.size() + 100);
+    }
+}
+
+// sign of a * x + b * y + c, exact
+int lineSign(Line const &line, point_2f point) {
+    double ax = double(line.a) * point.x;
+    double by = double(line.b) * point.y;
+    double res = ax + by + line.c;
+    if (fabs(res) > (fabs(ax) + fabs(by) + fabs(line.c)) * 4 * std::numeric_limits<double>::epsilon()) {
+        return res > 0 ? 1 : -1;
+    }
+    return sgn(mpq_class(line.a) * point.x + mpq_class(line.b) * point.y + line.c);
+}
+
+// the face lies to the left of its edges, where its lines are negative
+bool strictlyInside(DCEL const &dcel, int face, point_2f point) {
+    int eid = face;
+    do {
+        if (lineSign(dcel.lines[dcel.edges[eid].lineId], point) >= 0) {
+            return false;
+        }
+        eid = dcel.edges[eid].nextEid;
+    } while (eid != face);
+    return true;
+}
+
+TEST(dcel_kirkpatrick, tinyFaces) {
+    // rounded to float, the vertexes of a few of the half million faces are out of convex position
+    std::mt19937 generator(2);
+    std::uniform_real_distribution<float> coordinate(-100, 100);
+    std::vector<point_2f> points(2000);
+    for (point_2f &point : points) {
+        point.x = coordinate(generator);
+        point.y = coordinate(generator);
+    }
+    DCEL dcel = arrangementThrough(points);
+    KirkpatrickLocator locator(dcel);
+
+    std::vector<int> trianglesByFace = locator.trianglesByFace();
+    size_t faces = 0;
+    size_t checked = 0;
+    for (size_t face = 0; face < dcel.edges.size(); face++) {
+        if (faceOf(dcel, face) != int(face)) {
+            continue;
+        }
+        faces++;
+        EXPECT_LT(0, trianglesByFace[face]);
+        // the centroid of the crossings in double, if a float point is there
+        double x = 0, y = 0;
+        size_t size = 0;
+        bool bounded = true;
+        int eid = face;
+        do {
+            Vertex const &vertex = dcel.vertexes[dcel.edges[eid].fromVid];
+            bounded = bounded && vertex.id != dcel.infinityVid;
+            if (bounded) {
+                cg::point_2 crossing = DCEL::crossingD(dcel.lines[vertex.lineId1], dcel.lines[vertex.lineId2]);
+                x += crossing.x;
+                y += crossing.y;
+                size++;
+            }
+            eid = dcel.edges[eid].nextEid;
+        } while (eid != (int) face);
+        point_2f inside(x / size, y / size);
+        if (bounded && strictlyInside(dcel, face, inside)) {
+            Location location = locator.locate(inside);
+            EXPECT_EQ(LOCATION_FACE, location.type);
+            EXPECT_EQ(int(face), location.id);
+            checked++;
+        }
+    }
+    // the faces without a float point inside are the only ones left out
+    EXPECT_LT(faces * 9 / 10, checked);
+}
+
+TEST(dcel_kirkpatrick, edgesAndVertexes) {
+    // x = 0, y = 0, x + y = 4, x - y = 2
+    DCEL dcel(Line(1, 0, 0));
+    dcel.addLine(Line(0, 1, 0));
+    dcel.addLine(Line(1, 1, -4));
+    dcel.addLine(Line(1, -1, -2));
+    KirkpatrickLocator locator(dcel);
+
+    for (point_2f point : {point_2f(0, 1), point_2f(0, -7), point_2f(0, 1e6f), point_2f(-3, 0), point_2f(1e6f, 0),
+            point_2f(1, 3), point_2f(-100, 104), point_2f(5, 3), point_2f(-1e5f, -1e5f - 2)}) {
+        Location location = locator.locate(point);
+        EXPECT_EQ(LOCATION_EDGE, location.type);
+        Line line = dcel.lines[dcel.edges[location.id].lineId];
+        EXPECT_EQ(0, line.a * point.x + line.b * point.y + line.c);
+        expectLocated(dcel, locator, point);
+    }
+    for (point_2f point : {point_2f(0, 0), point_2f(0, 4), point_2f(3, 1), point_2f(2, 0)}) {
+        EXPECT_EQ(LOCATION_VERTEX, locator.locate(point).type);
+        expectLocated(dcel, locator, point);
+    }
+    for (point_2f point : {point_2f(1, 1), point_2f(-5, -5), point_2f(3, -5), point_2f(1e6f, 3), point_2f(3, 1e6f)}) {
+        EXPECT_EQ(LOCATION_FACE, locator.locate(point).type);
+        expectLocated(dcel, locator, point);
+    }
+}
+
+TEST(dcel_kirkpatrick, parallelAndConcurrent) {
+    DCEL parallel(Line(0, 1, -1));
+    parallel.addLine(Line(0, 1, 3));
+    parallel.addLine(Line(0, -1, 10));
+    KirkpatrickLocator locator(parallel);
+    for (point_2f point : uniform_points<float>(1000, -20, 20)) {
+        expectLocated(parallel, locator, point);
+    }
+    EXPECT_EQ(LOCATION_EDGE, locator.locate(point_2f(1e6f, 10)).type);
+    EXPECT_EQ(LOCATION_FACE, locator.locate(point_2f(-1e6f, 1e6f)).type);
+
+    DCEL integer(Line(1, 1, 0));
+    addIntegerLines(integer, 30, 3);
+    KirkpatrickLocator integerLocator(integer);
+    for (point_2f point : uniform_points<float>(2000, -10, 10)) {
+        expectLocated(integer, integerLocator, point);
+    }
+    for (size_t vid = 1; vid < integer.vertexes.size(); vid++) {
+        Location location = integerLocator.locate(integer.vertexes[vid].point);
+        if (location.type == LOCATION_VERTEX) {
+            EXPECT_EQ(int(vid), location.id);
+        }
+    }
+}
+
+TEST(dcel_kirkpatrick, benchmark) {
+    size_t const count = 1000;
+    std::unique_ptr<DCEL> arrangement;
+    double buildDcelMs = measure_ms([&] {
+        arrangement.reset(new DCEL(randomArrangement(count, 100)));
+    });
+    DCEL const &dcel = *arrangement;
+    std::unique_ptr<KirkpatrickLocator> locator;
+    double buildMs = measure_ms([&] {
+        locator.reset(new KirkpatrickLocator(dcel));
+    });
+    printf("[          ] %zu lines, %zu vertexes: arrangement %.2f ms, hierarchy %.2f ms, %zu triangles in %d levels\n",
+            count, dcel.vertexes.size() - 1, buildDcelMs, buildMs, locator->trianglesCount(), locator->levelsCount());
+
+    std::vector<point_2f> queries = uniform_points<float>(1000000, -150, 150);
+    size_t faces = 0;
+    double locateMs = measure_ms([&] {
+        for (point_2f query : queries) {
+            faces += locator->locate(query).type == LOCATION_FACE;
+        }
+    });
+
+    size_t const walks = 2000;
+    size_t same = 0;
+    cg::point_2 from(queries[0]);
+    int face = locator->locate(queries[0]).id;
+    double walkMs = measure_ms([&] {
+        for (size_t i = 1; i <= walks; i++) {
+            face = walkLocate(dcel, face, from, queries[i]);
+            from = queries[i];
+            same += face == locator->locate(queries[i]).id;
+        }
+    });
+    EXPECT_EQ(walks, same);
+    EXPECT_EQ(queries.size(), faces);
+    printf("[          ] %zu queries: Kirkpatrick %.3f us per query, linear walk %.3f us per query\n",
+            queries.size(), locateMs * 1000 / queries.size(), walkMs * 1000 / walks);
+}
@@ -0,0 +1,142 @@
+#include <vector>
+#include <set>
+#include <gtest/gtest.h>
+
+#include <cg/operations/incircle.h>
+#include <cg/triangulation/delaunay.h>
+#include <misc/random_utils.h>
+
+#include "random_utils.h"
+#include "timer.h"
+
+using namespace cg;
+
+TEST(incircle, cocircular)
+{
+   std::vector<point_2> pts = {point_2(5, 0), point_2(4, 3), point_2(3, 4), point_2(0, 5), point_2(-3, 4),
+                               point_2(-5, 0), point_2(-4, -3), point_2(0, -5), point_2(3, -4)};
+   for (size_t d = 3; d < pts.size(); d++)
+      EXPECT_EQ(CG_COCIRCULAR, incircle(pts[0], pts[1], pts[2], pts[d]));
+
+   EXPECT_EQ(CG_INSIDE, incircle(pts[0], pts[1], pts[2], point_2(0, 0)));
+   EXPECT_EQ(CG_INSIDE, incircle(pts[0], pts[1], pts[2], point_2(4.999999999, 0)));
+   EXPECT_EQ(CG_OUTSIDE, incircle(pts[0], pts[1], pts[2], point_2(5.000000001, 0)));
+   EXPECT_EQ(CG_OUTSIDE, incircle(pts[0], pts[2], pts[1], point_2(0, 0)));
+}
+
+TEST(incircle, uniform_circle)
+{
+   // rounded points of one circle, mostly close to cocircular
+   std::vector<point_2> pts = circle_points(300, 1e3);
+   for (size_t i = 0; i + 3 < pts.size(); i++)
+   {
+      point_2 a = pts[i], b = pts[i + 1], c = pts[i + 2];
+      if (orientation(a, b, c) == CG_RIGHT)
+         std::swap(b, c);
+      for (size_t d = 0; d != pts.size(); d++)
+         EXPECT_EQ(*incircle_r()(a, b, c, pts[d]), incircle(a, b, c, pts[d]));
+   }
+}
+
+// a Delaunay triangulation of all distinct points, covering their hull
+void check_delaunay(std::vector<point_2> const & pts, indexed_triangles const & t)
+{
+   std::set<point_2> distinct(pts.begin(), pts.end());
+   std::set<point_2> used, hull;
+   for (size_t i = 0; i != t.size(); i++)
+   {
+      point_2 const & a = pts[t.vertices[3 * i]], & b = pts[t.vertices[3 * i + 1]], & c = pts[t.vertices[3 * i + 2]];
+      EXPECT_EQ(CG_LEFT, orientation(a, b, c));
+      for (point_2 const & p : distinct)
+         EXPECT_NE(CG_INSIDE, incircle(a, b, c, p));
+
+      for (size_t k = 0; k != 3; k++)
+      {
+         size_t from = t.vertices[3 * i + k], to = t.vertices[3 * i + (k + 1) % 3];
+         used.insert(pts[from]);
+         size_t n = t.neighbours[3 * i + k];
+         if (n == size_t(indexed_triangles::none))
+         {
+            hull.insert(pts[from]);
+            for (point_2 const & p : distinct)
+               EXPECT_NE(CG_RIGHT, orientation(pts[from], pts[to], p));
+            continue;
+         }
+         bool back = false;
+         for (size_t j = 0; j != 3; j++)
+            back |= t.neighbours[3 * n + j] == i && t.vertices[3 * n + j] == to && t.vertices[3 * n + (j + 1) % 3] == from;
+         EXPECT_TRUE(back);
+      }
+   }
+   if (t.size() == 0)
+      return;
+   EXPECT_EQ(distinct.size(), used.size());
+   EXPECT_EQ(2 * distinct.size() - hull.size() - 2, t.size());
+}
+
+TEST(delaunay, uniform)
+{
+   for (size_t n : {3, 4, 10, 100, 1000})
+   {
+      std::vector<point_2> pts = uniform_points(n);
+      indexed_triangles t;
+      delaunay_triangulate(pts, t);
+      check_delaunay(pts, t);
+   }
+}
+
+TEST(delaunay, grid)
+{
+   // cocircular and collinear points everywhere, each point twice
+   std::vector<point_2> pts;
+   for (int x = 0; x < 20; x++)
+      for (int y = 0; y < 20; y++)
+         pts.push_back(point_2(x, y));
+   pts.insert(pts.end(), pts.begin(), pts.end());
+   indexed_triangles t;
+   delaunay_triangulate(pts, t);
+   check_delaunay(pts, t);
+   EXPECT_EQ(2 * 19 * 19, t.size());
+}
+
+TEST(delaunay, circle)
+{
+   std::vector<point_2> pts = {point_2(5, 0), point_2(4, 3), point_2(3, 4), point_2(0, 5), point_2(-3, 4),
+                               point_2(-5, 0), point_2(-4, -3), point_2(0, -5), point_2(3, -4), point_2(0, 0)};
+   std::vector<point_2> more = circle_points(200, 1e3);
+   indexed_triangles t;
+   delaunay_triangulate(pts, t);
+   check_delaunay(pts, t);
+   delaunay_triangulate(more, t);
+   check_delaunay(more, t);
+}
+
+TEST(delaunay, collinear)
+{
+   std::vector<point_2> pts;
+   for (int i = 0; i < 50; i++)
+      pts.push_back(point_2(i, 2 * i));
+   indexed_triangles t;
+   delaunay_triangulate(pts, t);
+   EXPECT_EQ(0, t.size());
+
+   // and points of the hull on its edges, beyond its edges and at its vertices
+   pts.push_back(point_2(0, 1));
+   pts.push_back(point_2(-1, -2));
+   pts.push_back(point_2(60, 120));
+   pts.push_back(point_2(49, 98));
+   delaunay_triangulate(pts, t);
+   check_delaunay(pts, t);
+}
+
+TEST(delaunay, benchmark)
+{
+   delaunay_triangulator d;
+   indexed_triangles t;
+   for (size_t n : {100000, 1000000})
+   {
+      std::vector<point_2> pts = uniform_points(n, -1e6, 1e6);
+      double ms = measure_ms([&] { d.triangulate_into(pts, t); });
+      printf("[          ] %zu points: %.2f ms, %.0f points per second, %zu triangles\n", n, ms, n / ms * 1000, t.size());
+   }
+}
@@ -2,8 +2,11 @@
 #include <boost/assign/list_of.hpp>
 
 #include <cg/convex_hull/naive_dynamic.h>
+#include <cg/convex_hull/dynamic.h>
+#include <cg/convex_hull/graham.h>
 
 #include "random_utils.h"
+#include "timer.h"
 
 template <class FwdIter>
 bool is_convex_hull(FwdIter ab, FwdIter ae, FwdIter hb, FwdIter he)
@@ -145,3 +148,182 @@ TEST(dynamic_convex_hull, unifrom_with_deleting)
 
    EXPECT_TRUE(is_convex_hull(after_deleting.begin(), after_deleting.end(), dh.get_hull().first, dh.get_hull().second));
 }
+
+TEST(dynamic_hull, with_deleting)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = boost::assign::list_of(point_2(0, 0))
+                              (point_2(3, 0))
+                              (point_2(4, 2))
+                              (point_2(2, 2))
+                              (point_2(2, 4))
+                              (point_2(-1, 2))
+                              (point_2(1, 1))
+                              (point_2(0, 1));
+
+   std::vector<point_2> not_removed = boost::assign::list_of(point_2(0, 0))
+                                      (point_2(3, 0))
+                                      (point_2(2, 2))
+                                      (point_2(1, 1))
+                                      (point_2(0, 1));
+   cg::dynamic_hull dh;
+
+   for (point_2 p : pts)
+   {
+      dh.add_point(p);
+   }
+
+   dh.remove_point(point_2(4, 2));
+   dh.remove_point(point_2(-1, 2));
+   dh.remove_point(point_2(2, 4));
+   EXPECT_TRUE(is_convex_hull(not_removed.begin(), not_removed.end(), dh.get_hull().first, dh.get_hull().second));
+   EXPECT_EQ(5, dh.get_all_points().second - dh.get_all_points().first);
+}
+
+TEST(dynamic_hull, degenerate)
+{
+   using cg::point_2;
+
+   cg::dynamic_hull dh;
+   EXPECT_TRUE(dh.get_hull().first == dh.get_hull().second);
+
+   dh.add_point(point_2(1, 2));
+   dh.add_point(point_2(1, 2));
+   EXPECT_EQ(1, dh.get_hull().second - dh.get_hull().first);
+
+   for (int i = 0; i != 10; i++)
+   {
+      dh.add_point(point_2(i, 2 * i));
+   }
+   std::vector<point_2> line(dh.get_hull().first, dh.get_hull().second);
+   EXPECT_EQ(boost::assign::list_of(point_2(0, 0))(point_2(9, 18)), line);
+
+   dh.remove_point(point_2(9, 18));
+   dh.remove_point(point_2(0, 0));
+   dh.remove_point(point_2(1, 2));
+   line.assign(dh.get_hull().first, dh.get_hull().second);
+   EXPECT_EQ(boost::assign::list_of(point_2(1, 2))(point_2(8, 16)), line);
+
+   // the duplicates still hold (1, 2)
+   dh.remove_point(point_2(42, 42));
+   EXPECT_EQ(9u, dh.size());
+}
+
+// random insertions and removals on a small grid (lots of duplicates and collinear points),
+// the hull is compared with graham_hull of the current multiset
+TEST(dynamic_hull, stress)
+{
+   using cg::point_2;
+
+   boost::random::mt19937 gen(42);
+   boost::random::uniform_int_distribution<> coord(-8, 8);
+
+   for (int round = 0; round != 20; round++)
+   {
+      cg::dynamic_hull dh;
+      std::vector<point_2> present;
+
+      for (int step = 0; step != 500; step++)
+      {
+         if (present.empty() || gen() % 3 != 0)
+         {
+            point_2 p(coord(gen), coord(gen));
+            dh.add_point(p);
+            present.push_back(p);
+         }
+         else
+         {
+            size_t idx = gen() % present.size();
+            dh.remove_point(present[idx]);
+            present.erase(present.begin() + idx);
+         }
+
+         std::vector<point_2> expected = present;
+         expected.erase(cg::graham_hull(expected.begin(), expected.end()), expected.end());
+
+         std::vector<point_2> hull(dh.get_hull().first, dh.get_hull().second);
+         ASSERT_EQ(expected, hull);
+         ASSERT_EQ(present.size(), dh.size());
+      }
+   }
+}
+
+TEST(dynamic_hull, uniform_with_deleting)
+{
+   using cg::point_2;
+
+   std::vector<point_2> pts = uniform_points(20000);
+   cg::dynamic_hull dh;
+
+   for (point_2 p : pts)
+   {
+      dh.add_point(p);
+   }
+
+   for (size_t i = 0; i < pts.size(); i += 2)
+   {
+      dh.remove_point(pts[i]);
+   }
+
+   std::vector<point_2> rest;
+   for (size_t i = 1; i < pts.size(); i += 2)
+   {
+      rest.push_back(pts[i]);
+   }
+   std::vector<point_2> expected = rest;
+   expected.erase(cg::graham_hull(expected.begin(), expected.end()), expected.end());
+
+   EXPECT_EQ(expected, std::vector<point_2>(dh.get_hull().first, dh.get_hull().second));
+   EXPECT_TRUE(is_convex_hull(rest.begin(), rest.end(), dh.get_hull().first, dh.get_hull().second));
+}
+
+TEST(dynamic_hull, benchmark)
+{
+   using cg::point_2;
+
+   for (size_t n : {1000, 10000, 100000})
+   {
+      std::vector<point_2> pts = uniform_points(n);
+
+      cg::dynamic_hull dh;
+      double ms = measure_ms([&]
+      {
+         for (point_2 p : pts)
+            dh.add_point(p);
+         for (point_2 p : pts)
+            dh.remove_point(p);
+      });
+
+      char what[64];
+      sprintf(what, "dynamic_hull, %u insertions + removals", unsigned(n));
+      print_timing(what, ms);
+
+      // the naive structure rebuilds the hull on every query
+      if (n <= 1000)
+      {
+         cg::naive_dynamic_hull nh;
+         ms = measure_ms([&]
+         {
+            for (point_2 p : pts)
+            {
+               nh.add_point(p);
+               nh.get_hull();
+            }
+         });
+         sprintf(what, "naive_dynamic_hull, %u insertions with queries", unsigned(n));
+         print_timing(what, ms);
+      }
+
+      ms = measure_ms([&]
+      {
+         for (point_2 p : pts)
+         {
+            dh.add_point(p);
+            dh.get_hull();
+         }
+      });
+      sprintf(what, "dynamic_hull, %u insertions with queries", unsigned(n));
+      print_timing(what, ms);
+   }
+}
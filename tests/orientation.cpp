@@ -4,10 +4,12 @@
 
 #include <cg/primitives/contour.h>
 #include <cg/operations/orientation.h>
+#include <cg/operations/orientation_batch.h>
 #include <cg/convex_hull/graham.h>
 #include <misc/random_utils.h>
 
 #include "random_utils.h"
+#include "timer.h"
 
 using namespace util;
 
@@ -125,3 +127,125 @@ TEST(orientation, uniform1)
    }
 }
 
+static void near_line_triples(size_t count, std::vector<cg::point_2> & a, std::vector<cg::point_2> & b, std::vector<cg::point_2> & c)
+{
+   uniform_random_real<double, std::mt19937> distr(-(1LL << 53), (1LL << 53));
+
+   std::vector<cg::point_2> pts = uniform_points(count + 1);
+   for (size_t l = 0; l != count; ++l)
+   {
+      a.push_back(pts[l]);
+      b.push_back(pts[l + 1]);
+      c.push_back(pts[l] + distr() * (pts[l + 1] - pts[l]));
+   }
+}
+
+TEST(orientation_batch, uniform)
+{
+   for (size_t count = 0; count != 40; ++count)
+   {
+      std::vector<cg::point_2> a = uniform_points(count), b = uniform_points(count), c = uniform_points(count);
+      std::vector<cg::orientation_t> res(count);
+      cg::orientation_batch(a, b, c, res.data());
+
+      for (size_t l = 0; l != count; ++l)
+         EXPECT_EQ(cg::orientation(a[l], b[l], c[l]), res[l]);
+   }
+}
+
+TEST(orientation_batch, uniform_line)
+{
+   std::vector<cg::point_2> a, b, c;
+   near_line_triples(10001, a, b, c);
+
+   std::vector<cg::orientation_t> res(a.size());
+   cg::orientation_batch(a, b, c, res.data());
+
+   for (size_t l = 0; l != a.size(); ++l)
+      EXPECT_EQ(*cg::orientation_r()(a[l], b[l], c[l]), res[l]);
+}
+
+TEST(orientation_batch, benchmark)
+{
+   size_t const count = 1000000;
+
+   std::vector<cg::point_2> a = uniform_points(count), b = uniform_points(count), c = uniform_points(count);
+   std::vector<cg::orientation_t> scalar(count), batch(count);
+
+   print_timing("uniform, scalar", measure_ms([&] {
+      for (size_t l = 0; l != count; ++l)
+         scalar[l] = cg::orientation(a[l], b[l], c[l]);
+   }));
+   print_timing("uniform, batch", measure_ms([&] { cg::orientation_batch(a, b, c, batch.data()); }));
+   EXPECT_TRUE(scalar == batch);
+
+   size_t const degenerate_count = 100000;
+   a.clear(); b.clear(); c.clear();
+   near_line_triples(degenerate_count, a, b, c);
+   scalar.resize(degenerate_count);
+   batch.resize(degenerate_count);
+
+   print_timing("near line, scalar", measure_ms([&] {
+      for (size_t l = 0; l != degenerate_count; ++l)
+         scalar[l] = cg::orientation(a[l], b[l], c[l]);
+   }));
+   print_timing("near line, batch", measure_ms([&] { cg::orientation_batch(a, b, c, batch.data()); }));
+   EXPECT_TRUE(scalar == batch);
+}
+
+TEST(orientation_a, uniform_line)
+{
+   std::vector<cg::point_2> a, b, c;
+   near_line_triples(100000, a, b, c);
+
+   for (size_t l = 0; l != a.size(); ++l)
+   {
+      boost::optional<cg::orientation_t> res = cg::orientation_a()(a[l], b[l], c[l]);
+      ASSERT_TRUE(res);
+      EXPECT_EQ(*cg::orientation_r()(a[l], b[l], c[l]), *res);
+   }
+}
+
+TEST(orientation_a, grid)
+{
+   uniform_random_int<int, std::mt19937> distr(-1000, 1000);
+
+   for (size_t k = 0; k != 100000; ++k)
+   {
+      double step = 0.1;
+      cg::point_2 a(distr() * step, distr() * step);
+      cg::point_2 b(distr() * step, distr() * step);
+      cg::point_2 c = a + double(distr() % 7) * (b - a);
+
+      boost::optional<cg::orientation_t> res = cg::orientation_a()(a, b, c);
+      ASSERT_TRUE(res);
+      EXPECT_EQ(*cg::orientation_r()(a, b, c), *res);
+   }
+}
+
+TEST(orientation_a, out_of_range)
+{
+   using cg::point_2;
+
+   EXPECT_FALSE(cg::orientation_a()(point_2(0, 0), point_2(1e-300, 0), point_2(0, 1e-300)));
+   EXPECT_FALSE(cg::orientation_a()(point_2(0, 0), point_2(1e300, 0), point_2(0, 1e300)));
+   EXPECT_EQ(cg::CG_LEFT, cg::orientation(point_2(0, 0), point_2(1e-300, 0), point_2(0, 1e-300)));
+}
+
+TEST(orientation_a, benchmark)
+{
+   std::vector<cg::point_2> a, b, c;
+   near_line_triples(100000, a, b, c);
+
+   std::vector<cg::orientation_t> adaptive(a.size()), rational(a.size());
+
+   print_timing("near line, orientation_a", measure_ms([&] {
+      for (size_t l = 0; l != a.size(); ++l)
+         adaptive[l] = *cg::orientation_a()(a[l], b[l], c[l]);
+   }));
+   print_timing("near line, orientation_r", measure_ms([&] {
+      for (size_t l = 0; l != a.size(); ++l)
+         rational[l] = *cg::orientation_r()(a[l], b[l], c[l]);
+   }));
+   EXPECT_TRUE(adaptive == rational);
+}
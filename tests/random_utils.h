@@ -19,3 +19,57 @@ inline std::vector<cg::point_2t<Scalar>> uniform_points(size_t count, Scalar min
 
     return res;
 }
+
+template <class Scalar = double>
+inline std::vector<cg::point_2t<Scalar>> disk_points(size_t count, Scalar radius = 100)
+{
+    util::uniform_random_real<Scalar> rand(-radius, radius);
+
+    std::vector<cg::point_2t<Scalar>> res;
+    res.reserve(count);
+
+    while (res.size() != count)
+    {
+        cg::point_2t<Scalar> pt;
+        rand >> pt.x;
+        rand >> pt.y;
+        if (pt.x * pt.x + pt.y * pt.y <= radius * radius)
+            res.push_back(pt);
+    }
+
+    return res;
+}
+
+template <class Scalar = double>
+inline std::vector<cg::point_2t<Scalar>> normal_points(size_t count, Scalar sigma = 30)
+{
+    std::mt19937 generator((std::random_device())());
+    std::normal_distribution<Scalar> d(0, sigma);
+
+    std::vector<cg::point_2t<Scalar>> res(count);
+
+    for (size_t l = 0; l != count; ++l)
+    {
+        res[l].x = d(generator);
+        res[l].y = d(generator);
+    }
+
+    return res;
+}
+
+template <class Scalar = double>
+inline std::vector<cg::point_2t<Scalar>> circle_points(size_t count, Scalar radius = 100)
+{
+    util::uniform_random_real<Scalar> rand(0, 2 * M_PI);
+
+    std::vector<cg::point_2t<Scalar>> res(count);
+
+    for (size_t l = 0; l != count; ++l)
+    {
+        Scalar angle = rand();
+        res[l].x = radius * cos(angle);
+        res[l].y = radius * sin(angle);
+    }
+
+    return res;
+}
@@ -1,7 +1,18 @@
 #include <gtest/gtest.h>
 
 #include "random_utils.h"
+#include "timer.h"
+#include <thread>
+#include <atomic>
+#include <mutex>
+
 #include <cg/structures/skipquadtree.h>
+#include <cg/structures/concurrent_skipquadtree.h>
+#include <cg/structures/skipquadtree_snapshot.h>
+#include <cg/structures/linear_quadtree.h>
+#include <cg/structures/quadtree_regions.h>
+#include <sstream>
+#include <cstdio>
 
 #define COORD_RANGE 200
 #define WIDTH COORD_RANGE
@@ -41,7 +52,7 @@ TEST(skipquadtree_initialization_getContain, test1) {
     for (point_2f point : points) {
         tree.addPoint(point);
     }
-    auto rectPoints = uniform_points<float>(countOfGetContainsQueries);
+    auto rectPoints = uniform_points<float>(countOfGetContainsQueries, MIN_X, MAX_X);
     for (size_t i = 0; i < rectPoints.size() - 1; i++) {
         tree.getContainWithId(rectPoints[i], rectPoints[1], eps);
     }
@@ -77,7 +88,7 @@ TEST(skipquadtree_initialization_getContain, test2) {
     }
     points = makeUnique(points);
 
-    auto rectPoints = uniform_points<float>(countOfGetContainsQueries);
+    auto rectPoints = uniform_points<float>(countOfGetContainsQueries, MIN_X, MAX_X);
     for (size_t i = 0; i < rectPoints.size() - 1; i++) {
         std::list<point_2f> res = tree.getContain(rectPoints[i], rectPoints[i + 1], eps);
 
@@ -120,4 +131,1191 @@ TEST(skipquadtree_initialization_getContain, test2) {
             printf("[          ] Count of points on edge: %zu/%zu\n", countOfOnEdge, res.size());
         }
     }
-}
\ No newline at end of file
+}
+TEST(skipquadtree_arena, deleteAll) {
+    SkipQuadTree tree;
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(2000, MIN_X, MAX_X));
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    EXPECT_GE(tree.nodesCount(), points.size());
+
+    size_t bytesUsed = tree.bytesUsed();
+    for (point_2f point : points) {
+        EXPECT_TRUE(tree.deletePoint(point, 0));
+    }
+    EXPECT_EQ(0u, tree.nodesCount());
+    EXPECT_EQ(NULL_NODE, tree.lowDetailedRoot);
+    EXPECT_TRUE(tree.getContain(point_2f(MIN_X, MIN_Y), point_2f(MAX_X, MAX_Y), 0).empty());
+
+    // released slots are reused
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    EXPECT_EQ(points.size(), tree.getContain(point_2f(-200, -200), point_2f(200, 200), 0).size());
+    EXPECT_LE(tree.bytesUsed(), bytesUsed * 2);
+}
+
+TEST(skipquadtree_arena, clear) {
+    SkipQuadTree tree;
+    for (point_2f point : uniform_points<float>(10000, MIN_X, MAX_X)) {
+        tree.addPoint(point);
+    }
+    EXPECT_GT(tree.bytesUsed(), 0u);
+
+    tree.clear();
+    EXPECT_EQ(0u, tree.nodesCount());
+    EXPECT_EQ(0u, tree.bytesUsed());
+    EXPECT_EQ(1, tree.skipLevels);
+    EXPECT_TRUE(tree.getContain(point_2f(MIN_X, MIN_Y), point_2f(MAX_X, MAX_Y), 0).empty());
+
+    tree.addPoint(point_2f(1, 2));
+    tree.addPoint(point_2f(3, 4));
+    EXPECT_EQ(2u, tree.getContain(point_2f(0, 0), point_2f(5, 5), 0).size());
+}
+
+TEST(skipquadtree_arena, benchmark) {
+    for (size_t countOfPoints : {100000, 1000000}) {
+        std::vector<point_2f> points = uniform_points<float>(countOfPoints, MIN_X, MAX_X);
+
+        SkipQuadTree tree;
+        double ms = measure_ms([&] {
+            for (point_2f point : points) {
+                tree.addPoint(point);
+            }
+        });
+        printf("[          ] %zu points: build %.2f ms, %.1f bytes per point, %zu nodes, %d skip levels\n",
+                countOfPoints, ms, double(tree.bytesUsed()) / countOfPoints, tree.nodesCount(), tree.skipLevels);
+
+        std::vector<point_2f> corners = uniform_points<float>(2000, MIN_X, MAX_X);
+        size_t found = 0;
+        ms = measure_ms([&] {
+            for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+                found += tree.getContain(corners[i], point_2f(corners[i].x + 5, corners[i].y + 5), 0).size();
+            }
+        });
+        printf("[          ] %zu points: 1000 5x5 queries %.2f ms, %zu points found\n", countOfPoints, ms, found);
+    }
+}
+
+TEST(skipquadtree_streaming, sameAsGetContain) {
+    SkipQuadTree tree;
+    for (point_2f point : uniform_points<float>(10000, MIN_X, MAX_X)) {
+        tree.addPoint(point);
+    }
+
+    auto rectPoints = uniform_points<float>(200, MIN_X, MAX_X);
+    for (size_t i = 0; i + 1 < rectPoints.size(); i++) {
+        Range rect(std::min(rectPoints[i].x, rectPoints[i + 1].x), std::max(rectPoints[i].x, rectPoints[i + 1].x),
+                std::min(rectPoints[i].y, rectPoints[i + 1].y), std::max(rectPoints[i].y, rectPoints[i + 1].y));
+        float eps = (i % 2) ? 0.1 : 0;
+
+        std::list<std::pair<int, point_2f>> expectedWithIds = tree.getContainWithId(rect, eps);
+        std::vector<std::pair<int, point_2f>> withIds;
+        tree.forEachInRange(rect, eps, [&withIds](int id, point_2f point) {
+            withIds.push_back(std::make_pair(id, point));
+        });
+        EXPECT_TRUE(std::equal(withIds.begin(), withIds.end(), expectedWithIds.begin()));
+        EXPECT_EQ(expectedWithIds.size(), withIds.size());
+
+        std::vector<point_2f> points;
+        tree.queryInto(rect, eps, std::back_inserter(points));
+        EXPECT_EQ(withIds.size(), points.size());
+        for (size_t j = 0; j < points.size(); j++) {
+            EXPECT_EQ(withIds[j].second, points[j]);
+        }
+
+        EXPECT_EQ(points.size(), tree.countInRange(rect, eps));
+    }
+}
+
+TEST(skipquadtree_streaming, benchmark) {
+    SkipQuadTree tree;
+    for (point_2f point : uniform_points<float>(1000000, MIN_X, MAX_X)) {
+        tree.addPoint(point);
+    }
+
+    // a viewport with about 100k points
+    Range viewport(-30, 30, -30, 30);
+    size_t queries = 10;
+    size_t found = 0;
+
+    double ms = measure_ms([&] {
+        for (size_t i = 0; i < queries; i++) {
+            found += tree.getContain(viewport, 0).size();
+        }
+    });
+    printf("[          ] getContain: %.2f ms per query, %zu points\n", ms / queries, found / queries);
+
+    std::vector<point_2f> buffer;
+    buffer.reserve(found / queries);
+    ms = measure_ms([&] {
+        for (size_t i = 0; i < queries; i++) {
+            buffer.clear();
+            tree.queryInto(viewport, 0, std::back_inserter(buffer));
+        }
+    });
+    printf("[          ] queryInto: %.2f ms per query\n", ms / queries);
+    EXPECT_EQ(found / queries, buffer.size());
+
+    size_t count = 0;
+    ms = measure_ms([&] {
+        for (size_t i = 0; i < queries; i++) {
+            count = tree.countInRange(viewport, 0);
+        }
+    });
+    printf("[          ] countInRange: %.2f ms per query\n", ms / queries);
+    EXPECT_EQ(found / queries, count);
+}
+
+std::vector<point_2f> bruteForceContain(std::vector<point_2f> const &points, Range rect) {
+    std::vector<point_2f> result;
+    for (point_2f point : points) {
+        if (point.x >= rect.fromX && point.x < rect.toX && point.y >= rect.fromY && point.y < rect.toY) {
+            result.push_back(point);
+        }
+    }
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+template<class Tree>
+void expectSameAsBruteForce(Tree const &tree, std::vector<point_2f> const &points, size_t countOfQueries) {
+    auto rectPoints = uniform_points<float>(countOfQueries + 1, MIN_X, MAX_X);
+    for (size_t i = 0; i < countOfQueries; i++) {
+        Range rect(std::min(rectPoints[i].x, rectPoints[i + 1].x), std::max(rectPoints[i].x, rectPoints[i + 1].x),
+                std::min(rectPoints[i].y, rectPoints[i + 1].y), std::max(rectPoints[i].y, rectPoints[i + 1].y));
+        std::vector<point_2f> found;
+        tree.queryInto(rect, 0, std::back_inserter(found));
+        std::sort(found.begin(), found.end());
+        EXPECT_EQ(bruteForceContain(points, rect), found);
+    }
+}
+
+TEST(skipquadtree_build, sameAsBruteForce) {
+    std::vector<point_2f> points = uniform_points<float>(20000, MIN_X, MAX_X);
+    // duplicates and a dense cluster
+    points.insert(points.end(), points.begin(), points.begin() + 1000);
+    for (int i = 0; i < 1000; i++) {
+        points.push_back(point_2f(1 + i * 1e-4f, 1 - i * 1e-4f));
+    }
+
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    EXPECT_GT(tree.skipLevels, 1);
+    expectSameAsBruteForce(tree, points, 100);
+    EXPECT_EQ(bruteForceContain(points, Range(-200, 200, -200, 200)).size(), tree.countInRange(Range(-200, 200, -200, 200), 0));
+}
+
+TEST(skipquadtree_build, deterministic) {
+    std::vector<point_2f> points = uniform_points<float>(50000, MIN_X, MAX_X);
+
+    SkipQuadTree serial, parallel, other;
+    serial.build(points.begin(), points.end(), 42);
+    parallel.build(points.begin(), points.end(), 42, 4);
+    other.build(points.begin(), points.end(), 43);
+
+    EXPECT_EQ(serial.skipLevels, parallel.skipLevels);
+    EXPECT_EQ(serial.nodesCount(), parallel.nodesCount());
+
+    Range all(-200, 200, -200, 200);
+    std::vector<point_2f> serialOrder, parallelOrder;
+    serial.queryInto(all, 0, std::back_inserter(serialOrder));
+    parallel.queryInto(all, 0, std::back_inserter(parallelOrder));
+    EXPECT_EQ(serialOrder, parallelOrder);
+    EXPECT_EQ(points.size(), serialOrder.size());
+
+    EXPECT_NE(serial.nodesCount(), other.nodesCount());
+}
+
+TEST(skipquadtree_build, updatesAfterBuild) {
+    std::vector<point_2f> points = uniform_points<float>(10000, MIN_X, MAX_X);
+
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+
+    std::vector<point_2f> rest(points.begin() + points.size() / 2, points.end());
+    for (size_t i = 0; i < points.size() / 2; i++) {
+        EXPECT_TRUE(tree.deletePoint(points[i], 0));
+    }
+    std::vector<point_2f> added = uniform_points<float>(5000, MIN_X, MAX_X);
+    for (point_2f point : added) {
+        tree.addPoint(point);
+    }
+    rest.insert(rest.end(), added.begin(), added.end());
+
+    expectSameAsBruteForce(tree, rest, 100);
+}
+
+TEST(skipquadtree_build, benchmark) {
+    for (size_t countOfPoints : {100000, 1000000}) {
+        std::vector<point_2f> points = uniform_points<float>(countOfPoints, MIN_X, MAX_X);
+
+        SkipQuadTree incremental;
+        double ms = measure_ms([&] {
+            for (point_2f point : points) {
+                incremental.addPoint(point);
+            }
+        });
+        printf("[          ] %zu points: addPoint %.2f ms\n", countOfPoints, ms);
+
+        for (size_t threads : {1, 4}) {
+            SkipQuadTree bulk;
+            ms = measure_ms([&] {
+                bulk.build(points.begin(), points.end(), 239, threads);
+            });
+            printf("[          ] %zu points: build, %zu threads %.2f ms\n", countOfPoints, threads, ms);
+            EXPECT_EQ(countOfPoints, bulk.countInRange(Range(-200, 200, -200, 200), 0));
+        }
+    }
+}
+
+std::vector<double> bruteForceNearestDistances(std::vector<point_2f> const &points, point_2f query, size_t k) {
+    std::vector<double> distances;
+    for (point_2f point : points) {
+        distances.push_back(squaredDistance(point, query));
+    }
+    std::sort(distances.begin(), distances.end());
+    distances.resize(std::min(k, distances.size()));
+    return distances;
+}
+
+std::vector<double> distancesTo(std::vector<point_2f> const &points, point_2f query) {
+    std::vector<double> distances;
+    for (point_2f point : points) {
+        distances.push_back(squaredDistance(point, query));
+    }
+    return distances;
+}
+
+TEST(skipquadtree_nearest, sameAsBruteForce) {
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(3000, MIN_X, MAX_X));
+    SkipQuadTree tree;
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+
+    // some queries lie outside of the root
+    auto queries = uniform_points<float>(300, -150, 150);
+    for (size_t k : {1, 5, 20}) {
+        for (point_2f query : queries) {
+            EXPECT_EQ(bruteForceNearestDistances(points, query, k), distancesTo(tree.nearest(query, k), query));
+        }
+    }
+
+    EXPECT_EQ(points.size(), tree.nearest(point_2f(0, 0), points.size() + 10).size());
+    EXPECT_TRUE(tree.nearest(point_2f(0, 0), 0).empty());
+    EXPECT_TRUE(SkipQuadTree().nearest(point_2f(0, 0), 3).empty());
+}
+
+TEST(skipquadtree_nearest, approx) {
+    std::vector<point_2f> points = uniform_points<float>(20000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+
+    point_2f result;
+    EXPECT_FALSE(SkipQuadTree().approxNearest(point_2f(0, 0), 0.1, result));
+
+    auto queries = uniform_points<float>(1000, MIN_X, MAX_X);
+    for (float epsilon : {0.f, 0.1f, 1.f}) {
+        for (point_2f query : queries) {
+            ASSERT_TRUE(tree.approxNearest(query, epsilon, result));
+            double best = squaredDistance(tree.nearest(query, 1)[0], query);
+            EXPECT_LE(squaredDistance(result, query), best * (1 + epsilon) * (1 + epsilon));
+        }
+    }
+}
+
+TEST(skipquadtree_nearest, batch) {
+    std::vector<point_2f> points = uniform_points<float>(20000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+
+    auto queries = uniform_points<float>(2000, MIN_X, MAX_X);
+    size_t k = 8;
+    std::vector<point_2f> result;
+    tree.nearest(queries, k, result);
+    ASSERT_EQ(queries.size() * k, result.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        std::vector<point_2f> single = tree.nearest(queries[i], k);
+        std::vector<point_2f> batched(result.begin() + i * k, result.begin() + (i + 1) * k);
+        EXPECT_EQ(distancesTo(single, queries[i]), distancesTo(batched, queries[i]));
+    }
+
+    // fewer points than k, the previous neighbours bound nothing
+    SkipQuadTree small;
+    small.build(points.begin(), points.begin() + 5);
+    small.nearest(queries, k, result);
+    ASSERT_EQ(queries.size() * 5, result.size());
+    for (size_t i = 0; i < queries.size(); i++) {
+        std::vector<point_2f> batched(result.begin() + i * 5, result.begin() + (i + 1) * 5);
+        EXPECT_EQ(distancesTo(small.nearest(queries[i], k), queries[i]), distancesTo(batched, queries[i]));
+    }
+}
+
+TEST(skipquadtree_nearest, benchmark) {
+    std::vector<point_2f> points = uniform_points<float>(1000000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+
+    auto queries = uniform_points<float>(100000, MIN_X, MAX_X);
+    size_t k = 8;
+
+    double checksum = 0;
+    double ms = measure_ms([&] {
+        for (size_t i = 0; i < 20; i++) {
+            checksum += bruteForceNearestDistances(points, queries[i], k).back();
+        }
+    });
+    printf("[          ] brute force, k=%zu: %.0f queries per second\n", k, 20 / ms * 1000);
+
+    ms = measure_ms([&] {
+        for (point_2f query : queries) {
+            checksum += tree.nearest(query, k).size();
+        }
+    });
+    printf("[          ] nearest, k=%zu: %.0f queries per second\n", k, queries.size() / ms * 1000);
+
+    std::vector<point_2f> result;
+    ms = measure_ms([&] {
+        tree.nearest(queries, k, result);
+    });
+    printf("[          ] batched nearest, k=%zu: %.0f queries per second\n", k, queries.size() / ms * 1000);
+
+    ms = measure_ms([&] {
+        tree.nearest(queries, 1, result);
+    });
+    printf("[          ] batched nearest, k=1: %.0f queries per second\n", queries.size() / ms * 1000);
+
+    for (float epsilon : {0.f, 0.5f}) {
+        point_2f found;
+        ms = measure_ms([&] {
+            for (point_2f query : queries) {
+                tree.approxNearest(query, epsilon, found);
+                checksum += found.x;
+            }
+        });
+        printf("[          ] approxNearest, epsilon=%.1f: %.0f queries per second\n", epsilon, queries.size() / ms * 1000);
+    }
+    EXPECT_NE(0, checksum);
+}
+
+TEST(skipquadtree_concurrent, sameAsBruteForce) {
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(5000, MIN_X, MAX_X));
+    ConcurrentSkipQuadTree tree;
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    size_t initialNodes = tree.nodesCount();
+    auto queries = uniform_points<float>(200, MIN_X, MAX_X);
+    for (size_t i = 0; i + 1 < queries.size(); i += 2) {
+        Range rect(-239,
+                std::min(queries[i].x, queries[i + 1].x), std::max(queries[i].x, queries[i + 1].x),
+                std::min(queries[i].y, queries[i + 1].y), std::max(queries[i].y, queries[i + 1].y));
+        std::vector<point_2f> expected = bruteForceContain(points, rect);
+        std::list<point_2f> found = tree.getContain(rect, 0);
+        std::vector<point_2f> actual(found.begin(), found.end());
+        std::sort(actual.begin(), actual.end());
+        EXPECT_EQ(expected, actual);
+        EXPECT_EQ(expected.size(), tree.getContainWithId(rect, 0).size());
+    }
+
+    // deleted slots are reused once no reader can see them
+    for (size_t round = 0; round < 3; round++) {
+        for (size_t i = 2; i < points.size(); i++) {
+            EXPECT_TRUE(tree.deletePoint(points[i], 0));
+        }
+        EXPECT_EQ(2u, tree.countInRange(Range(-239, -200, 200, -200, 200), 0));
+        for (size_t i = 2; i < points.size(); i++) {
+            tree.addPoint(points[i]);
+        }
+        EXPECT_EQ(points.size(), tree.countInRange(Range(-239, -200, 200, -200, 200), 0));
+    }
+    EXPECT_LT(tree.nodesCount(), 2 * initialNodes);
+
+    for (point_2f point : points) {
+        EXPECT_TRUE(tree.deletePoint(point, 0));
+    }
+    EXPECT_EQ(0u, tree.countInRange(Range(-239, -200, 200, -200, 200), 0));
+}
+
+TEST(skipquadtree_concurrent, readersAndWriters) {
+    // readers count the stable points in the left half while writers change the right half
+    std::vector<point_2f> stable = makeUnique(uniform_points<float>(5000, -100, -1));
+    std::vector<point_2f> changing = makeUnique(uniform_points<float>(5000, 1, 99));
+    ConcurrentSkipQuadTree tree;
+    tree.addPoint(point_2f(-128, -128));
+    tree.addPoint(point_2f(128, 128));
+    for (point_2f point : stable) {
+        tree.addPoint(point);
+    }
+    Range left(-239, -100, 0, -100, 100);
+    Range right(-239, 0, 100, -100, 100);
+
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> failures(0);
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < 3; r++) {
+        readers.push_back(std::thread([&] {
+            while (!stop) {
+                if (tree.countInRange(left, 0) != stable.size() || tree.countInRange(right, 0) > changing.size()) {
+                    failures++;
+                }
+            }
+        }));
+    }
+    std::vector<std::thread> writers;
+    for (size_t w = 0; w < 2; w++) {
+        writers.push_back(std::thread([&, w] {
+            for (size_t round = 0; round < 5; round++) {
+                for (size_t i = w; i < changing.size(); i += 2) {
+                    tree.addPoint(changing[i]);
+                }
+                for (size_t i = w; i < changing.size(); i += 2) {
+                    tree.deletePoint(changing[i], 0);
+                }
+            }
+            for (size_t i = w; i < changing.size(); i += 2) {
+                tree.addPoint(changing[i]);
+            }
+        }));
+    }
+    for (std::thread &writer : writers) {
+        writer.join();
+    }
+    stop = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0u, failures.load());
+    EXPECT_EQ(stable.size(), tree.countInRange(left, 0));
+    EXPECT_EQ(changing.size(), tree.countInRange(right, 0));
+}
+
+TEST(skipquadtree_concurrent, moreReadersThanSlots) {
+    // the readers without a slot keep the deleted nodes from being reused until they finish
+    std::vector<point_2f> stable = makeUnique(uniform_points<float>(1000, -100, -1));
+    std::vector<point_2f> changing = makeUnique(uniform_points<float>(1000, 1, 99));
+    ConcurrentSkipQuadTree tree;
+    for (point_2f point : stable) {
+        tree.addPoint(point);
+    }
+    Range left(-239, -100, 0, -100, 100);
+
+    size_t readersCount = EPOCH_MAX_THREADS + 16;
+    std::atomic<size_t> started(0);
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> failures(0);
+    std::vector<std::thread> readers;
+    for (size_t r = 0; r < readersCount; r++) {
+        readers.push_back(std::thread([&] {
+            // every reader holds its index until all of them have read
+            failures += tree.countInRange(left, 0) != stable.size();
+            started++;
+            while (!stop) {
+                failures += tree.countInRange(left, 0) != stable.size();
+                std::this_thread::yield();
+            }
+        }));
+    }
+    while (started != readersCount) {
+        std::this_thread::yield();
+    }
+    for (size_t round = 0; round < 3; round++) {
+        for (point_2f point : changing) {
+            tree.addPoint(point);
+        }
+        for (point_2f point : changing) {
+            EXPECT_TRUE(tree.deletePoint(point, 0));
+        }
+    }
+    stop = true;
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(0u, failures.load());
+    EXPECT_EQ(stable.size(), tree.countInRange(Range(-239, -200, 200, -200, 200), 0));
+}
+
+// Runs readers threads of range queries and one thread of updates for a while,
+// returns the counts of queries and updates done.
+template<class Query, class Update>
+std::pair<size_t, size_t> runReadWriteMix(size_t readers, Query query, Update update) {
+    std::atomic<bool> stop(false);
+    std::atomic<size_t> reads(0);
+    std::atomic<size_t> writes(0);
+    std::vector<std::thread> threads;
+    for (size_t r = 0; r < readers; r++) {
+        threads.push_back(std::thread([&, r] {
+            auto rects = uniform_points<float>(1024, MIN_X, MAX_X);
+            size_t done = 0;
+            size_t checksum = 0;
+            while (!stop) {
+                point_2f corner = rects[(done + r * 31) % rects.size()];
+                checksum += query(Range(-239, corner.x, corner.x + 2, corner.y, corner.y + 2));
+                done++;
+            }
+            reads += done + (checksum == size_t(-1));
+        }));
+    }
+    threads.push_back(std::thread([&] {
+        auto updates = uniform_points<float>(4096, MIN_X, MAX_X);
+        size_t done = 0;
+        while (!stop) {
+            update(updates[(done / 2) % updates.size()], done % 2 == 0);
+            done++;
+        }
+        writes += done;
+    }));
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    stop = true;
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+    return std::make_pair(reads.load(), writes.load());
+}
+
+TEST(skipquadtree_concurrent, benchmark) {
+    std::vector<point_2f> points = uniform_points<float>(200000, MIN_X, MAX_X);
+    ConcurrentSkipQuadTree concurrentTree;
+    SkipQuadTree lockedTree;
+    std::mutex lock;
+    for (point_2f point : points) {
+        concurrentTree.addPoint(point);
+        lockedTree.addPoint(point);
+    }
+
+    printf("[          ] hardware threads: %u\n", std::thread::hardware_concurrency());
+    for (size_t readers : {1, 2, 4, 8}) {
+        auto concurrent = runReadWriteMix(readers, [&](Range rect) {
+            return concurrentTree.countInRange(rect, 0);
+        }, [&](point_2f point, bool add) {
+            add ? concurrentTree.addPoint(point) : concurrentTree.deletePoint(point, 0);
+        });
+        auto locked = runReadWriteMix(readers, [&](Range rect) {
+            std::lock_guard<std::mutex> guard(lock);
+            return lockedTree.countInRange(rect, 0);
+        }, [&](point_2f point, bool add) {
+            std::lock_guard<std::mutex> guard(lock);
+            add ? lockedTree.addPoint(point) : lockedTree.deletePoint(point, 0);
+        });
+        printf("[          ] %zu readers + 1 writer: concurrent %.0f reads/s %.0f writes/s, "
+                "mutex %.0f reads/s %.0f writes/s\n",
+                readers, concurrent.first * 2., concurrent.second * 2., locked.first * 2., locked.second * 2.);
+    }
+}
+
+TEST(skipquadtree_cells, growingRoot) {
+    // points far apart in every order: the root is rebuilt many times
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(3000, -1e6, 1e6));
+    std::vector<point_2f> near = uniform_points<float>(3000, -1e-3, 1e-3);
+    points.insert(points.end(), near.begin(), near.end());
+    points = makeUnique(points);
+    SkipQuadTree tree;
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    Range everything(-2e6f, 2e6f, -2e6f, 2e6f);
+    EXPECT_EQ(points.size(), tree.countInRange(everything, 0));
+    for (Range rect : {Range(-1e-4f, 1e-4f, -1e-3f, 1e-3f), Range(-5e5f, 3e5f, 1e5f, 9e5f)}) {
+        std::vector<point_2f> found;
+        tree.queryInto(rect, 0, std::back_inserter(found));
+        std::sort(found.begin(), found.end());
+        EXPECT_EQ(bruteForceContain(points, rect), found);
+    }
+
+    for (size_t i = 0; i < points.size(); i += 2) {
+        EXPECT_TRUE(tree.deletePoint(points[i], 0));
+    }
+    EXPECT_EQ(points.size() / 2, tree.countInRange(everything, 0));
+    for (size_t i = 1; i < points.size(); i += 2) {
+        EXPECT_TRUE(tree.deletePoint(points[i], 0));
+    }
+    EXPECT_EQ(0u, tree.nodesCount());
+}
+
+TEST(skipquadtree_cells, signedZeroAndExtremes) {
+    float max = std::numeric_limits<float>::max();
+    float min = std::numeric_limits<float>::denorm_min();
+    std::vector<point_2f> points = {point_2f(0, 0), point_2f(-min, min), point_2f(min, -min),
+            point_2f(max, -max), point_2f(-max, max), point_2f(1, -1), point_2f(-1, 1)};
+    SkipQuadTree tree;
+    for (point_2f point : points) {
+        EXPECT_TRUE(tree.addPoint(point));
+    }
+    // -0 is the same point as 0
+    tree.addPoint(point_2f(-0.f, -0.f));
+    EXPECT_EQ(points.size(), tree.countInRange(Range(-max, max, -max, max), 0) + 2);
+    EXPECT_EQ(3u, tree.countInRange(Range(-min, 2 * min, -min, 2 * min), 0));
+    EXPECT_EQ(1u, tree.countInRange(Range(-0.f, min, -0.f, min), 0));
+    EXPECT_EQ(1u, tree.nearest(point_2f(1e30f, -1e30f), 1).size());
+    EXPECT_EQ(point_2f(max, -max), tree.nearest(point_2f(3e38f, -3e38f), 1)[0]);
+}
+
+TEST(skipquadtree_cells, intCoordinates) {
+    std::vector<cg::point_2i> points;
+    for (int x = -50; x < 50; x += 7) {
+        for (int y = -50; y < 50; y += 3) {
+            points.push_back(cg::point_2i(x * 1000, y));
+        }
+    }
+    points.push_back(cg::point_2i(std::numeric_limits<int>::min(), std::numeric_limits<int>::max()));
+    SkipQuadTreeT<int> tree;
+    for (cg::point_2i point : points) {
+        EXPECT_TRUE(tree.addPoint(point));
+    }
+    EXPECT_EQ(points.size() - 1, tree.countInRange(RangeT<int>(-100000, 100000, -100, 100), 0));
+    for (int from = -60000; from < 60000; from += 9000) {
+        RangeT<int> rect(from, from + 20000, -20, 11);
+        size_t expected = 0;
+        for (cg::point_2i point : points) {
+            expected += point.x >= rect.fromX && point.x < rect.toX && point.y >= rect.fromY && point.y < rect.toY;
+        }
+        EXPECT_EQ(expected, tree.countInRange(rect, 0));
+    }
+    EXPECT_EQ(cg::point_2i(-1000, 1), tree.nearest(cg::point_2i(-1100, 2), 1)[0]);
+
+    SkipQuadTreeT<int> bulk;
+    bulk.build(points.begin(), points.end());
+    EXPECT_EQ(tree.countInRange(RangeT<int>(-7000, 7000, -7, 7), 0), bulk.countInRange(RangeT<int>(-7000, 7000, -7, 7), 0));
+    for (cg::point_2i point : points) {
+        EXPECT_TRUE(bulk.deletePoint(point, 0));
+    }
+    EXPECT_EQ(0u, bulk.nodesCount());
+}
+
+TEST(skipquadtree_cells, benchmark) {
+    // the same workload as skipquadtree_arena.benchmark over a wider and a much narrower spread
+    for (float spread : {1e5f, 1e-2f}) {
+        std::vector<point_2f> points = uniform_points<float>(1000000, -spread, spread);
+        SkipQuadTree tree;
+        double ms = measure_ms([&] {
+            for (point_2f point : points) {
+                tree.addPoint(point);
+            }
+        });
+        printf("[          ] 1000000 points in +-%g: build %.2f ms, %zu nodes\n", spread, ms, tree.nodesCount());
+
+        std::vector<point_2f> corners = uniform_points<float>(2000, -spread, spread);
+        float side = spread / 40;
+        size_t found = 0;
+        ms = measure_ms([&] {
+            for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+                found += tree.countInRange(Range(corners[i].x, corners[i].x + side, corners[i].y, corners[i].y + side), 0);
+            }
+        });
+        printf("[          ] 1000 queries %.2f ms, %zu points found\n", ms, found);
+    }
+}
+
+std::string snapshotImage(SkipQuadTree const &tree) {
+    std::ostringstream os;
+    writeSnapshot(tree, os);
+    return os.str();
+}
+
+TEST(skipquadtree_snapshot, sameAsTree) {
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(20000, MIN_X, MAX_X));
+    SkipQuadTree tree;
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    // released slots are not written
+    for (size_t i = 0; i < points.size(); i += 3) {
+        tree.deletePoint(points[i], 0);
+    }
+
+    std::string path = testing::TempDir() + "skipquadtree_snapshot.bin";
+    saveSnapshot(tree, path);
+    MappedFile file(path);
+    std::remove(path.c_str());
+    SkipQuadTreeSnapshot snapshot(file.data(), file.size());
+    EXPECT_EQ(tree.nodesCount(), snapshot.nodesCount());
+    EXPECT_EQ(tree.skipLevels, snapshot.skipLevels());
+
+    // the image does not depend on where it lies
+    std::vector<uint64_t> moved(file.size() / 8);
+    std::memcpy(&moved[0], file.data(), file.size());
+    SkipQuadTreeSnapshot movedSnapshot(&moved[0], file.size());
+
+    auto corners = uniform_points<float>(200, MIN_X, MAX_X);
+    for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+        Range rect(std::min(corners[i].x, corners[i + 1].x), std::max(corners[i].x, corners[i + 1].x),
+                std::min(corners[i].y, corners[i + 1].y), std::max(corners[i].y, corners[i + 1].y));
+        std::vector<point_2f> expected, found, foundMoved;
+        tree.queryInto(rect, 0.5f, std::back_inserter(expected));
+        snapshot.queryInto(rect, 0.5f, std::back_inserter(found));
+        movedSnapshot.queryInto(rect, 0.5f, std::back_inserter(foundMoved));
+        std::sort(expected.begin(), expected.end());
+        std::sort(found.begin(), found.end());
+        std::sort(foundMoved.begin(), foundMoved.end());
+        EXPECT_EQ(expected, found);
+        EXPECT_EQ(expected, foundMoved);
+    }
+}
+
+TEST(skipquadtree_snapshot, smallTrees) {
+    SkipQuadTree tree;
+    std::string image = snapshotImage(tree);
+    std::vector<uint64_t> buffer(image.size() / 8);
+    std::memcpy(&buffer[0], image.data(), image.size());
+    EXPECT_EQ(0u, SkipQuadTreeSnapshot(&buffer[0], image.size()).countInRange(Range(-1, 1, -1, 1), 0));
+
+    tree.addPoint(point_2f(0.5f, 0.5f));
+    image = snapshotImage(tree);
+    buffer.resize(image.size() / 8);
+    std::memcpy(&buffer[0], image.data(), image.size());
+    EXPECT_EQ(1u, SkipQuadTreeSnapshot(&buffer[0], image.size()).countInRange(Range(-1, 1, -1, 1), 0));
+
+    SkipQuadTreeT<int> intTree;
+    intTree.addPoint(cg::point_2i(1, 2));
+    intTree.addPoint(cg::point_2i(-1, 5));
+    std::ostringstream os;
+    writeSnapshot(intTree, os);
+    image = os.str();
+    buffer.resize(image.size() / 8);
+    std::memcpy(&buffer[0], image.data(), image.size());
+    EXPECT_EQ(2u, SkipQuadTreeSnapshotT<int>(&buffer[0], image.size()).countInRange(RangeT<int>(-1, 2, 0, 6), 0));
+}
+
+TEST(skipquadtree_snapshot, rejectsBadImages) {
+    SkipQuadTree tree;
+    for (point_2f point : uniform_points<float>(100, MIN_X, MAX_X)) {
+        tree.addPoint(point);
+    }
+    std::string image = snapshotImage(tree);
+    std::vector<uint64_t> buffer(image.size() / 8);
+    std::memcpy(&buffer[0], image.data(), image.size());
+
+    EXPECT_THROW(SkipQuadTreeSnapshot(&buffer[0], image.size() - 8), std::runtime_error);
+    EXPECT_THROW(SkipQuadTreeSnapshotT<int>(&buffer[0], image.size()), std::runtime_error);
+    EXPECT_THROW(SkipQuadTreeSnapshot(reinterpret_cast<char *>(&buffer[0]) + 4, image.size() - 8), std::runtime_error);
+
+    // links out of the arrays or leading back
+    SnapshotHeader const &header = *reinterpret_cast<SnapshotHeader const *>(&buffer[0]);
+    MiddleNode *middles = reinterpret_cast<MiddleNode *>(reinterpret_cast<char *>(&buffer[0]) + header.middleOffset);
+    ASSERT_LT(1u, header.middleCount);
+    MiddleNode saved = middles[0];
+    for (NodeRef bad : {NodeRef(header.middleCount), NodeRef(header.termCount) | TERM_NODE_BIT, NodeRef(0)}) {
+        middles[0].children[middles[0].children[0] == NULL_NODE ? 1 : 0] = bad;
+        EXPECT_THROW(SkipQuadTreeSnapshot(&buffer[0], image.size()), std::runtime_error);
+        middles[0] = saved;
+        middles[0].linkToMoreDetailed = bad;
+        EXPECT_THROW(SkipQuadTreeSnapshot(&buffer[0], image.size()), std::runtime_error);
+        middles[0] = saved;
+    }
+    EXPECT_EQ(100u, SkipQuadTreeSnapshot(&buffer[0], image.size()).countInRange(Range(-239, -200, 200, -200, 200), 0));
+
+    reinterpret_cast<SnapshotHeader *>(&buffer[0])->version++;
+    EXPECT_THROW(SkipQuadTreeSnapshot(&buffer[0], image.size()), std::runtime_error);
+    reinterpret_cast<char *>(&buffer[0])[0] = 'X';
+    EXPECT_THROW(SkipQuadTreeSnapshot(&buffer[0], image.size()), std::runtime_error);
+    EXPECT_THROW(MappedFile(testing::TempDir() + "no_such_snapshot.bin"), std::runtime_error);
+}
+
+TEST(skipquadtree_snapshot, benchmark) {
+    std::vector<point_2f> points = uniform_points<float>(1000000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    double rebuildMs = measure_ms([&] {
+        tree.build(points.begin(), points.end());
+    });
+
+    std::string path = testing::TempDir() + "skipquadtree_snapshot_benchmark.bin";
+    double saveMs = measure_ms([&] {
+        saveSnapshot(tree, path);
+    });
+    size_t count = 0;
+    double mapMs = measure_ms([&] {
+        MappedFile file(path);
+        SkipQuadTreeSnapshot snapshot(file.data(), file.size());
+        count = snapshot.nodesCount();
+    });
+    printf("[          ] 1000000 points: rebuild %.2f ms, save %.2f ms, map %.3f ms, %zu nodes\n",
+            rebuildMs, saveMs, mapMs, count);
+
+    MappedFile file(path);
+    std::remove(path.c_str());
+    SkipQuadTreeSnapshot snapshot(file.data(), file.size());
+    printf("[          ] image %.1f bytes per point, tree %.1f bytes per point\n",
+            double(file.size()) / points.size(), double(tree.bytesUsed()) / points.size());
+
+    std::vector<point_2f> corners = uniform_points<float>(20000, MIN_X, MAX_X);
+    size_t inTree = 0, inSnapshot = 0;
+    double treeMs = measure_ms([&] {
+        for (point_2f corner : corners) {
+            inTree += tree.countInRange(Range(corner.x, corner.x + 5, corner.y, corner.y + 5), 0);
+        }
+    });
+    // the first queries also fault the pages in
+    double snapshotMs = measure_ms([&] {
+        for (point_2f corner : corners) {
+            inSnapshot += snapshot.countInRange(Range(corner.x, corner.x + 5, corner.y, corner.y + 5), 0);
+        }
+    });
+    EXPECT_EQ(inTree, inSnapshot);
+    printf("[          ] 20000 5x5 queries: tree %.2f ms, mapped snapshot %.2f ms\n", treeMs, snapshotMs);
+}
+
+TEST(skipquadtree_batch, insertBatch) {
+    std::vector<point_2f> points = uniform_points<float>(20000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    EXPECT_EQ(1u, tree.insertBatch(points.begin(), points.begin() + 1));
+    EXPECT_EQ(9999u, tree.insertBatch(points.begin(), points.begin() + 10000));
+    // duplicates, points of the tree and points far out of its root
+    std::vector<point_2f> batch(points.begin() + 5000, points.end());
+    batch.insert(batch.end(), points.begin() + 12000, points.begin() + 13000);
+    for (int i = 0; i < 100; i++) {
+        batch.push_back(point_2f(MAX_X * 50 + i, MIN_Y * 70 - i));
+    }
+    EXPECT_EQ(10100u, tree.insertBatch(batch.begin(), batch.end()));
+    points.insert(points.end(), batch.begin(), batch.end());
+    points = makeUnique(points);
+    EXPECT_GT(tree.skipLevels, 1);
+
+    expectSameAsBruteForce(tree, points, 300);
+    EXPECT_EQ(points.size(), tree.countInRange(Range(-1e6f, 1e6f, -1e6f, 1e6f), 0));
+    for (point_2f point : points) {
+        ASSERT_TRUE(tree.deletePoint(point, 0));
+    }
+    EXPECT_EQ(0u, tree.nodesCount());
+}
+
+TEST(skipquadtree_batch, eraseBatch) {
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(20000, MIN_X, MAX_X));
+    SkipQuadTree tree;
+    tree.insertBatch(points.begin(), points.end());
+
+    std::vector<point_2f> erased(points.begin(), points.begin() + 5000);
+    erased.push_back(point_2f(MAX_X * 2, MAX_Y * 2));
+    EXPECT_EQ(5000u, tree.eraseBatch(erased.begin(), erased.end(), 0));
+    points.erase(points.begin(), points.begin() + 5000);
+    expectSameAsBruteForce(tree, points, 200);
+
+    // every point within eps is deleted
+    float eps = 2;
+    std::vector<point_2f> queries = uniform_points<float>(300, MIN_X, MAX_X);
+    std::vector<point_2f> left;
+    for (point_2f point : points) {
+        bool near = false;
+        for (point_2f query : queries) {
+            near |= std::abs(point.x - query.x) <= eps && std::abs(point.y - query.y) <= eps;
+        }
+        if (!near) {
+            left.push_back(point);
+        }
+    }
+    EXPECT_EQ(points.size() - left.size(), tree.eraseBatch(queries.begin(), queries.end(), eps));
+    expectSameAsBruteForce(tree, left, 200);
+
+    EXPECT_EQ(left.size(), tree.eraseBatch(left.begin(), left.end(), 0));
+    EXPECT_EQ(0u, tree.nodesCount());
+    EXPECT_EQ(NULL_NODE, tree.lowDetailedRoot);
+    EXPECT_EQ(1, tree.skipLevels);
+}
+
+TEST(skipquadtree_batch, eraseIn) {
+    std::vector<point_2f> points = makeUnique(uniform_points<float>(20000, MIN_X, MAX_X));
+    std::sort(points.begin(), points.end());
+    SkipQuadTree tree;
+    for (point_2f point : points) {
+        tree.addPoint(point);
+    }
+    auto corners = uniform_points<float>(40, MIN_X, MAX_X);
+    for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+        Range rect(std::min(corners[i].x, corners[i + 1].x), std::max(corners[i].x, corners[i + 1].x),
+                std::min(corners[i].y, corners[i + 1].y), std::max(corners[i].y, corners[i + 1].y));
+        std::vector<point_2f> inside = bruteForceContain(points, rect);
+        EXPECT_EQ(inside.size(), tree.eraseIn(rect));
+        std::vector<point_2f> left;
+        std::set_difference(points.begin(), points.end(), inside.begin(), inside.end(), std::back_inserter(left));
+        points = left;
+    }
+    expectSameAsBruteForce(tree, points, 200);
+    for (point_2f point : points) {
+        ASSERT_TRUE(tree.deletePoint(point, 0));
+    }
+    EXPECT_EQ(0u, tree.nodesCount());
+
+    tree.addPoint(point_2f(1, 1));
+    EXPECT_EQ(0u, tree.eraseIn(Range(2, 3, 2, 3)));
+    EXPECT_EQ(1u, tree.eraseIn(Range(0, 3, 0, 3)));
+    EXPECT_EQ(NULL_NODE, tree.lowDetailedRoot);
+}
+
+TEST(skipquadtree_batch, benchmark) {
+    std::vector<point_2f> base = uniform_points<float>(1000000, MIN_X, MAX_X);
+    for (size_t batchSize : {10000, 100000}) {
+        std::vector<point_2f> batch = uniform_points<float>(batchSize, MIN_X, MAX_X);
+        SkipQuadTree perPoint, batched;
+        perPoint.build(base.begin(), base.end());
+        batched.build(base.begin(), base.end());
+
+        double addMs = measure_ms([&] {
+            for (point_2f point : batch) {
+                perPoint.addPoint(point);
+            }
+        });
+        double insertMs = measure_ms([&] {
+            batched.insertBatch(batch.begin(), batch.end());
+        });
+        double deleteMs = measure_ms([&] {
+            for (point_2f point : batch) {
+                perPoint.deletePoint(point, 0);
+            }
+        });
+        double eraseMs = measure_ms([&] {
+            batched.eraseBatch(batch.begin(), batch.end(), 0);
+        });
+        EXPECT_EQ(perPoint.countInRange(Range(MIN_X, MAX_X, MIN_Y, MAX_Y), 0),
+                batched.countInRange(Range(MIN_X, MAX_X, MIN_Y, MAX_Y), 0));
+        printf("[          ] %zu points into 1000000: addPoint %.2f ms, insertBatch %.2f ms, "
+                "deletePoint %.2f ms, eraseBatch %.2f ms\n", batchSize, addMs, insertMs, deleteMs, eraseMs);
+    }
+
+    SkipQuadTree tree;
+    tree.build(base.begin(), base.end());
+    Range region(-50, 0, -50, 0);
+    std::vector<point_2f> inside = bruteForceContain(base, region);
+    SkipQuadTree perPoint;
+    perPoint.build(base.begin(), base.end());
+    double deleteMs = measure_ms([&] {
+        for (point_2f point : inside) {
+            perPoint.deletePoint(point, 0);
+        }
+    });
+    size_t erased = 0;
+    double eraseMs = measure_ms([&] {
+        erased = tree.eraseIn(region);
+    });
+    EXPECT_EQ(inside.size(), erased);
+    printf("[          ] %zu points of a region: deletePoint %.2f ms, eraseIn %.2f ms\n", erased, deleteMs, eraseMs);
+}
+
+TEST(linear_quadtree, sameAsSkipQuadTree) {
+    std::vector<point_2f> points = uniform_points<float>(30000, MIN_X, MAX_X);
+    // duplicates and a dense cluster
+    points.insert(points.end(), points.begin(), points.begin() + 1000);
+    for (int i = 0; i < 1000; i++) {
+        points.push_back(point_2f(1 + i * 1e-4f, 1 - i * 1e-4f));
+    }
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    for (size_t threads : {1, 4}) {
+        LinearQuadTree index(points.begin(), points.end(), threads);
+        EXPECT_EQ(31000u, index.size());
+        expectSameAsBruteForce(index, points, 300);
+
+        auto corners = uniform_points<float>(200, MIN_X, MAX_X);
+        for (size_t i = 0; i + 1 < corners.size(); i += 2) {
+            Range rect(corners[i].x, corners[i].x + 20, corners[i].y, corners[i].y + 20);
+            EXPECT_EQ(tree.countInRange(rect, 0), index.countInRange(rect, 0));
+            for (auto const &withId : index.getContainWithId(corners[i], point_2f(rect.toX, rect.toY), 1)) {
+                EXPECT_EQ(index.point(withId.first), withId.second);
+                // whole cells lying within eps may be reported
+                point_2f point = withId.second;
+                EXPECT_TRUE(point.x >= rect.fromX - 1 && point.x < rect.toX + 1
+                        && point.y >= rect.fromY - 1 && point.y < rect.toY + 1);
+            }
+        }
+    }
+
+    LinearQuadTree empty;
+    EXPECT_TRUE(empty.getContain(point_2f(MIN_X, MIN_Y), point_2f(MAX_X, MAX_Y), 0).empty());
+    std::vector<point_2f> single = {point_2f(1, 2)};
+    empty.build(single.begin(), single.end());
+    EXPECT_EQ(1u, empty.getContain(point_2f(0, 0), point_2f(3, 3), 0).size());
+}
+
+TEST(linear_quadtree, intCoordinates) {
+    std::vector<cg::point_2i> points;
+    for (int x = -300; x < 300; x += 7) {
+        for (int y = -300; y < 300; y += 5) {
+            points.push_back(cg::point_2i(x, y));
+        }
+    }
+    LinearQuadTreeT<int> index(points.begin(), points.end());
+    for (int from = -310; from < 300; from += 37) {
+        RangeT<int> rect(from, from + 50, -from / 2, -from / 2 + 80);
+        size_t expected = 0;
+        for (cg::point_2i point : points) {
+            expected += point.x >= rect.fromX && point.x < rect.toX && point.y >= rect.fromY && point.y < rect.toY;
+        }
+        EXPECT_EQ(expected, index.countInRange(rect, 0));
+    }
+}
+
+TEST(linear_quadtree, benchmark) {
+    std::vector<point_2f> points = uniform_points<float>(1000000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    double treeMs = measure_ms([&] {
+        tree.build(points.begin(), points.end());
+    });
+    LinearQuadTree index;
+    double indexMs = measure_ms([&] {
+        index.build(points.begin(), points.end());
+    });
+    double parallelMs = measure_ms([&] {
+        index.build(points.begin(), points.end(), 4);
+    });
+    printf("[          ] 1000000 points: SkipQuadTree build %.2f ms, %.1f bytes per point; "
+            "LinearQuadTree build %.2f ms (4 threads %.2f ms), %.1f bytes per point\n",
+            treeMs, double(tree.bytesUsed()) / points.size(), indexMs, parallelMs,
+            double(index.bytesUsed()) / points.size());
+
+    for (float side : {1.f, 5.f, 50.f}) {
+        std::vector<point_2f> corners = uniform_points<float>(10000, MIN_X, MAX_X);
+        size_t inTree = 0, inIndex = 0;
+        double treeQueryMs = measure_ms([&] {
+            for (point_2f corner : corners) {
+                inTree += tree.countInRange(Range(corner.x, corner.x + side, corner.y, corner.y + side), 0);
+            }
+        });
+        double indexQueryMs = measure_ms([&] {
+            for (point_2f corner : corners) {
+                inIndex += index.countInRange(Range(corner.x, corner.x + side, corner.y, corner.y + side), 0);
+            }
+        });
+        EXPECT_EQ(inTree, inIndex);
+        printf("[          ] 10000 %gx%g queries: SkipQuadTree %.2f us, LinearQuadTree %.2f us per query\n",
+                side, side, treeQueryMs * 1000 / corners.size(), indexQueryMs * 1000 / corners.size());
+    }
+}
+
+// points of the tree in the region, checked against the predicate of the region
+template<class Region>
+void expectSameRegion(SkipQuadTree const &tree, std::vector<point_2f> const &points, Region const &region) {
+    std::vector<point_2f> expected;
+    for (point_2f point : points) {
+        if (region.contains(point)) {
+            expected.push_back(point);
+        }
+    }
+    std::sort(expected.begin(), expected.end());
+    std::list<point_2f> found = tree.getContainInRegion(region);
+    std::vector<point_2f> actual(found.begin(), found.end());
+    std::sort(actual.begin(), actual.end());
+    EXPECT_EQ(expected, actual);
+    EXPECT_EQ(expected.size(), tree.countInRegion(region));
+}
+
+// random points and a grid, so that many points lie on the borders of the regions
+std::vector<point_2f> regionPoints() {
+    std::vector<point_2f> points = uniform_points<float>(20000, MIN_X, MAX_X);
+    for (int x = MIN_X; x < MAX_X; x += 2) {
+        for (int y = MIN_Y; y < MAX_Y; y += 2) {
+            points.push_back(point_2f(x, y));
+        }
+    }
+    return makeUnique(points);
+}
+
+TEST(skipquadtree_regions, disc) {
+    std::vector<point_2f> points = regionPoints();
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    expectSameRegion(tree, points, DiscRegion(cg::point_2(0, 0), 30));
+    expectSameRegion(tree, points, DiscRegion(cg::point_2(10, -20), 0));
+    expectSameRegion(tree, points, DiscRegion(cg::point_2(1000, 0), 5));
+    auto centers = uniform_points<double>(50, MIN_X, MAX_X);
+    for (size_t i = 0; i < centers.size(); i++) {
+        expectSameRegion(tree, points, DiscRegion(centers[i], 0.5 + i));
+    }
+    SkipQuadTree empty;
+    EXPECT_EQ(0u, empty.countInRegion(DiscRegion(cg::point_2(0, 0), 1000)));
+}
+
+TEST(skipquadtree_regions, halfPlane) {
+    std::vector<point_2f> points = regionPoints();
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    expectSameRegion(tree, points, HalfPlaneRegion(cg::point_2(0, 0), cg::point_2(1, 1)));
+    expectSameRegion(tree, points, HalfPlaneRegion(cg::point_2(4, 0), cg::point_2(4, -1)));
+    auto ends = uniform_points<double>(40, MIN_X, MAX_X);
+    for (size_t i = 0; i + 1 < ends.size(); i += 2) {
+        expectSameRegion(tree, points, HalfPlaneRegion(ends[i], ends[i + 1]));
+    }
+}
+
+TEST(skipquadtree_regions, convex) {
+    std::vector<point_2f> points = regionPoints();
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    expectSameRegion(tree, points, ConvexRegion(cg::contour_2({
+            cg::point_2(-40, -40), cg::point_2(40, -40), cg::point_2(40, 40), cg::point_2(-40, 40)})));
+    expectSameRegion(tree, points, ConvexRegion(cg::contour_2({
+            cg::point_2(-50, 0), cg::point_2(0, -30), cg::point_2(60, 10), cg::point_2(20, 50)})));
+    expectSameRegion(tree, points, ConvexRegion(cg::contour_2({
+            cg::point_2(1.5, 1.5), cg::point_2(3.25, 2), cg::point_2(2, 7)})));
+    expectSameRegion(tree, points, ConvexRegion(cg::contour_2({
+            cg::point_2(500, 500), cg::point_2(600, 500), cg::point_2(600, 600)})));
+}
+
+TEST(skipquadtree_regions, polygon) {
+    std::vector<point_2f> points = regionPoints();
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    // a comb, clockwise, with teeth between the cells
+    cg::contour_2 comb({cg::point_2(-60, -60), cg::point_2(-60, 60), cg::point_2(-40, 60), cg::point_2(-40, -20),
+            cg::point_2(-20, -20), cg::point_2(-20, 60), cg::point_2(0, 60), cg::point_2(0, -20),
+            cg::point_2(30, -20), cg::point_2(30, 61.5), cg::point_2(60, 61.5), cg::point_2(60, -60)});
+    expectSameRegion(tree, points, PolygonRegion(comb));
+    expectSameRegion(tree, points, PolygonRegion(cg::contour_2({
+            cg::point_2(-50, 0), cg::point_2(0, -30), cg::point_2(60, 10), cg::point_2(20, 50)})));
+    cg::contour_2 star;
+    for (int i = 0; i < 14; i++) {
+        double radius = i % 2 ? 25 : 90;
+        star.add_point(cg::point_2(radius * std::cos(i * M_PI / 7), radius * std::sin(i * M_PI / 7)));
+    }
+    expectSameRegion(tree, points, PolygonRegion(star));
+}
+
+TEST(skipquadtree_regions, benchmark) {
+    std::vector<point_2f> points = uniform_points<float>(1000000, MIN_X, MAX_X);
+    SkipQuadTree tree;
+    tree.build(points.begin(), points.end());
+    std::vector<point_2f> centers = uniform_points<float>(10000, MIN_X + 10, MAX_X - 10);
+
+    for (float radius : {1.f, 10.f}) {
+        size_t inDiscs = 0, inBoxes = 0, filtered = 0;
+        double discMs = measure_ms([&] {
+            for (point_2f center : centers) {
+                inDiscs += tree.countInRegion(DiscRegion(center, radius));
+            }
+        });
+        double boxMs = measure_ms([&] {
+            for (point_2f center : centers) {
+                DiscRegion disc(center, radius);
+                tree.forEachInRange(Range(center.x - radius, center.x + radius, center.y - radius, center.y + radius),
+                        0, [&](int, point_2f point) {
+                    inBoxes++;
+                    filtered += disc.contains(point);
+                });
+            }
+        });
+        EXPECT_EQ(filtered, inDiscs);
+        printf("[          ] 10000 discs of radius %g: region query %.2f us, box query and filter %.2f us per query, "
+                "box fetches %.1f%% more points\n", radius, discMs * 1000 / centers.size(),
+                boxMs * 1000 / centers.size(), 100. * (inBoxes - filtered) / filtered);
+    }
+
+    cg::contour_2 star;
+    for (int i = 0; i < 14; i++) {
+        double radius = i % 2 ? 2.5 : 9;
+        star.add_point(cg::point_2(radius * std::cos(i * M_PI / 7), radius * std::sin(i * M_PI / 7)));
+    }
+    size_t inStars = 0;
+    double starMs = measure_ms([&] {
+        for (point_2f center : centers) {
+            cg::contour_2 moved;
+            for (cg::point_2 const &vertex : star) {
+                moved.add_point(cg::point_2(vertex.x + center.x, vertex.y + center.y));
+            }
+            inStars += tree.countInRegion(PolygonRegion(moved));
+        }
+    });
+    printf("[          ] 10000 star polygons of 14 vertices: %.2f us per query, %.1f points per query\n",
+            starMs * 1000 / centers.size(), double(inStars) / centers.size());
+}
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+template <class F>
+inline double measure_ms(F f)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    f();
+    std::chrono::steady_clock::time_point finish = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::milli>(finish - start).count();
+}
+
+inline void print_timing(char const * what, double ms)
+{
+    printf("[          ] %s: %.2f ms\n", what, ms);
+}
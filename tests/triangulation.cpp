@@ -3,10 +3,18 @@
 #include <gtest/gtest.h>
 
 #include "cg/triangulation/triangulation.h"
+#include "cg/triangulation/delaunay.h"
 #include "cg/operations/contains/triangle_point.h"
 #include "cg/operations/contains/segment_point.h"
 #include "cg/operations/contains/contour_point.h"
 #include <gmpxx.h>
+#include <random>
+#include <map>
+#include <unordered_map>
+#include <cmath>
+#include <thread>
+
+#include "timer.h"
 
 using namespace std;
 using namespace cg;
@@ -423,3 +431,393 @@ TEST(triangulation, from_kingdom_subdivision_45) {
    vector<triangle_2> v = triangulate(poly);
    check_triangulation(poly, v);
 }
+
+// counterclockwise faces with the points of the triangles and twins on the same vertices, the border has no twins
+void check_mesh(polygon poly, const half_edge_mesh &mesh) {
+   vector<triangle_2> t = triangulate(poly);
+   size_t count_v = 0;
+   for (auto cont : poly) count_v += cont.vertices_num();
+   ASSERT_EQ(count_v, mesh.vertices_num());
+   ASSERT_EQ(t.size(), mesh.faces_num());
+   ASSERT_EQ(3 * t.size(), mesh.half_edges_num());
+
+   size_t border = 0;
+   for (half_edge_mesh::index_t h = 0; h != mesh.half_edges_num(); h++) {
+      EXPECT_EQ(h, mesh.prev[mesh.next[h]]);
+      EXPECT_EQ(h, mesh.next[mesh.next[mesh.next[h]]]);
+      EXPECT_EQ(mesh.face[h], mesh.face[mesh.next[h]]);
+      if (mesh.twin[h] == half_edge_mesh::none) {
+         border++;
+      } else {
+         EXPECT_EQ(h, mesh.twin[mesh.twin[h]]);
+         EXPECT_EQ(mesh.origin[h], mesh.target(mesh.twin[h]));
+      }
+   }
+   EXPECT_EQ(count_v, border);
+
+   vector<vector<point_2>> expected, faces;
+   for (auto tr : t) {
+      if (orientation(tr[0], tr[1], tr[2]) == CG_RIGHT) tr.reverse();
+      expected.push_back({tr[0], tr[1], tr[2]});
+   }
+   for (half_edge_mesh::index_t f = 0; f != mesh.faces_num(); f++) {
+      vector<point_2> face;
+      mesh.for_each_face_edge(f, [&](half_edge_mesh::index_t h) { face.push_back(mesh.points[mesh.origin[h]]); });
+      EXPECT_EQ(CG_LEFT, orientation(face[0], face[1], face[2]));
+      faces.push_back(face);
+   }
+   for (auto *v : {&expected, &faces}) {
+      for (auto &tr : *v) std::rotate(tr.begin(), std::min_element(tr.begin(), tr.end()), tr.end());
+      std::sort(v->begin(), v->end());
+   }
+   EXPECT_EQ(expected, faces);
+}
+
+// star-shaped counterclockwise polygon with random radii
+contour_2 random_star(size_t n, unsigned seed) {
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<double> radius(500, 1000);
+   vector<point_2> pts;
+   for (size_t i = 0; i < n; i++) {
+      double angle = 2 * M_PI * i / n;
+      double r = radius(gen);
+      pts.push_back(point_2(std::round(r * std::cos(angle) * 1000), std::round(r * std::sin(angle) * 1000)));
+   }
+   return contour_2(pts);
+}
+
+TEST(triangulation, half_edge_mesh) {
+   vector<contour_2> poly;
+   poly.push_back(contour_2({point_2(-494, 326), point_2(-839, -381), point_2(-534, 47), point_2(-243, 48), point_2(-237, -49), point_2(-102, -41), point_2(-111, 201), point_2(-343, 187), point_2(-342, 114), point_2(-538, 118)}));
+   poly.push_back(contour_2({point_2(-278, 160), point_2(-153, 166), point_2(-144, 0), point_2(-193, 135), point_2(-316, 71)}));
+   poly.push_back(contour_2({point_2(-561, 143), point_2(-601, 37), point_2(-450, 75), point_2(-602, 31), point_2(-621, 40)}));
+   poly.push_back(contour_2({point_2(-672, -52), point_2(-631, -11), point_2(-622, -46)}));
+   half_edge_mesh mesh;
+   triangulate(poly, mesh);
+   check_mesh(poly, mesh);
+
+   for (unsigned seed = 0; seed < 5; seed++) {
+      vector<contour_2> star = {random_star(200, seed)};
+      triangulate(star, mesh);
+      check_mesh(star, mesh);
+   }
+}
+
+TEST(triangulation, half_edge_mesh_benchmark) {
+   vector<contour_2> poly = {random_star(200000, 1)};
+   vector<triangle_2> triangles;
+   double soup_ms = measure_ms([&] { triangles = triangulate(poly); });
+   half_edge_mesh mesh;
+   double mesh_ms = measure_ms([&] { triangulate(poly, mesh); });
+   printf("[          ] %zu triangles: triangles %.2f ms, %zu bytes; mesh %.2f ms, %zu bytes\n", triangles.size(),
+         soup_ms, triangles.size() * sizeof(triangle_2), mesh_ms, mesh.memory_usage());
+
+   // the area of every triangle with its neighbours: the mesh follows the twins,
+   // the triangles have to be matched by their sides first
+   double soup_area = 0, mesh_area = 0;
+   double soup_walk_ms = measure_ms([&] {
+      vector<std::pair<std::pair<point_2, point_2>, size_t>> sides;
+      for (size_t i = 0; i < triangles.size(); i++) {
+         for (size_t k = 0; k < 3; k++) {
+            segment_2 s = triangles[i].side(k);
+            sides.push_back(std::make_pair(std::make_pair(std::min(s[0], s[1]), std::max(s[0], s[1])), i));
+         }
+      }
+      std::sort(sides.begin(), sides.end());
+      for (size_t i = 0; i < sides.size(); i++) {
+         const triangle_2 &tr = triangles[sides[i].second];
+         double area = std::abs((tr[1] - tr[0]) ^ (tr[2] - tr[0]));
+         if (i + 1 < sides.size() && sides[i].first == sides[i + 1].first) {
+            const triangle_2 &other = triangles[sides[i + 1].second];
+            soup_area += area + std::abs((other[1] - other[0]) ^ (other[2] - other[0]));
+            i++;
+         }
+      }
+   });
+   double mesh_walk_ms = measure_ms([&] {
+      for (half_edge_mesh::index_t h = 0; h != mesh.half_edges_num(); h++) {
+         half_edge_mesh::index_t g = mesh.twin[h];
+         if (g == half_edge_mesh::none || g < h) continue;
+         for (half_edge_mesh::index_t e : {h, g}) {
+            const point_2 &a = mesh.points[mesh.origin[e]];
+            const point_2 &b = mesh.points[mesh.origin[mesh.next[e]]];
+            const point_2 &c = mesh.points[mesh.origin[mesh.prev[e]]];
+            mesh_area += (b - a) ^ (c - a);
+         }
+      }
+   });
+   EXPECT_DOUBLE_EQ(soup_area, mesh_area);
+   printf("[          ] adjacent triangles: triangles %.2f ms, mesh %.2f ms\n", soup_walk_ms, mesh_walk_ms);
+}
+
+TEST(triangulation, benchmark) {
+   for (size_t n : {100000, 1000000}) {
+      vector<contour_2> poly = {random_star(n, 2)};
+      vector<triangle_2> t;
+      double ms = measure_ms([&] { t = triangulate(poly); });
+      EXPECT_EQ(n - 2, t.size());
+      printf("[          ] star of %zu vertices: %.2f ms\n", n, ms);
+   }
+}
+
+// convex counterclockwise polygon, vertices on a circle
+contour_2 random_convex(size_t n, unsigned seed) {
+   std::mt19937 gen(seed);
+   std::uniform_real_distribution<double> angle(0, 2 * M_PI);
+   vector<double> angles;
+   for (size_t i = 0; i < n; i++) angles.push_back(angle(gen));
+   std::sort(angles.begin(), angles.end());
+   vector<point_2> pts;
+   for (double a : angles) pts.push_back(point_2(std::round(std::cos(a) * 1e6), std::round(std::sin(a) * 1e6)));
+   return contour_2(pts);
+}
+
+TEST(triangulation, triangulator) {
+   vector<vector<contour_2>> polys;
+   for (unsigned seed = 0; seed < 20; seed++) {
+      polys.push_back({random_convex(3 + seed, seed)});
+      polys.push_back({random_star(4 + seed * 2, seed)});
+   }
+   polys.push_back({contour_2({point_2(0, 0), point_2(1, 0), point_2(2, 0), point_2(2, 2), point_2(0, 2)})});
+   polys.push_back({contour_2({point_2(0, 0), point_2(-1, -1), point_2(1, 0), point_2(-1, 1)})});
+   polys.push_back({contour_2({point_2(-2, -2), point_2(2, -2), point_2(2, 2), point_2(-2, 2)}),
+         contour_2({point_2(1, 1), point_2(1, -1), point_2(-1, -1), point_2(-1, 1)})});
+   polys.push_back({random_star(100, 7)});
+
+   triangulator t;
+   for (auto &poly : polys) {
+      vector<triangle_2> v;
+      t.triangulate_into(poly, v);
+      check_triangulation(poly, v);
+      v.clear();
+      t.sweep_into(poly, v);
+      EXPECT_EQ(triangulate(poly), v);
+   }
+}
+
+TEST(triangulation, triangulate_many) {
+   vector<vector<contour_2>> polys;
+   for (unsigned seed = 0; seed < 50; seed++) polys.push_back({random_star(4 + seed % 47, seed)});
+   triangulator t;
+   vector<triangle_2> expected;
+   vector<size_t> expected_offsets;
+   for (auto &poly : polys) {
+      expected_offsets.push_back(expected.size());
+      t.triangulate_into(poly, expected);
+   }
+   expected_offsets.push_back(expected.size());
+   for (size_t threads : {1, 3, 64}) {
+      vector<triangle_2> triangles;
+      vector<size_t> offsets;
+      triangulate_many(polys, triangles, offsets, threads);
+      EXPECT_EQ(expected, triangles);
+      EXPECT_EQ(expected_offsets, offsets);
+   }
+}
+
+TEST(triangulation, triangulator_benchmark) {
+   // parcels of 4 to 50 vertices, a third of them convex
+   vector<vector<contour_2>> polys;
+   for (unsigned i = 0; i < 200000; i++) {
+      size_t n = 4 + i % 47;
+      polys.push_back({i % 3 == 0 ? random_convex(n, i) : random_star(n, i)});
+   }
+   size_t count = 0;
+   double call_ms = measure_ms([&] {
+      for (auto &poly : polys) count += triangulate(poly).size();
+   });
+   triangulator t;
+   vector<triangle_2> out;
+   double reuse_sweep_ms = measure_ms([&] {
+      for (auto &poly : polys) {
+         out.clear();
+         t.sweep_into(poly, out);
+      }
+   });
+   double reuse_ms = measure_ms([&] {
+      for (auto &poly : polys) {
+         out.clear();
+         t.triangulate_into(poly, out);
+      }
+   });
+   vector<triangle_2> triangles;
+   vector<size_t> offsets;
+   size_t threads = std::max(1u, std::thread::hardware_concurrency());
+   double many_ms = measure_ms([&] { triangulate_many(polys, triangles, offsets, threads); });
+   EXPECT_EQ(count, triangles.size());
+   printf("[          ] %zu polygons: triangulate %.2f ms, sweep_into %.2f ms, triangulate_into %.2f ms, "
+         "triangulate_many on %zu threads %.2f ms\n", polys.size(), call_ms, reuse_sweep_ms, reuse_ms, threads, many_ms);
+}
+
+// the triangles of the points, the neighbours the same as from matching their sides
+void check_indexed(polygon poly, const indexed_triangles &t) {
+   vector<point_2> points;
+   for (auto &c : poly) points.insert(points.end(), c.begin(), c.end());
+   vector<triangle_2> triangles;
+   for (size_t i = 0; i < t.size(); i++) {
+      for (size_t k = 0; k < 3; k++) EXPECT_LT(t.vertices[3 * i + k], points.size());
+      triangle_2 tr(points[t.vertices[3 * i]], points[t.vertices[3 * i + 1]], points[t.vertices[3 * i + 2]]);
+      EXPECT_EQ(CG_LEFT, orientation(tr[0], tr[1], tr[2]));
+      triangles.push_back(tr);
+   }
+   check_triangulation(poly, triangles);
+
+   map<pair<size_t, size_t>, size_t> sides;
+   for (size_t i = 0; i < t.size(); i++) {
+      for (size_t k = 0; k < 3; k++) sides[make_pair(t.vertices[3 * i + k], t.vertices[3 * i + (k + 1) % 3])] = i;
+   }
+   for (size_t i = 0; i < t.size(); i++) {
+      for (size_t k = 0; k < 3; k++) {
+         auto it = sides.find(make_pair(t.vertices[3 * i + (k + 1) % 3], t.vertices[3 * i + k]));
+         size_t expected = it == sides.end() ? size_t(indexed_triangles::none) : it->second;
+         EXPECT_EQ(expected, size_t(t.neighbours[3 * i + k]));
+      }
+   }
+}
+
+TEST(triangulation, indexed) {
+   vector<vector<contour_2>> polys;
+   polys.push_back({contour_2({point_2(-728, 359), point_2(-828, -211), point_2(-574, -46), point_2(-376, -285), point_2(-328, -95), point_2(-358, -403), point_2(-48, 247), point_2(-707, -47)})});
+   polys.push_back({contour_2({point_2(-494, 326), point_2(-839, -381), point_2(-534, 47), point_2(-243, 48), point_2(-237, -49), point_2(-102, -41), point_2(-111, 201), point_2(-343, 187), point_2(-342, 114), point_2(-538, 118)}),
+         contour_2({point_2(-278, 160), point_2(-153, 166), point_2(-144, 0), point_2(-193, 135), point_2(-316, 71)}),
+         contour_2({point_2(-561, 143), point_2(-601, 37), point_2(-450, 75), point_2(-602, 31), point_2(-621, 40)}),
+         contour_2({point_2(-672, -52), point_2(-631, -11), point_2(-622, -46)})});
+   polys.push_back({contour_2({point_2(-2, -2), point_2(2, -2), point_2(2, 2), point_2(-2, 2)}),
+         contour_2({point_2(1, 1), point_2(1, -1), point_2(-1, -1), point_2(-1, 1)})});
+   for (unsigned seed = 0; seed < 10; seed++) polys.push_back({random_star(10 + 20 * seed, seed)});
+
+   triangulator tr;
+   for (auto &poly : polys) {
+      indexed_triangles t;
+      triangulate(poly, t);
+      check_indexed(poly, t);
+      tr.sweep_into(poly, t);
+      check_indexed(poly, t);
+   }
+}
+
+TEST(triangulation, indexed_benchmark) {
+   vector<contour_2> poly = {random_star(1000000, 3)};
+   // the triangles by their points, welded back to vertex indices by a hash map
+   vector<triangle_2> triangles;
+   vector<size_t> welded;
+   double weld_ms = measure_ms([&] {
+      triangles = triangulate(poly);
+      auto hash = [](const point_2 &p) { return std::hash<double>()(p.x) * 31 + std::hash<double>()(p.y); };
+      std::unordered_map<point_2, size_t, decltype(hash)> ids(poly[0].size(), hash);
+      for (size_t i = 0; i < poly[0].size(); i++) ids[poly[0][i]] = i;
+      welded.reserve(3 * triangles.size());
+      for (auto &tr : triangles) {
+         for (size_t k = 0; k < 3; k++) welded.push_back(ids[tr[k]]);
+      }
+   });
+   indexed_triangles t;
+   double indexed_ms = measure_ms([&] { triangulate(poly, t); });
+   EXPECT_EQ(triangles.size(), t.size());
+   printf("[          ] %zu triangles: points and welding %.2f ms, %zu bytes; indexed with neighbours %.2f ms, %zu bytes\n",
+         t.size(), weld_ms, triangles.size() * sizeof(triangle_2), indexed_ms,
+         (t.vertices.size() + t.neighbours.size()) * sizeof(indexed_triangles::index_t));
+}
+
+// a square with a grid of square holes, as the sweep makes long slivers between them
+vector<contour_2> holed_square(int holes) {
+   int size = 3 * holes + 1;
+   vector<contour_2> poly = {contour_2({point_2(0, 0), point_2(size, 0), point_2(size, size), point_2(0, size)})};
+   for (int i = 0; i < holes; i++) {
+      for (int j = 0; j < holes; j++) {
+         double x = 3 * i + 1, y = 3 * j + 1;
+         poly.push_back(contour_2({point_2(x, y), point_2(x, y + 2), point_2(x + 2, y + 2), point_2(x + 2, y)}));
+      }
+   }
+   return poly;
+}
+
+size_t find_index(const indexed_triangles &t, size_t i, size_t v) {
+   return t.vertices[3 * i] == v ? 0 : (t.vertices[3 * i + 1] == v ? 1 : 2);
+}
+
+// every side with a neighbour is locally Delaunay, linear in the size so it suits large inputs
+void check_constrained_delaunay(polygon poly, const indexed_triangles &t) {
+   size_t count_v = 0;
+   for (auto &c : poly) count_v += c.vertices_num();
+   EXPECT_EQ(count_v + 2 * (poly.size() - 2), t.size());
+   vector<point_2> points;
+   for (auto &c : poly) points.insert(points.end(), c.begin(), c.end());
+   for (size_t i = 0; i < t.size(); i++) {
+      for (size_t k = 0; k < 3; k++) {
+         size_t n = t.neighbours[3 * i + k];
+         if (n == size_t(indexed_triangles::none)) continue;
+         EXPECT_EQ(t.vertices[3 * i + k], t.vertices[3 * n + (find_index(t, n, t.vertices[3 * i + (k + 1) % 3]) + 1) % 3]);
+         for (size_t j = 0; j < 3; j++) {
+            EXPECT_NE(CG_INSIDE, incircle(points[t.vertices[3 * i]], points[t.vertices[3 * i + 1]],
+                  points[t.vertices[3 * i + 2]], points[t.vertices[3 * n + j]]));
+         }
+      }
+   }
+}
+
+TEST(triangulation, constrained_delaunay) {
+   vector<vector<contour_2>> polys;
+   polys.push_back({contour_2({point_2(-246, 303), point_2(-778, 151), point_2(-782, 45), point_2(-471, 55), point_2(-528, 170), point_2(-246, 138), point_2(-432, -85), point_2(-802, -67), point_2(-571, -11), point_2(-858, 19), point_2(-933, -275), point_2(-492, -397), point_2(-67, -83), point_2(-189, 60), point_2(342, 137), point_2(403, -144), point_2(-73, -301), point_2(-115, -206), point_2(-266, -317), point_2(-289, -407), point_2(41, -458), point_2(219, -339), point_2(241, -258), point_2(384, -352), point_2(382, -447), point_2(691, -366), point_2(692, -192), point_2(835, 103), point_2(601, 236), point_2(335, 310), point_2(167, 372), point_2(-67, 226)}),
+         contour_2({point_2(166, 256), point_2(323, 283), point_2(469, 183), point_2(-111, 167), point_2(17, 219), point_2(78, 210)}),
+         contour_2({point_2(497, -140), point_2(565, 132), point_2(728, 58), point_2(584, -95), point_2(616, -283), point_2(349, -257)}),
+         contour_2({point_2(-784, -272), point_2(-723, -208), point_2(-809, -117), point_2(-527, -130), point_2(-514, -277), point_2(-626, -195)}),
+         contour_2({point_2(-363, -151), point_2(-279, 70), point_2(-228, -100), point_2(-286, -35), point_2(-356, -241), point_2(-458, -208), point_2(-426, -128), point_2(-411, -190)})});
+   polys.push_back(holed_square(4));
+   for (unsigned seed = 0; seed < 10; seed++) polys.push_back({random_star(10 + 20 * seed, seed)});
+
+   for (auto &poly : polys) {
+      indexed_triangles t;
+      constrained_delaunay_triangulate(poly, t);
+      check_indexed(poly, t);
+      check_constrained_delaunay(poly, t);
+      check_triangulation(poly, constrained_delaunay_triangulate(poly));
+   }
+
+   // too large for the quadratic checks, recovering many crossed edges at once
+   vector<vector<contour_2>> large = {holed_square(30), {random_star(10000, 1)}, {random_star(10000, 2)}};
+   for (unsigned seed = 1; seed < 8; seed++) large.push_back({random_star(1000, seed)});
+   for (auto &poly : large) {
+      indexed_triangles t;
+      constrained_delaunay_triangulate(poly, t);
+      check_constrained_delaunay(poly, t);
+   }
+}
+
+// the smallest angle of every triangle, in degrees
+vector<double> min_angles(const vector<triangle_2> &triangles) {
+   vector<double> res;
+   for (auto &tr : triangles) {
+      double angle = 180;
+      for (size_t k = 0; k < 3; k++) {
+         vector_2 u = tr[(k + 1) % 3] - tr[k], v = tr[(k + 2) % 3] - tr[k];
+         angle = std::min(angle, std::abs(std::atan2(u ^ v, u * v)) * 180 / M_PI);
+      }
+      res.push_back(angle);
+   }
+   return res;
+}
+
+TEST(triangulation, constrained_delaunay_benchmark) {
+   vector<std::pair<const char *, vector<contour_2>>> inputs = {
+      {"star of 100000 vertices", {random_star(100000, 4)}},
+      {"square with 10000 holes", holed_square(100)}};
+   for (auto &input : inputs) {
+      vector<triangle_2> sweep, cdt;
+      double sweep_ms = measure_ms([&] { sweep = triangulate(input.second); });
+      double cdt_ms = measure_ms([&] { cdt = constrained_delaunay_triangulate(input.second); });
+      EXPECT_EQ(sweep.size(), cdt.size());
+      for (auto *t : {&sweep, &cdt}) {
+         vector<double> angles = min_angles(*t);
+         double mean = 0;
+         size_t slivers = 0;
+         for (double a : angles) {
+            mean += a / angles.size();
+            if (a < 10) slivers++;
+         }
+         printf("[          ] %s, %s: %.2f ms, min angle %.3f, mean min angle %.2f, %.2f%% under 10 degrees\n",
+               input.first, t == &sweep ? "triangulate" : "constrained Delaunay", t == &sweep ? sweep_ms : cdt_ms,
+               *std::min_element(angles.begin(), angles.end()), mean, 100.0 * slivers / angles.size());
+      }
+   }
+}